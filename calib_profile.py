@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Build fixture calibration profiles for the "calib" partition (see
+main/calibration.h), so a different fixture needs no rebuild.
+
+Color and brightness come from dump CSVs (header row, then
+mireds,normal,cold,warm resp. level,normal,cold,warm with 0..1 channel
+fractions; gaps get linearly interpolated), or from the compiled-in
+main/data_tables.h when not given. Use `export` to get those as CSV
+templates. The color dump is fitted like color_fit.py does.
+
+Flash the result with:
+  parttool.py write_partition --partition-name calib --input profile.bin
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+import zlib
+
+import color_fit
+
+MAGIC = b'E32C'
+VERSION = 1
+CHANNELS = 3
+GPIOS = 5
+MAX_KNOTS = 32
+ONE = 65535
+NAME_LEN = 16
+
+HEADER = struct.Struct('<4sBBHI')  # magic, version, reserved, size, crc32
+# Mirrors calibration.c validate(); the firmware rejects anything else and keeps its defaults
+MIN_PWM_FREQ, MAX_PWM_FREQ = 100, 20000  # LD_MIN/MAX_PWM_FREQ
+OUTPUT_GPIOS = range(0, 24)  # ESP32-C6: GPIO24..30 drive the SPI flash
+RESERVED_GPIOS = (0, 1, 14)  # indicator LED, reset button, rf switch
+BODY_HEAD = struct.Struct('<%dsI%db3x' % (NAME_LEN, GPIOS))  # name, pwm freq, gpios
+CURVE = struct.Struct('<BB%dH%dH' % (MAX_KNOTS, MAX_KNOTS))  # size, reserved, knots, values
+BRIGHTNESS = struct.Struct('<%dH' % 256)
+SIZE = HEADER.size + BODY_HEAD.size + CHANNELS * CURVE.size + CHANNELS * BRIGHTNESS.size + 2  # + reserved3
+BRIGHTNESS_TABLES = ['BRIGHTNESS_DATA_NORMAL', 'BRIGHTNESS_DATA_COLD', 'BRIGHTNESS_DATA_HOT']
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DATA_TABLES = os.path.join(HERE, 'main', 'data_tables.h')
+
+
+def load_csv(path, first, last):
+    # -> per channel list of values for x in first..last (linearly interpolated)
+    points = []
+    with open(path, newline='') as f:
+        rows = csv.reader(f)
+        next(rows, None)  # header
+        for row in rows:
+            if row and not row[0].startswith('#'):
+                points.append((float(row[0]), [float(v) for v in row[1:1 + CHANNELS]]))
+    points.sort()
+    if len(points) < 2 or any(len(p[1]) != CHANNELS for p in points):
+        sys.exit('Error: %s needs at least two rows of x,normal,cold,warm' % path)
+
+    out = [[] for _ in range(CHANNELS)]
+    j = 0
+    for x in range(first, last + 1):
+        while j < len(points) - 2 and points[j + 1][0] < x:
+            j += 1
+        (x0, v0), (x1, v1) = points[j], points[j + 1]
+        t = min(1.0, max(0.0, (x - x0) / (x1 - x0)))
+        for c in range(CHANNELS):
+            out[c].append(v0[c] + (v1[c] - v0[c]) * t)
+    return out
+
+
+def load_tables():
+    color = [color_fit.load_table(DATA_TABLES, name) for _, name in color_fit.CHANNELS]
+    brightness = [color_fit.load_table(DATA_TABLES, name) for name in BRIGHTNESS_TABLES]
+    return color, brightness
+
+
+def build(args):
+    min_temp, max_temp = args.min_temperature, args.max_temperature
+    color, brightness = load_tables()
+    if args.color:
+        color = load_csv(args.color, min_temp, max_temp)
+    if args.brightness:
+        brightness = load_csv(args.brightness, 0, 255)
+
+    curves = b''
+    for c, (channel, _) in enumerate(color_fit.CHANNELS):
+        values = color_fit.smooth(color[c], args.smooth)
+        knots = color_fit.fit(color[c], values, args.tolerance, args.relative or None, args.floor)
+        if len(knots) > MAX_KNOTS:
+            sys.exit('Error: %s needs %d knots (max %d), raise --relative/--tolerance' % (
+                channel.lower(), len(knots), MAX_KNOTS))
+        worst, worst_rel = color_fit.model_error(color[c], values, knots, args.floor)
+        print('%-6s %2d knots, max error %.5f, relative %.1f%% (above floor)' % (
+            channel.lower(), len(knots), worst, worst_rel * 100))
+        pad = [0] * (MAX_KNOTS - len(knots))
+        curves += CURVE.pack(len(knots), 0, *([min_temp + k for k in knots] + pad),
+                             *([color_fit.quantize(values[k]) for k in knots] + pad))
+
+    gpios = [int(g) for g in args.gpio.split(',')] if args.gpio else [-1] * GPIOS
+    if len(gpios) != GPIOS:
+        sys.exit('Error: --gpio needs %d values (-1 = default)' % GPIOS)
+    for g in gpios:
+        if g != -1 and (g not in OUTPUT_GPIOS or g in RESERVED_GPIOS or gpios.count(g) > 1):
+            sys.exit('Error: gpio %d is not a free output pin (or used twice)' % g)
+    if args.pwm_freq and not MIN_PWM_FREQ <= args.pwm_freq <= MAX_PWM_FREQ:
+        sys.exit('Error: --pwm-freq must be 0 or %d..%d Hz' % (MIN_PWM_FREQ, MAX_PWM_FREQ))
+    body = BODY_HEAD.pack(args.name.encode()[:NAME_LEN], args.pwm_freq, *gpios) + curves + \
+        b''.join(BRIGHTNESS.pack(*[color_fit.quantize(v) for v in b]) for b in brightness) + bytes(2)
+    crc = zlib.crc32(body)
+    profile = HEADER.pack(MAGIC, VERSION, 0, SIZE, crc) + body
+    assert len(profile) == SIZE
+    with open(args.output, 'wb') as f:
+        f.write(profile)
+    print('%s: %d bytes, crc32 0x%08x' % (args.output, len(profile), crc))
+
+
+def show(args):
+    data = open(args.profile, 'rb').read()
+    magic, version, _, size, crc = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or size != SIZE or len(data) < SIZE:
+        sys.exit('Error: not a version %d calibration profile' % VERSION)
+    print('crc: 0x%08x (%s)' % (crc, 'ok' if zlib.crc32(data[HEADER.size:SIZE]) == crc else 'MISMATCH'))
+    name, pwm_freq, *gpios = BODY_HEAD.unpack_from(data, HEADER.size)
+    print('name: %s' % name.rstrip(b'\0').decode(errors='replace'))
+    print('pwm_freq: %s' % (pwm_freq or 'default'))
+    print('gpio: %s' % ', '.join(str(g) if g >= 0 else 'default' for g in gpios))
+    offset = HEADER.size + BODY_HEAD.size
+    for channel, _ in color_fit.CHANNELS:
+        n, _, *rest = CURVE.unpack_from(data, offset)
+        knots, values = rest[:n], rest[MAX_KNOTS:MAX_KNOTS + n]
+        print('%s: %s' % (channel.lower(), ' '.join('%d:%.4f' % (k, v / ONE) for k, v in zip(knots, values))))
+        offset += CURVE.size
+
+
+def export(args):
+    color, brightness = load_tables()
+    for path, first, table, label in ((args.color, args.min_temperature, color, 'mireds'),
+                                      (args.brightness, 0, brightness, 'level')):
+        with open(path, 'w', newline='') as f:
+            w = csv.writer(f)
+            w.writerow([label, 'normal', 'cold', 'warm'])
+            for i, row in enumerate(zip(*table)):
+                w.writerow([first + i] + list(row))
+        print('wrote %s' % path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build/inspect e32wamb fixture calibration profiles')
+    parser.add_argument('--min-temperature', type=int, default=153, help='mireds of the first color sample')
+    parser.add_argument('--max-temperature', type=int, default=454, help='mireds of the last color sample')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    p = sub.add_parser('build', help='Build profile')
+    p.add_argument('--color', help='color dump CSV (mireds,normal,cold,warm); default: data_tables.h')
+    p.add_argument('--brightness', help='brightness dump CSV (level,normal,cold,warm); default: data_tables.h')
+    p.add_argument('--name', default='custom', help='profile name (up to %d chars)' % NAME_LEN)
+    p.add_argument('--pwm-freq', type=int, default=0, help='pwm frequency (Hz, default: 0 = firmware default)')
+    p.add_argument('--gpio', help='%d comma-separated gpios per ledc channel (-1 = default)' % GPIOS)
+    p.add_argument('--relative', type=float, default=0.15,
+                   help='color fit error relative to the sample (default: 0.15; 0 = --tolerance only)')
+    p.add_argument('--tolerance', type=float, default=0.015, help='color fit max abs error (default: 0.015)')
+    p.add_argument('--floor', type=float, default=0.001, help='color fit abs error always allowed (default: 0.001)')
+    p.add_argument('--smooth', type=int, default=0, help='color fit smoothing half-width (default: 0)')
+    p.add_argument('-o', '--output', required=True, help='output file')
+
+    p = sub.add_parser('show', help='Verify and describe profile')
+    p.add_argument('profile')
+
+    p = sub.add_parser('export', help='Export compiled-in tables as CSV templates')
+    p.add_argument('--color', default='color.csv', help='color CSV to write (default: color.csv)')
+    p.add_argument('--brightness', default='brightness.csv', help='brightness CSV to write (default: brightness.csv)')
+
+    args = parser.parse_args()
+    {'build': build, 'show': show, 'export': export}[args.cmd](args)
+
+
+if __name__ == '__main__':
+    main()
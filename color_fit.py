@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Fit the piecewise-linear color model (main/color_model_data.h) to the raw
+color tables dumped from the Hue (COLOR_DATA_* in main/data_tables.h).
+
+The dump is a staircase (many duplicated adjacent samples), so the model
+is a set of knots (mireds -> Q16 channel fraction) taken from the dump
+(optionally a smoothed copy, --smooth), placed greedily: every segment is
+extended for as long as it stays within bounds of all the raw samples it
+covers. The bound is relative (--relative of the sample, so the dim end of
+a channel is as accurate as the bright one), but never above --tolerance
+nor below --floor (absolute; the staircase makes exact zeros unreachable).
+Reports knot count and max absolute/relative error (vs. the raw dump) per
+channel.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CHANNELS = [('NORMAL', 'COLOR_DATA_NORMAL'), ('COLD', 'COLOR_DATA_COLD'), ('WARM', 'COLOR_DATA_HOT')]
+Q16_ONE = 65535  # 1.0 (close enough)
+
+HEADER = """/*
+ * ESP32 White Ambiance
+ *
+ * This "code" is licensed under CC0, as it's fitted to the Philips White
+ * Ambiance light PWM data (see data_tables.h).
+ *
+ * Purpose: Piecewise-linear color model knots, generated by color_fit.py
+ * (relative %g, tolerance %g, floor %g, smooth %d) -- don't edit by hand.
+ */
+
+#pragma once
+
+#define COLOR_MODEL_MIN_TEMPERATURE %d
+#define COLOR_MODEL_MAX_TEMPERATURE %d
+"""
+
+
+def load_table(data_tables_h, name):
+    with open(data_tables_h, 'r') as f:
+        src = f.read()
+    m = re.search(r'#define %s \{\\(.*?)\}' % name, src, re.S)
+    if not m:
+        sys.exit('Error: no %s in %s' % (name, data_tables_h))
+    return [float(x) for x in re.findall(r'[-+]?[0-9.]+(?:e[-+]?[0-9]+)?', m.group(1))]
+
+
+def load_tables(data_tables_h):
+    return {name: load_table(data_tables_h, name) for _, name in CHANNELS}
+
+
+def smooth(data, width):
+    # Moving average over 2 * width + 1 samples (shrinking at the edges)
+    out = []
+    for i in range(len(data)):
+        window = data[max(0, i - width):i + width + 1]
+        out.append(sum(window) / len(window))
+    return out
+
+
+def bound(sample, tolerance, relative, floor):
+    # Allowed abs error at a sample; relative=None -> plain absolute tolerance
+    if relative is None:
+        return tolerance
+    return min(tolerance, max(relative * abs(sample), floor))
+
+
+def segment_fits(data, values, a, b, tolerance, relative, floor):
+    return all(abs(values[a] + (values[b] - values[a]) * (k - a) / (b - a) - data[k]) <=
+               bound(data[k], tolerance, relative, floor) for k in range(a, b + 1))
+
+
+def fit(data, values, tolerance, relative=None, floor=0.0):
+    knots = [0]
+    while knots[-1] < len(data) - 1:
+        a = knots[-1]
+        b = a + 1
+        while b + 1 < len(data) and segment_fits(data, values, a, b + 1, tolerance, relative, floor):
+            b += 1
+        knots.append(b)
+    return knots
+
+
+def quantize(value):
+    return max(0, min(Q16_ONE, round(value * Q16_ONE)))
+
+
+def model_error(data, values, knots, floor=0.0):
+    # (max abs, max relative) error of the model as the firmware evaluates it
+    # (quantized knot values); relative only counts samples above floor
+    worst = worst_rel = 0.0
+    for a, b in zip(knots, knots[1:]):
+        va, vb = quantize(values[a]), quantize(values[b])
+        for k in range(a, b + 1):
+            err = abs((va + (vb - va) * (k - a) // (b - a)) / Q16_ONE - data[k])
+            worst = max(worst, err)
+            if abs(data[k]) > floor:
+                worst_rel = max(worst_rel, err / abs(data[k]))
+    return worst, worst_rel
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description='Fit the piecewise-linear color model to the raw Hue color tables')
+    parser.add_argument('--data-tables', default=os.path.join(here, 'main', 'data_tables.h'),
+                        help='Path to data_tables.h with the raw dump')
+    parser.add_argument('--min-temperature', type=int, default=153, help='mireds of the first sample (default: 153)')
+    parser.add_argument('--relative', type=float, default=0.15,
+                        help='max error relative to the sample (default: 0.15; 0 = absolute --tolerance only)')
+    parser.add_argument('--tolerance', type=float, default=0.015,
+                        help='max abs error (fraction of full duty, default: 0.015)')
+    parser.add_argument('--floor', type=float, default=0.001,
+                        help='abs error always allowed (fraction of full duty, default: 0.001)')
+    parser.add_argument('--smooth', type=int, default=0,
+                        help='smoothing half-width for the knot values (samples, default: 0 = raw)')
+    parser.add_argument('-o', '--output', help='Write the model header here (e.g. main/color_model_data.h)')
+    args = parser.parse_args()
+
+    tables = load_tables(args.data_tables)
+    sizes = {len(t) for t in tables.values()}
+    if len(sizes) != 1:
+        sys.exit('Error: color tables differ in length')
+    size = sizes.pop()
+
+    relative = args.relative or None
+    out = [HEADER % (args.relative, args.tolerance, args.floor, args.smooth, args.min_temperature,
+                     args.min_temperature + size - 1)]
+    raw_bytes = model_bytes = 0
+    for channel, name in CHANNELS:
+        data = tables[name]
+        values = smooth(data, args.smooth)
+        knots = fit(data, values, args.tolerance, relative, args.floor)
+        worst, worst_rel = model_error(data, values, knots, args.floor)
+        print('%-6s %3d knots (of %d samples), max error %.5f, relative %.1f%% (above floor)' % (
+            channel.lower(), len(knots), len(data), worst, worst_rel * 100))
+        raw_bytes += len(data) * 8  # doubles
+        model_bytes += len(knots) * 4  # u16 mireds + u16 value
+        out.append('\n#define COLOR_MODEL_%s_SIZE %d\n' % (channel, len(knots)))
+        out.append('#define COLOR_MODEL_%s_KNOTS {%s}\n' % (
+            channel, ', '.join(str(args.min_temperature + k) for k in knots)))
+        out.append('#define COLOR_MODEL_%s_VALUES {%s}\n' % (
+            channel, ', '.join(str(quantize(values[k])) for k in knots)))
+    print('footprint: %d bytes (raw tables: %d bytes)' % (model_bytes, raw_bytes))
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(''.join(out))
+
+
+if __name__ == '__main__':
+    main()
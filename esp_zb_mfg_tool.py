@@ -17,6 +17,9 @@ import re
 from ctypes import *
 import struct
 import csv
+import hashlib
+import time
+from concurrent.futures import ProcessPoolExecutor
 from itertools import zip_longest
 
 
@@ -310,13 +313,10 @@ def set_common_section_parameter(zb_pro_cfg_section_data, key, value):
         return RET_NOT_FOUND
 
 
-def generate_binary(args, key_value_list):
+def build_pro_cfg_buffer(key_value_list, strict=False):
+    # Production config image (list of byte values) for the given key-value pairs;
+    # with strict, a bad value raises ValueError instead of being skipped
     g_product_config_len = 0
-    bin_ext = '.bin'
-    filename, ext = os.path.splitext(args.output)
-    if bin_ext not in ext:
-        sys.exit('Error: `%s`. Only `.bin` extension allowed.' % args.output)
-    args.outdir, args.output = nvs_partition_gen.set_target_filepath(args.outdir, args.output)
     # init parameter
     zb_pro_cfg_data = zb_production_config_ver_2_t()
     zb_manaufacturer_data = zb_manufacturer_config_t()
@@ -331,7 +331,11 @@ def generate_binary(args, key_value_list):
             key = key_value_list[index][0]
             value = key_value_list[index][1]
             ret = set_common_section_parameter(zb_pro_cfg_data, key, value)
+            if strict and ret == RET_ERROR:
+                raise ValueError('bad %s: %s' % (key, value))
             ret = set_manufacturer_param(zb_manaufacturer_data, key, value)
+            if strict and ret == RET_ERROR:
+                raise ValueError('bad %s: %s' % (key, value))
 
         except RuntimeError as e:
             print(e)
@@ -353,6 +357,16 @@ def generate_binary(args, key_value_list):
     # fill prod_cfg magic header
     PRODUCTION_CONFIG_HEADER = [0xE7, 0x37, 0xDD, 0xF6]
     g_pro_cfg_buffer = PRODUCTION_CONFIG_HEADER + g_pro_cfg_buffer  # buffer list
+    return g_pro_cfg_buffer
+
+
+def generate_binary(args, key_value_list):
+    bin_ext = '.bin'
+    filename, ext = os.path.splitext(args.output)
+    if bin_ext not in ext:
+        sys.exit('Error: `%s`. Only `.bin` extension allowed.' % args.output)
+    args.outdir, args.output = nvs_partition_gen.set_target_filepath(args.outdir, args.output)
+    g_pro_cfg_buffer = build_pro_cfg_buffer(key_value_list)
 
     # generate arry config file 
     if is_output_header_file_style:
@@ -436,6 +450,87 @@ def generate_binary_from_csv(args):
         csv_values_file.close()
 
 
+def batch_defaults(args):
+    # Columns missing from the batch csv come from the command line
+    return [('installcode', args.installcode),
+            ('mac_address', args.mac_address),
+            ('channel_mask_page0', hex(args.channel_mask)),
+            ('manufacturer_name', args.manufacturer_name),
+            ('manufacturer_code', hex(args.manufacturer_code)),
+            ]
+
+
+def read_batch(args, output_bin_target_dir):
+    # One job per csv row: (mac_address, key-value pairs, output file)
+    defaults = batch_defaults(args)
+    jobs = []
+    seen = set()
+    with open(args.batch, 'r', newline='') as f:
+        for lineno, row in enumerate(csv.DictReader(f), 2):
+            row = {k.strip(): (v or '').strip() for k, v in row.items() if k}
+            if not any(row.values()):
+                continue
+            mac = row.get('mac_address', '').upper()
+            if len(mac) != 16 or not re.fullmatch(r'[0-9A-F]{16}', mac):
+                sys.exit('Error: line %d: invalid mac_address `%s`' % (lineno, mac))
+            if mac in seen:
+                sys.exit('Error: line %d: duplicate mac_address %s' % (lineno, mac))
+            seen.add(mac)
+            row['mac_address'] = mac
+            keys = [k for k, _ in defaults]
+            key_value_list = [(k, row.get(k) or v) for k, v in defaults]
+            key_value_list += [(k, v) for k, v in row.items() if k not in keys and k != 'id' and v]
+            output_bin_file = output_bin_target_dir + mac + '.bin'
+            if os.path.isfile(output_bin_file):
+                sys.exit('Error: target binary file %s already exists' % output_bin_file)
+            jobs.append((mac, key_value_list, output_bin_file))
+    return jobs
+
+
+def batch_worker(job):
+    mac, key_value_list, output_bin_file = job
+    try:
+        image = bytes(build_pro_cfg_buffer(key_value_list, strict=True))
+    except ValueError as e:
+        return (mac, None, str(e))
+    with open(output_bin_file, 'wb') as f:
+        f.write(image)
+    return (mac, output_bin_file, len(image), hashlib.sha256(image).hexdigest())
+
+
+def generate_batch(args):
+    started = time.monotonic()
+    output_bin_target_dir = mfg_gen.create_dir('bin', os.path.join(args.outdir, ''))
+    jobs = read_batch(args, output_bin_target_dir)
+    if not jobs:
+        sys.exit('Error: no devices in %s' % args.batch)
+
+    # Rows are tiny and cheap; hand them out in chunks to keep the pool busy
+    workers = args.jobs or os.cpu_count() or 1
+    chunksize = max(1, len(jobs) // (workers * 4))
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        results = list(pool.map(batch_worker, jobs, chunksize=chunksize))
+
+    failed = [r for r in results if r[1] is None]
+    for mac, _, error in failed:
+        print('Error: %s: %s' % (mac, error))
+
+    manifest = args.manifest or os.path.join(output_bin_target_dir, 'manifest.csv')
+    with open(manifest, 'w', newline='') as f:
+        out = csv.writer(f)
+        out.writerow(['mac_address', 'file', 'size', 'sha256'])
+        for r in results:
+            if r[1] is not None:
+                out.writerow([r[0], os.path.relpath(r[1], os.path.dirname(os.path.abspath(manifest))), r[2], r[3]])
+
+    elapsed = time.monotonic() - started
+    done = len(results) - len(failed)
+    print('Created %d images in %s (%d failed), manifest: %s' % (done, output_bin_target_dir, len(failed), manifest))
+    print('%.2f s, %.0f images/s (%d workers)' % (elapsed, done / elapsed if elapsed > 0 else 0, workers))
+    if failed:
+        sys.exit(1)
+
+
 def generate(args):
     args.outdir = os.path.join(args.outdir, '')
     # if csv is not present creat a sigle device for generate binary
@@ -461,6 +556,12 @@ def validate_args(args):
     if (args.csv and args.installcode != 'NULL' and args.mac_address != 'NULL'):
         logging.error("csv and installcode/mac_address/channel_mask/manufacturer_name/ manufacturer_code should not be both present or none")
         sys.exit(1)
+    if args.batch and args.csv:
+        logging.error("--batch and --csv are mutually exclusive")
+        sys.exit(1)
+    if args.jobs is not None and args.jobs < 1:
+        logging.error('Invalid jobs: %d' % args.jobs)
+        sys.exit(1)
     # csv, first line is heder
     if args.csv is not None:
         count = len(open(args.csv, 'r').readlines())
@@ -506,13 +607,19 @@ def get_args():
     parser.add_argument('-mn', '--manufacturer_name', default='Espressif', type=str, help='The manufacturer name.')
     parser.add_argument('-mc', '--manufacturer_code', default=0x131B, type=any_base_int, help='The manufacturer code.')
     parser.add_argument('--outdir', default=os.getcwd(), help='Output directory to store files created (Default: current directory)')
+    parser.add_argument('--batch', type=str, help='Batch mode: CSV with a header and a row per device (mac_address required; other columns override the arguments above), images generated in parallel.')
+    parser.add_argument('-j', '--jobs', type=int, help='Batch mode: worker processes (Default: number of cores)')
+    parser.add_argument('--manifest', type=str, help='Batch mode: manifest (mac_address, file, size, sha256) path (Default: OUTDIR/bin/manifest.csv)')
     return parser.parse_args()
 
 
 def main():
     args = get_args()
     validate_args(args)
-    generate(args)
+    if args.batch:
+        generate_batch(args)
+    else:
+        generate(args)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,32 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Random numbers for the host tests: xorshift64 with a fixed seed,
+ * so every run sees the same sequence (and a failure reproduces).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+static uint64_t rng = 0x2545f4914f6cdd1dULL;
+
+static inline uint64_t rng_next() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+// Uniform in 0..max
+static inline uint32_t rnd(uint32_t max) {
+    return rng_next() % ((uint64_t) max + 1);
+}
+
+// Uniform in [0, 1)
+static inline double uniform() {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
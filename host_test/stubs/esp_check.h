@@ -0,0 +1,22 @@
+// Host stand-in for the ESP-IDF header of the same name (just what the tested code needs)
+#pragma once
+
+#include "esp_err.h"
+
+#define ESP_LOGE(tag, ...) do { (void) (tag); } while (0)
+#define ESP_LOGW(tag, ...) do { (void) (tag); } while (0)
+#define ESP_LOGI(tag, ...) do { (void) (tag); } while (0)
+#define ESP_LOGD(tag, ...) do { (void) (tag); } while (0)
+
+#define ESP_RETURN_ON_ERROR(x, tag, ...) do { \
+        esp_err_t err_rc_ = (x); \
+        if (err_rc_ != ESP_OK) { \
+            (void) (tag); \
+            return err_rc_; \
+        } \
+    } while (0)
+
+static inline const char *esp_err_to_name(esp_err_t err) {
+    (void) err;
+    return "error";
+}
@@ -0,0 +1,10 @@
+// Host stand-in for the FreeRTOS header (single threaded: critical sections are no-ops)
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define taskENTER_CRITICAL(mux) do { (void) (mux); } while (0)
+#define taskEXIT_CRITICAL(mux) do { (void) (mux); } while (0)
@@ -0,0 +1,127 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: ad_should_switch against a link model: each antenna has a mean
+ * rssi to the parent, every probe sees it with fading noise, and pings get
+ * lost more the closer the link is to the sensitivity. Compares with
+ * switching whenever the other antenna looks better, and checks the
+ * hysteresis keeps equal antennas from flapping while a clearly better one
+ * is still picked up within a few probes.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "antenna_diversity_policy.h"
+#include "rng.h"
+
+#define PROBES 20000 // per scenario (15 min apart → ~7 months)
+#define FADING_DB 4.0 // σ of a probe around the mean
+#define SENSITIVITY -92.0 // dBm; half of the pings lost here ...
+#define LOSS_SLOPE 2.0 // dB; ... falling off this fast above
+#define SHUFFLE_EVERY 500 // probes; furniture moved (changing scenario)
+
+static double gauss() {
+    return sqrt(-2 * log(1 - uniform())) * cos(2 * M_PI * uniform());
+}
+
+static ad_link probe(double mean) {
+    double rssi = mean + FADING_DB * gauss();
+    if (uniform() < 1 / (1 + exp((rssi - SENSITIVITY) / LOSS_SLOPE))) {
+        return (ad_link) { false, 0, 0 };
+    }
+    rssi = fmax(-128, fmin(0, round(rssi)));
+    return (ad_link) { true, 255 * (rssi + 100) / 70 > 255 ? 255 : rssi < -100 ? 0 : 255 * (rssi + 100) / 70,
+            (int8_t) rssi };
+}
+
+// Switch whenever the other antenna answers better (what the hysteresis is against)
+static bool naive(uint8_t *wins, ad_link current, ad_link other) {
+    (void) wins; // (no state: that's the point)
+    return other.valid && (!current.valid || other.rssi > current.rssi);
+}
+
+typedef bool (*policy_t)(uint8_t *wins, ad_link current, ad_link other);
+
+typedef struct {
+    int switches;
+    int on_worse; // probes spent on an antenna ≥ 10 dB worse than the other
+    int worse; // probes where one antenna was ≥ 10 dB worse
+    int first_switch; // probe of the first switch (-1 = none)
+} result_t;
+
+// Means per antenna (index 0 = in use at start); shuffle → random every SHUFFLE_EVERY
+static result_t run(policy_t policy, double mean0, double mean1, bool shuffle) {
+    double mean[2] = { mean0, mean1 };
+    int current = 0;
+    uint8_t wins = 0;
+    result_t r = { 0, 0, 0, -1 };
+
+    for (int i = 0; i < PROBES; i++) {
+        if (shuffle && i % SHUFFLE_EVERY == 0) {
+            mean[0] = -95 + 40 * uniform();
+            mean[1] = -95 + 40 * uniform();
+        }
+        if (fabs(mean[0] - mean[1]) >= 10) {
+            r.worse++;
+            r.on_worse += mean[current] < mean[!current];
+        }
+        ad_link here = probe(mean[current]);
+        ad_link there = probe(mean[!current]);
+        if (policy(&wins, here, there)) {
+            current = !current;
+            r.switches++;
+            if (r.first_switch < 0) {
+                r.first_switch = i;
+            }
+        }
+    }
+    return r;
+}
+
+int main() {
+    printf("%-34s %9s %9s %9s %13s\n", "scenario", "policy", "switches", "on worse", "first switch");
+    struct {
+        const char *name;
+        double mean0, mean1;
+        bool shuffle;
+    } scenarios[] = {
+        { "equal, strong (-70/-70 dBm)", -70, -70, false },
+        { "equal, weak (-90/-90 dBm)", -90, -90, false },
+        { "other 3 dB better (-73/-70)", -73, -70, false },
+        { "other 10 dB better (-80/-70)", -80, -70, false },
+        { "current lost (-105/-75)", -105, -75, false },
+        { "moving (-95..-55, every 500)", 0, 0, true },
+    };
+    result_t results[6][2];
+
+    for (int s = 0; s < 6; s++) {
+        for (int p = 0; p < 2; p++) {
+            result_t r = run(p ? naive : ad_should_switch, scenarios[s].mean0, scenarios[s].mean1,
+                    scenarios[s].shuffle);
+            results[s][p] = r;
+            printf("%-34s %9s %9d %8.2f%% %13d\n", p ? "" : scenarios[s].name, p ? "naive" : "hysteresis",
+                    r.switches, r.worse ? 100.0 * r.on_worse / r.worse : 0.0, r.first_switch);
+        }
+    }
+
+    // Equal or near-equal antennas: rare switches (each one is a flash write), far fewer than naive
+    for (int s = 0; s < 3; s++) {
+        assert(results[s][0].switches * 100 < PROBES * 2);
+        assert(results[s][0].switches * 10 < results[s][1].switches);
+    }
+    // Clearly better, or the current one lost: picked up within a few probes
+    assert(results[3][0].first_switch >= 0 && results[3][0].first_switch < 12);
+    assert(results[4][0].first_switch >= 0 && results[4][0].first_switch < 4);
+    // Moving: hardly ever stuck on a clearly worse antenna, without flapping
+    assert(results[5][0].on_worse * 100 < results[5][0].worse * 2);
+    assert(results[5][0].switches * 5 < results[5][1].switches);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Simulates the dithered output of one deep-dim channel for every
+ * fractional duty: the dither tick as the esp_timer task runs it (late by
+ * its scheduling jitter, sometimes by a whole Zigbee burst), the duty
+ * latched by ledc at the next PWM period, and the eye as a 10 ms average.
+ * Checks the mean stays within half a fine step of the target (the extra
+ * DITHER_BITS of resolution survive) and reports the low-frequency ripple
+ * (flicker energy) next to the error of not dithering at all, and what the
+ * tick costs in wakeups (of the esp_timer task, for as long as a dimmed light
+ * rests; fades aren't dithered).
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dither.h"
+#include "rng.h"
+
+#define DURATION 2000000 // μs (simulated in 1 μs steps)
+#define WARMUP 100000 // μs; ignored (filter fill)
+#define EYE_WINDOW 10000 // μs; moving average standing in for flicker fusion (first null at 100 Hz)
+#define BASE 1 // duty code under the fraction (deepest dim, worst relative ripple)
+
+typedef struct {
+    const char *name;
+    uint32_t pwm_freq; // Hz; ledc latches a new duty at the end of each period
+    uint32_t period; // μs; dither tick (0 = dither_period())
+    uint32_t jitter; // μs; uniform lateness of each tick
+    uint32_t burst_permille; // ticks held up by a burst ...
+    uint32_t burst; // μs; ... of up to this long
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "5 kHz, ISR, 500 us tick", 5000, DITHER_PERIOD, 0, 0, 0 }, // before: the tick ignored the PWM period
+    { "5 kHz, ISR", 5000, 0, 0, 0, 0 },
+    { "5 kHz, task", 5000, 0, 300, 0, 0 },
+    { "5 kHz, task, busy", 5000, 0, 300, 10, 5000 },
+    { "3 kHz, task", 3000, 0, 300, 0, 0 },
+    { "20 kHz, task, busy", 20000, 0, 300, 10, 5000 },
+};
+
+static uint8_t level[DURATION]; // duty code on the output, per μs
+
+typedef struct {
+    double mean_error; // codes
+    double ripple; // rms of the eye-filtered output around the target, codes
+} result_t;
+
+static result_t simulate(const scenario_t *s, uint32_t target) {
+    uint32_t period = s->period ? s->period : dither_period(s->pwm_freq);
+    uint32_t acc = 0;
+    int64_t due = 0; // when the next tick is due ...
+    int64_t run = 0; // ... and when it actually runs
+    int64_t latch = 0, pwm_periods = 0; // end of the current PWM period
+    uint32_t duty = target >> DITHER_BITS, latched = duty;
+    for (int64_t t = 0; t < DURATION; t++) {
+        while (t >= run) {
+            duty = dither_step(target, &acc);
+            // a late tick doesn't move the schedule; ticks held up run back to back
+            due += period;
+            int64_t late = rnd(s->jitter);
+            if (rnd(999) < s->burst_permille) {
+                late += rnd(s->burst);
+            }
+            run = due + late > run ? due + late : run;
+        }
+        if (t >= latch) {
+            latched = duty;
+            latch = ++pwm_periods * 1000000 / s->pwm_freq;
+        }
+        level[t] = latched;
+    }
+
+    double want = (double) target / (1 << DITHER_BITS), sq = 0;
+    int64_t sum = 0, window = 0, count = 0;
+    for (int64_t t = 0; t < DURATION; t++) {
+        window += level[t] - (t >= EYE_WINDOW ? level[t - EYE_WINDOW] : 0);
+        if (t >= WARMUP) {
+            sum += level[t];
+            double eye = (double) window / EYE_WINDOW - want;
+            sq += eye * eye;
+            count++;
+        }
+    }
+    return (result_t) { fabs((double) sum / count - want), sqrt(sq / count) };
+}
+
+int main() {
+    printf("%-26s %12s %12s %12s %14s %11s\n", "scenario", "max mean err", "max ripple", "mean ripple",
+            "undithered err", "wakeups/h");
+    for (size_t k = 0; k < sizeof(scenarios) / sizeof(*scenarios); k++) {
+        const scenario_t *s = &scenarios[k];
+        double worst_mean = 0, worst_ripple = 0, ripple = 0, undithered = 0;
+        for (uint32_t frac = 1; frac <= DITHER_MASK; frac++) {
+            result_t r = simulate(s, (BASE << DITHER_BITS) | frac);
+            worst_mean = fmax(worst_mean, r.mean_error);
+            worst_ripple = fmax(worst_ripple, r.ripple);
+            ripple += r.ripple / DITHER_MASK;
+            undithered = fmax(undithered, (double) frac / (1 << DITHER_BITS)); // duties are truncated
+        }
+        uint32_t period = s->period ? s->period : dither_period(s->pwm_freq);
+        printf("%-26s %12.4f %12.4f %12.4f %14.4f %11lu\n", s->name, worst_mean, worst_ripple, ripple, undithered,
+                3600000000UL / period);
+
+        if (s->period) {
+            continue; // (for comparison)
+        }
+        // the fine steps are still resolved ...
+        assert(worst_mean < 0.5 / (1 << DITHER_BITS));
+        // ... and what the eye sees wobbles well under one (undithered) step
+        assert(worst_ripple < 0.25);
+    }
+    printf("(all in duty codes at %d + fraction; a step is 1, a fine step 1/%d)\n", BASE, 1 << DITHER_BITS);
+    printf("(only at rest: fades near off still step whole codes; wakeups last as long as the light sits dimmed)\n");
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Frame builder/parser round trips for manuf_cmd.py (the set state family).
+"""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import manuf_cmd as mc  # noqa: E402
+
+
+class SetStateTest(unittest.TestCase):
+    def test_layout_matches_firmware(self):
+        # my_set_state_cmd_req_t: u32 magic (network order) + packed my_state_t (7 bytes)
+        self.assertEqual(mc.MAGIC_PREFIX.size + mc.SET_STATE.size, 11)
+        self.assertEqual(mc.build_set_state(True, 200, 300, 1.5).hex(), '1337c0d30701c82c010f00')
+
+    def test_round_trip(self):
+        payload = mc.build_set_state(onoff=False, level=1, temperature=454, transition=65.5)
+        self.assertEqual(mc.parse_set_state(payload), {
+            'magic_ok': True, 'onoff': False, 'level': 1, 'temperature': 454, 'transition': 65.5})
+
+    def test_subset(self):
+        parsed = mc.parse_set_state(mc.build_set_state(level=42))
+        self.assertEqual(parsed, {'magic_ok': True, 'level': 42, 'transition': 0.0})
+
+    def test_full_frame(self):
+        frame = mc.zcl_frame(mc.CMD_SET_STATE, mc.build_set_state(True, 200, 300, 1.5), seq=0x13)
+        self.assertEqual(frame.hex(), '051b1313c01337c0d30701c82c010f00')
+        parsed = mc.parse_frame(frame)
+        self.assertEqual(parsed['command'], 'set_state')
+        self.assertEqual(parsed['seq'], 0x13)
+        self.assertFalse(parsed['to_client'])
+        self.assertEqual((parsed['onoff'], parsed['level'], parsed['temperature'], parsed['transition']),
+                         (True, 200, 300, 1.5))
+
+    def test_no_default_response(self):
+        frame = mc.zcl_frame(mc.CMD_SET_STATE, mc.build_set_state(level=1), default_response=False)
+        self.assertTrue(frame[0] & mc.ZCL_FC_DISABLE_DEFAULT_RESPONSE)
+
+    def test_bad_magic(self):
+        payload = b'\0\0\0\0' + mc.build_set_state(level=1)[4:]
+        self.assertFalse(mc.parse_set_state(payload)['magic_ok'])
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            mc.parse_set_state(mc.build_set_state(level=1)[:-1])
+        with self.assertRaises(ValueError):
+            mc.parse_frame(b'\x05\x1b')
+
+    def test_foreign_manufacturer(self):
+        with self.assertRaises(ValueError):
+            mc.parse_frame(bytes.fromhex('05ffff00c0') + mc.build_set_state(level=1))
+
+    def test_level_range(self):
+        for level in (0, 255):
+            with self.assertRaises(ValueError):
+                mc.build_set_state(level=level)
+
+    def test_transition_range(self):
+        # Firmware clamps at 65.5 s (u16 ms fade); don't build what it would silently change
+        self.assertEqual(mc.parse_set_state(mc.build_set_state(level=1, transition=65.5))['transition'], 65.5)
+        for transition in (65.6, 6553.5, -0.1):
+            with self.assertRaises(ValueError):
+                mc.build_set_state(level=1, transition=transition)
+
+
+class ScheduledStartTest(unittest.TestCase):
+    def test_round_trip(self):
+        payload = mc.build_scheduled_start(0x1234, mc.EFFECTS.index('Okay'), level=100, transition=0.5)
+        self.assertEqual(mc.parse_scheduled_start(payload), {
+            'start': 0x1234, 'effect': 'Okay', 'magic_ok': True, 'level': 100, 'transition': 0.5})
+
+    def test_effect_only(self):
+        parsed = mc.parse_scheduled_start(mc.build_scheduled_start(7, mc.EFFECTS.index('Blink')))
+        self.assertEqual(parsed, {'start': 7, 'effect': 'Blink', 'magic_ok': True})
+
+    def test_transition_range(self):
+        with self.assertRaises(ValueError):
+            mc.build_scheduled_start(0, level=1, transition=100)
+
+
+class GetStateTest(unittest.TestCase):
+    def test_unchanged(self):
+        parsed = mc.parse_get_state(mc.STATE_HEADER.pack(1, 42), True)
+        self.assertEqual(parsed, {'version': 1, 'generation': 42, 'unchanged': True})
+
+    def test_request(self):
+        self.assertEqual(mc.parse_get_state(mc.build_get_state(42), False), {'generation': 42})
+        self.assertEqual(mc.parse_get_state(mc.build_get_state(), False), {})
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,160 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Supply current model of the three Hue channels over the whole
+ * (level, temperature) grid: how many channels are on at once at worst,
+ * with all of them turning on at the same edge, with the old wrapping
+ * stagger, and with pwm_stagger. Checks no on-time runs past the period end
+ * (ledc doesn't wrap it), at rest and through fades between grid points.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "color_model.h"
+#include "data_tables.h"
+#include "pwm_stagger.h"
+#include "rng.h"
+
+#define CHANNELS 3
+#define PERIOD 8192 // 13 bit at 5 kHz
+#define MIN_TEMP 153 // mireds
+#define MAX_TEMP 500
+#define FADES 200000 // random grid point pairs
+
+static const double brightness_normal[256] = BRIGHTNESS_DATA_NORMAL;
+static const double brightness_cold[256] = BRIGHTNESS_DATA_COLD;
+static const double brightness_warm[256] = BRIGHTNESS_DATA_HOT;
+static const double *const brightness_tables[CHANNELS] = { brightness_normal, brightness_cold, brightness_warm };
+
+// Duties of the channels at given state, like light_driver's compute_duties
+static void duties_at(uint8_t level, uint16_t temperature, uint32_t duties[CHANNELS]) {
+    for (int c = 0; c < CHANNELS; c++) {
+        double mix = color_model_eval((cm_channel) c, temperature << CM_FRAC_BITS) / (double) CM_ONE;
+        duties[c] = (PERIOD - 1) * mix * brightness_tables[c][level];
+    }
+}
+
+// Most channels on at once within the period (on-times wrapping around if wrap)
+static int peak(const uint32_t duties[CHANNELS], const uint32_t hpoints[CHANNELS], int wrap) {
+    uint32_t from[2 * CHANNELS], to[2 * CHANNELS];
+    int n = 0;
+    for (int c = 0; c < CHANNELS; c++) {
+        if (duties[c]) {
+            uint32_t end = hpoints[c] + duties[c];
+            from[n] = hpoints[c];
+            to[n++] = wrap && end > PERIOD ? PERIOD : end;
+            if (wrap && end > PERIOD) {
+                // (what runs past the end comes around at the start of the next period)
+                from[n] = 0;
+                to[n++] = end - PERIOD;
+            }
+        }
+    }
+    int most = 0;
+    for (int i = 0; i < n; i++) {
+        int on = 0;
+        for (int j = 0; j < n; j++) {
+            on += from[j] <= from[i] && from[i] < to[j];
+        }
+        most = on > most ? on : most;
+    }
+    return most;
+}
+
+// The stagger before pwm_stagger: next channel on where the previous one turns off, mod period
+static void wrapping_stagger(const uint32_t duties[CHANNELS], uint32_t hpoints[CHANNELS]) {
+    uint32_t hpoint = 0;
+    for (int c = 0; c < CHANNELS; c++) {
+        hpoints[c] = hpoint;
+        hpoint = (hpoint + duties[c]) % PERIOD;
+    }
+}
+
+static int overruns(const uint32_t spans[CHANNELS], const uint32_t hpoints[CHANNELS]) {
+    int n = 0;
+    for (int c = 0; c < CHANNELS; c++) {
+        n += hpoints[c] + spans[c] > PERIOD;
+    }
+    return n;
+}
+
+int main() {
+    const uint8_t all = (1 << CHANNELS) - 1;
+    int points = 0;
+    int worst_aligned = 0, worst_before = 0, worst_after = 0, worst_bound = 0;
+    long sum_aligned = 0, sum_before = 0, sum_after = 0, sum_bound = 0;
+    int overrun_before = 0, overrun_after = 0;
+    int hist_after[CHANNELS + 1] = { 0 };
+
+    for (int level = 1; level <= 254; level++) {
+        for (int temp = MIN_TEMP; temp <= MAX_TEMP; temp++) {
+            uint32_t duties[CHANNELS], hpoints[CHANNELS];
+            duties_at(level, temp, duties);
+
+            int bound = (duties[0] + duties[1] + duties[2] + PERIOD - 1) / PERIOD; // can't do better
+            worst_bound = bound > worst_bound ? bound : worst_bound;
+            sum_bound += bound;
+
+            memset(hpoints, 0, sizeof(hpoints));
+            int p = peak(duties, hpoints, 0);
+            worst_aligned = p > worst_aligned ? p : worst_aligned;
+            sum_aligned += p;
+
+            wrapping_stagger(duties, hpoints);
+            p = peak(duties, hpoints, 1);
+            worst_before = p > worst_before ? p : worst_before;
+            sum_before += p;
+            overrun_before += overruns(duties, hpoints) > 0;
+
+            pwm_stagger(PERIOD, all, duties, duties, hpoints);
+            p = peak(duties, hpoints, 0);
+            worst_after = p > worst_after ? p : worst_after;
+            sum_after += p;
+            hist_after[p]++;
+            overrun_after += overruns(duties, hpoints) > 0;
+
+            points++;
+        }
+    }
+
+    printf("%d grid points (level 1..254 x %d..%d mireds), period %d\n", points, MIN_TEMP, MAX_TEMP, PERIOD);
+    printf("%-22s %10s %10s %10s\n", "stagger", "max peak", "mean peak", "overruns");
+    printf("%-22s %10d %10.3f %10d\n", "none (all at 0)", worst_aligned, (double) sum_aligned / points, 0);
+    printf("%-22s %10d %10.3f %10d\n", "wrapping (before)", worst_before, (double) sum_before / points,
+            overrun_before);
+    printf("%-22s %10d %10.3f %10d\n", "pwm_stagger", worst_after, (double) sum_after / points, overrun_after);
+    printf("%-22s %10d %10.3f\n", "(lower bound)", worst_bound, (double) sum_bound / points);
+    printf("pwm_stagger peak histogram:");
+    for (int i = 0; i <= CHANNELS; i++) {
+        printf(" %d: %d", i, hist_after[i]);
+    }
+    printf(" (channels on at once)\n");
+
+    // Fades between random grid points: the span covers current and target duty
+    int fade_overruns = 0;
+    for (int i = 0; i < FADES; i++) {
+        uint32_t from[CHANNELS], to[CHANNELS], spans[CHANNELS], hpoints[CHANNELS];
+        duties_at(1 + rnd(253), MIN_TEMP + rnd(MAX_TEMP - MIN_TEMP), from);
+        duties_at(1 + rnd(253), MIN_TEMP + rnd(MAX_TEMP - MIN_TEMP), to);
+        for (int c = 0; c < CHANNELS; c++) {
+            spans[c] = from[c] > to[c] ? from[c] : to[c];
+        }
+        pwm_stagger(PERIOD, all, to, spans, hpoints);
+        fade_overruns += overruns(spans, hpoints) > 0;
+        for (int c = 0; c < CHANNELS; c++) {
+            assert(hpoints[c] < PERIOD);
+        }
+    }
+    printf("%d fades, %d with an on-time past the period end\n", FADES, fade_overruns);
+
+    assert(overrun_after == 0 && fade_overruns == 0);
+    assert(worst_after <= worst_aligned && sum_after < sum_aligned);
+    assert(sum_after <= sum_bound * 1.02); // (clamping costs little overlap)
+    printf("ok\n");
+    return 0;
+}
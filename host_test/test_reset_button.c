@@ -0,0 +1,198 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Bounce storms against the reset button logic, wired up the way
+ * reset_button.c does it: the isr posts one edge_seen per storm to a fake
+ * executor (with its latency), which restarts the debounce timer; the timer
+ * samples the level; an armed press gets a deadline timer. Checks contact
+ * chatter, EMI spikes and dropouts never cause (or abort) a factory reset,
+ * and that a button held at boot resets too.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "reset_button_fsm.h"
+#include "rng.h"
+
+#define END (60 * 1000) // ms; per scenario, at most
+#define MAX_EDGES 4096
+#define NO_TIMER INT64_MAX
+
+// Raw button level over time: pressed from edges[0] to edges[1], and so on
+typedef struct {
+    int64_t edges[MAX_EDGES];
+    int num;
+    bool at_boot; // pressed before t=0
+} signal_t;
+
+static void toggle(signal_t *s, int64_t t) {
+    assert(s->num < MAX_EDGES && (s->num == 0 || t > s->edges[s->num - 1]));
+    s->edges[s->num++] = t;
+}
+
+static bool level(const signal_t *s, int64_t t) {
+    bool pressed = s->at_boot;
+    for (int i = 0; i < s->num && s->edges[i] <= t; i++) {
+        pressed = !pressed;
+    }
+    return pressed;
+}
+
+// Contact chatter for up to ms after t: toggles 1..5 ms apart (even count → ends as it started)
+static int64_t chatter(signal_t *s, int64_t t, int ms) {
+    int64_t end = t + ms;
+    while (t + 10 < end) {
+        t += 1 + rnd(4);
+        toggle(s, t);
+        t += 1 + rnd(4);
+        toggle(s, t);
+    }
+    return t;
+}
+
+// A press of given length (from the first edge) with chatter on both ends; returns release time
+static int64_t press(signal_t *s, int64_t t, int64_t length, int storm) {
+    toggle(s, t);
+    chatter(s, t, storm);
+    toggle(s, t + length);
+    return chatter(s, t + length, storm);
+}
+
+typedef struct {
+    int arms, aborts, resets;
+    int64_t reset_at;
+} outcome_t;
+
+static void count(outcome_t *o, rb_action action, int64_t t, int64_t *deadline_timer, const rb_button_t *b) {
+    switch (action) {
+        case RB_Arm:
+            o->arms++;
+            *deadline_timer = b->deadline;
+            break;
+        case RB_Abort:
+            o->aborts++;
+            *deadline_timer = NO_TIMER;
+            break;
+        case RB_FactoryReset:
+            o->resets++;
+            o->reset_at = t;
+            break;
+        case RB_None:
+            break;
+    }
+}
+
+// Play signal against the button, as reset_button.c wires it; executor latency up to latency ms
+static outcome_t run(const signal_t *s, int latency) {
+    rb_button_t b = RB_BUTTON_INIT;
+    outcome_t o = { 0, 0, 0, -1 };
+    bool edge_pending = true; // (boot posts edge_seen, held at boot → no edge)
+    int64_t edge_seen_at = 0;
+    int64_t debounce_timer = NO_TIMER, deadline_timer = NO_TIMER;
+    int next_edge = 0;
+
+    for (int64_t t = 0; t < END && !o.resets; t++) {
+        // isr: only the first edge of a storm posts
+        for (; next_edge < s->num && s->edges[next_edge] <= t; next_edge++) {
+            if (!edge_pending) {
+                edge_pending = true;
+                edge_seen_at = t + rnd(latency);
+            }
+        }
+        // executor: handlers due by now
+        if (edge_seen_at <= t) {
+            edge_pending = false;
+            edge_seen_at = NO_TIMER;
+            debounce_timer = rb_edge(&b, t);
+        }
+        if (debounce_timer <= t) {
+            debounce_timer = NO_TIMER;
+            count(&o, rb_settle(&b, t, level(s, t)), t, &deadline_timer, &b);
+        }
+        if (deadline_timer <= t) {
+            deadline_timer = NO_TIMER;
+            count(&o, rb_deadline(&b, t), t, &deadline_timer, &b);
+        }
+    }
+    return o;
+}
+
+static void expect(const char *name, const signal_t *s, int latency, int arms, int resets) {
+    outcome_t o = run(s, latency);
+    printf("%-34s arms %d, aborts %d, resets %d", name, o.arms, o.aborts, o.resets);
+    if (o.resets) {
+        printf(" at %lld ms", (long long) o.reset_at);
+    }
+    printf("\n");
+    assert(o.arms == arms && o.resets == resets);
+    assert(o.aborts == o.arms - o.resets); // (indicator lock/unlock balanced)
+}
+
+int main() {
+    signal_t s;
+
+    s = (signal_t) { .num = 0 };
+    press(&s, 1000, 6000, 0);
+    expect("clean 6 s press", &s, 0, 1, 1);
+
+    s = (signal_t) { .num = 0 };
+    press(&s, 1000, 6000, 40);
+    expect("6 s press, 40 ms storms", &s, 20, 1, 1);
+
+    s = (signal_t) { .num = 0 };
+    press(&s, 1000, 4900, 40);
+    expect("4.9 s press, 40 ms storms", &s, 20, 1, 0);
+
+    s = (signal_t) { .num = 0 };
+    for (int64_t t = 500; t < END - 1000; t += 100 + rnd(400)) {
+        toggle(&s, t); // EMI spike (or a tap) shorter than the debounce
+        toggle(&s, t + 1 + rnd(RB_DEBOUNCE_MS - 15));
+        t += RB_DEBOUNCE_MS;
+    }
+    expect("spikes < debounce while idle", &s, 20, 0, 0);
+
+    s = (signal_t) { .num = 0 };
+    toggle(&s, 1000);
+    for (int64_t t = 1300; t < 8000; t += 300) {
+        toggle(&s, t); // contact drops out ...
+        t += 1 + rnd(RB_DEBOUNCE_MS - 15);
+        toggle(&s, t); // ... and back
+    }
+    toggle(&s, 9000);
+    expect("held with dropouts < debounce", &s, 20, 1, 1);
+
+    s = (signal_t) { .num = 0, .at_boot = true };
+    expect("held at boot", &s, 0, 1, 1);
+
+    s = (signal_t) { .num = 0, .at_boot = true };
+    toggle(&s, 3000);
+    expect("held at boot, released at 3 s", &s, 0, 1, 0);
+
+    // Random presses: shorter than the long press never reset, comfortably longer always do
+    int presses = 0, resets = 0;
+    for (int i = 0; i < 2000; i++) {
+        s = (signal_t) { .num = 0 };
+        int64_t length = 100 + rnd(7000);
+        int storm = rnd(40);
+        int latency = rnd(30);
+        press(&s, 500, length, storm);
+        outcome_t o = run(&s, latency);
+        assert(o.arms == 1 && o.resets <= 1 && o.aborts == o.arms - o.resets);
+        if (length < RB_LONG_PRESS_MS) {
+            assert(!o.resets);
+        } else if (length > RB_LONG_PRESS_MS + storm + RB_DEBOUNCE_MS + latency) {
+            assert(o.resets && o.reset_at <= 500 + storm + RB_DEBOUNCE_MS + latency + RB_LONG_PRESS_MS);
+        }
+        presses++;
+        resets += o.resets;
+    }
+    printf("%d random presses (0.1..7.1 s, storms up to 40 ms, latency up to 30 ms): %d resets\n", presses,
+            resets);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Replay benchmark of the streaming mode (stream.c): a sender
+ * streams a smooth level/temperature trajectory at 25 Hz over a simulated
+ * link with jitter and loss, the playout timer ticks as on the light, and
+ * the fade targets it hands the light driver are compared to the original
+ * trajectory (error) and to each other (smoothness: second difference per
+ * tick, i.e. how abruptly the fades change slope).
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "delayed_save.h"
+#include "esp_timer.h"
+#include "light_driver.h"
+#include "stream.h"
+#include "trace.h"
+
+#define DURATION 60000 // ms streamed per scenario
+#define SAMPLE_PERIOD 40 // ms; 25 Hz
+#define BASE_LATENCY 8 // ms; one hop, no jitter
+
+// --- fake platform ---
+
+static int64_t fake_now = 0; // μs
+static esp_timer_cb_t tick_cb = NULL;
+static bool tick_running = false;
+static int64_t tick_next = 0;
+
+int64_t esp_timer_get_time(void) {
+    return fake_now;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+    tick_cb = args->callback;
+    *handle = (esp_timer_handle_t) 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    (void) timer;
+    assert(period == STREAM_TICK * 1000);
+    tick_running = true;
+    tick_next = fake_now + period;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout) {
+    (void) timer;
+    (void) timeout;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    (void) timer;
+    tick_running = false;
+    return ESP_OK;
+}
+
+void delayed_save_suspend(bool suspend) {
+    (void) suspend;
+}
+
+void trace_record(uint8_t event, uint8_t arg0, uint16_t arg1, uint16_t arg2, uint32_t arg3) {
+    (void) event; (void) arg0; (void) arg1; (void) arg2; (void) arg3;
+}
+
+// Fade targets the light driver got: (tick end time, level, temperature)
+#define MAX_OUTPUTS (DURATION / STREAM_TICK + 100)
+static struct {
+    int64_t at;
+    uint8_t level;
+    double temperature; // mireds
+} outputs[MAX_OUTPUTS];
+static int n_outputs = 0;
+
+esp_err_t light_driver_stream_to(uint8_t level, uint16_t temperature, uint16_t time_ms) {
+    assert(n_outputs < MAX_OUTPUTS);
+    outputs[n_outputs].at = fake_now + time_ms * 1000LL;
+    outputs[n_outputs].level = level;
+    outputs[n_outputs].temperature = temperature / (double) (1 << LD_TEMPERATURE_FRAC_BITS);
+    n_outputs++;
+    return ESP_OK;
+}
+
+esp_err_t light_driver_stream_end() {
+    return ESP_OK;
+}
+
+// --- sender and link ---
+
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+static double rnd() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Trajectory on the sender clock (ms): overlapping slow waves
+static double truth_level(double t) {
+    return 127 + 80 * sin(2 * M_PI * t / 3000) + 30 * sin(2 * M_PI * t / 1100);
+}
+
+static double truth_temperature(double t) {
+    return 300 + 120 * sin(2 * M_PI * t / 5000);
+}
+
+typedef struct {
+    const char *name;
+    uint16_t jitter; // ms; latency on top of BASE_LATENCY, uniform 0..jitter
+    double loss; // probability a sample is lost
+    uint16_t burst; // ms; every 5 s, lose everything for this long
+} scenario_t;
+
+typedef struct {
+    int64_t at; // μs, local
+    uint32_t timestamp;
+} arrival_t;
+
+static int cmp_arrival(const void *a, const void *b) {
+    int64_t d = ((const arrival_t *) a)->at - ((const arrival_t *) b)->at;
+    return d < 0 ? -1 : d > 0;
+}
+
+typedef struct {
+    double rms_error; // level units
+    double max_error;
+    double rms_temp_error; // mireds
+    double rms_jerk; // second difference of level per tick
+    double truth_jerk; // ... of the trajectory itself
+    int received;
+} result_t;
+
+static result_t replay(const scenario_t *s, uint16_t delay) {
+    static arrival_t arrivals[DURATION / SAMPLE_PERIOD];
+    int n = 0;
+    int64_t t0 = 1000000; // local μs when the sender starts (= sender clock 0)
+
+    for (uint32_t ts = 0; ts < DURATION; ts += SAMPLE_PERIOD) {
+        bool lost = rnd() < s->loss || (s->burst && ts % 5000 >= 2500 && ts % 5000 < 2500U + s->burst);
+        if (!lost || ts == 0) {
+            int64_t latency = (BASE_LATENCY + rnd() * s->jitter) * 1000;
+            arrivals[n++] = (arrival_t) { t0 + ts * 1000LL + latency, ts };
+        }
+    }
+    qsort(arrivals, n, sizeof(arrivals[0]), cmp_arrival);
+
+    n_outputs = 0;
+    fake_now = t0;
+    assert(stream_start(delay) == ESP_OK);
+    int64_t anchor = -1; // local time of the first sample (its playout is anchor + delay)
+    int64_t end = t0 + (DURATION + 500) * 1000LL;
+    for (int i = 0; fake_now < end; fake_now += 100) {
+        while (i < n && arrivals[i].at <= fake_now) {
+            if (anchor < 0) {
+                anchor = fake_now - arrivals[i].timestamp * 1000LL;
+            }
+            stream_sample(arrivals[i].timestamp, truth_level(arrivals[i].timestamp),
+                    truth_temperature(arrivals[i].timestamp));
+            i++;
+        }
+        if (tick_running && fake_now >= tick_next) {
+            tick_next += STREAM_TICK * 1000;
+            tick_cb(NULL);
+        }
+    }
+    uint8_t level;
+    uint16_t temperature;
+    stream_stop(&level, &temperature);
+
+    // Compare targets to the trajectory where playout puts them (the first second is warm-up)
+    result_t r = { 0 };
+    double sum = 0, sum_t = 0, sum_j = 0, sum_tj = 0;
+    int count = 0;
+    for (int k = 2; k < n_outputs; k++) {
+        double ts = (outputs[k].at - anchor - delay * 1000LL) / 1000.0;
+        if (ts < 1000 || ts > DURATION - 1000) {
+            continue;
+        }
+        double err = fabs(outputs[k].level - truth_level(ts));
+        sum += err * err;
+        sum_t += pow(outputs[k].temperature - truth_temperature(ts), 2);
+        r.max_error = err > r.max_error ? err : r.max_error;
+        double j = outputs[k].level - 2.0 * outputs[k - 1].level + outputs[k - 2].level;
+        sum_j += j * j;
+        double tj = truth_level(ts) - 2 * truth_level(ts - STREAM_TICK) + truth_level(ts - 2 * STREAM_TICK);
+        sum_tj += tj * tj;
+        count++;
+    }
+    assert(count > 0);
+    r.rms_error = sqrt(sum / count);
+    r.rms_temp_error = sqrt(sum_t / count);
+    r.rms_jerk = sqrt(sum_j / count);
+    r.truth_jerk = sqrt(sum_tj / count);
+    r.received = n;
+
+    return r;
+}
+
+int main() {
+    const scenario_t scenarios[] = {
+        { "clean", 0, 0, 0 },
+        { "jitter 30 ms", 30, 0, 0 },
+        { "jitter 30 ms, 5% loss", 30, 0.05, 0 },
+        { "jitter 60 ms, 15% loss", 60, 0.15, 0 },
+        { "jitter 30 ms, 160 ms bursts", 30, 0, 160 },
+        { "jitter 150 ms (> delay)", 150, 0, 0 },
+    };
+
+    assert(stream_initialize() == ESP_OK);
+    printf("%-28s %5s %9s %9s %10s %9s %11s\n", "scenario", "rx", "rms err", "max err", "rms mired", "rms jerk",
+            "(ideal)");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const scenario_t *s = &scenarios[i];
+        result_t r = replay(s, STREAM_DEFAULT_DELAY);
+        printf("%-28s %5d %9.2f %9.2f %10.2f %9.2f %11.2f\n", s->name, r.received, r.rms_error, r.max_error,
+                r.rms_temp_error, r.rms_jerk, r.truth_jerk);
+
+        // Within the jitter buffer: only rounding (and concealment of what got lost)
+        if (s->jitter < STREAM_DEFAULT_DELAY - BASE_LATENCY && s->loss == 0 && s->burst == 0) {
+            assert(r.max_error < 2);
+            assert(r.rms_jerk < r.truth_jerk + 1);
+        }
+        if (s->jitter < STREAM_DEFAULT_DELAY - BASE_LATENCY && s->loss <= 0.05 && s->burst == 0) {
+            assert(r.rms_error < 1.5);
+        }
+    }
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Scheduled starts across a room of simulated lights: each has its
+ * own boot time and crystal drift, and a fake radio delivers the time
+ * reference and the scheduled start to each with its own latency. Checks
+ * that the lights start within MAX_SKEW of each other (and the edge cases
+ * of sync_clock itself).
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sync_clock.h"
+
+#define LIGHTS 20
+#define ROUNDS 2000
+#define MAX_SKEW 10000 // μs; what the scheduled starts promise
+#define MAX_DRIFT 40 // ppm; crystal tolerance
+#define RX_JITTER 3000 // μs; radio + zigbee task latency of a frame, per light
+#define WAKE_JITTER 500 // μs; hold timer → light driver task starting the fade
+#define HOP_DELAY 8000 // μs; rebroadcast delay of a relaying router (each hop)
+
+static int64_t fake_now = 0; // local clock of the light being simulated
+
+int64_t esp_timer_get_time(void) {
+    return fake_now;
+}
+
+static uint64_t rng = 0x2545f4914f6cdd1dULL;
+
+static uint32_t rnd(uint32_t max) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng % ((uint64_t) max + 1);
+}
+
+typedef struct {
+    int64_t boot; // true time (μs) the light booted (its clock reads 0 then)
+    int32_t drift; // ppm
+    uint8_t hops; // from the coordinator
+} light_t;
+
+static int64_t local_of(const light_t *l, int64_t t) {
+    return (t - l->boot) + (t - l->boot) * l->drift / 1000000;
+}
+
+static int64_t true_of(const light_t *l, int64_t local) {
+    return l->boot + local * 1000000 / (1000000 + l->drift);
+}
+
+// Fake radio: when (true time) light l gets a frame the coordinator sent at t
+static int64_t deliver(const light_t *l, int64_t t) {
+    return t + l->hops * HOP_DELAY + rnd(RX_JITTER);
+}
+
+// One scheduled start across the room; returns first to last start (μs)
+static int64_t simulate_round(light_t *lights, uint8_t max_hops) {
+    int64_t t_ref = 3600000000LL + rnd(1000000000); // true time of the time reference groupcast
+    uint32_t ref_ms = rnd(UINT32_MAX); // coordinator clock (ms) at that time; any value, it wraps
+    int64_t gap = 100000 + rnd(10000000); // then the scheduled start command
+    uint32_t start_ms = ref_ms + (gap + 200000 + rnd(30000000)) / 1000; // starting up to 30 s later
+
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (int i = 0; i < LIGHTS; i++) {
+        light_t *l = &lights[i];
+        l->boot = rnd(3600000000U);
+        l->drift = (int32_t) rnd(2 * MAX_DRIFT) - MAX_DRIFT;
+        l->hops = rnd(max_hops);
+
+        fake_now = local_of(l, deliver(l, t_ref));
+        sync_clock_set_reference(ref_ms);
+
+        fake_now = local_of(l, deliver(l, t_ref + gap));
+        int64_t deadline;
+        esp_err_t err = sync_clock_to_local(start_ms, &deadline);
+        assert(err == ESP_OK);
+
+        int64_t start = true_of(l, deadline) + rnd(WAKE_JITTER);
+        first = start < first ? start : first;
+        last = start > last ? start : last;
+    }
+
+    return last - first;
+}
+
+static void test_room(uint8_t max_hops, bool must_hold) {
+    light_t lights[LIGHTS];
+    int64_t worst = 0, sum = 0;
+
+    for (int r = 0; r < ROUNDS; r++) {
+        int64_t skew = simulate_round(lights, max_hops);
+        worst = skew > worst ? skew : worst;
+        sum += skew;
+    }
+    printf("%d lights, up to %d hop(s), %d rounds: skew mean %.2f ms, max %.2f ms\n", LIGHTS, max_hops + 1, ROUNDS,
+            sum / (double) ROUNDS / 1000, worst / 1000.0);
+    if (must_hold) {
+        assert(worst < MAX_SKEW);
+    }
+}
+
+static void test_edges() {
+    int64_t local;
+
+    // (fresh process: no reference yet)
+    fake_now = 1000000;
+    assert(sync_clock_to_local(1234, &local) == ESP_ERR_INVALID_STATE);
+
+    sync_clock_set_reference(UINT32_MAX - 500); // reference clock about to wrap
+    assert(sync_clock_to_local(499, &local) == ESP_OK); // 1 s later, past the wrap
+    assert(local == 1000000 + 1000000);
+    assert(sync_clock_to_local(UINT32_MAX - 600, &local) == ESP_ERR_INVALID_ARG); // in the past
+    assert(sync_clock_to_local(UINT32_MAX - 500, &local) == ESP_ERR_INVALID_ARG); // right now
+    assert(sync_clock_to_local(UINT32_MAX - 500 + SYNC_CLOCK_MAX_AHEAD, &local) == ESP_OK);
+    assert(sync_clock_to_local(UINT32_MAX - 500 + SYNC_CLOCK_MAX_AHEAD + 1, &local) == ESP_ERR_INVALID_ARG);
+}
+
+int main() {
+    test_edges();
+    test_room(0, true); // neighbors of the sender: what the skew promise covers
+    test_room(2, false); // relayed frames: each hop adds its rebroadcast delay (informative)
+    printf("ok\n");
+
+    return 0;
+}
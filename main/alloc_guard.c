@@ -0,0 +1,118 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <assert.h>
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+
+#include "alloc_guard.h"
+#include "executor.h"
+
+#define REPORT_EVERY 10000 // ms; how often to check for (and log) new offenders
+#if CONFIG_HEAP_USE_HOOKS
+#define HOOKED 1
+#else
+#define HOOKED 0 // nothing gets flagged
+#endif
+
+static const char *TAG = "ALLOC_GUARD";
+
+static portMUX_TYPE ag_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static TaskHandle_t ag_tasks[ALLOC_GUARD_MAX_TASKS];
+static uint8_t ag_num_tasks = 0;
+volatile static uint8_t ag_allowed[ALLOC_GUARD_MAX_TASKS]; // allow_begin() depth per watched task
+volatile static bool ag_armed = false;
+volatile static uint32_t ag_count = 0; // allocations from watched tasks after init
+volatile static size_t ag_last_size = 0; // ... the last one: size
+volatile static TaskHandle_t ag_last_task = NULL; // ... task
+volatile static void *ag_last_caller = NULL; // ... and (approximate) caller
+
+static void alloc_guard_report(void *arg);
+static ex_timer_t ag_timer = EX_TIMER_INIT(alloc_guard_report, NULL);
+
+#if CONFIG_HEAP_USE_HOOKS
+// Called by the heap on every successful allocation; keep it short (and no logging)
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    if (!ag_armed) {
+        return;
+    }
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < ag_num_tasks; i++) {
+        if (ag_tasks[i] == current) {
+            if (ag_allowed[i]) {
+                break;
+            }
+            ag_count++;
+            ag_last_size = size;
+            ag_last_task = current;
+            ag_last_caller = __builtin_return_address(0);
+            assert(!ALLOC_GUARD_ASSERT);
+            break;
+        }
+    }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+}
+#endif
+
+static void alloc_guard_report(void *arg) {
+    static uint32_t reported = 0;
+    uint32_t count = ag_count;
+
+    if (count != reported) {
+        ESP_LOGW(TAG, "%lu allocation(s) after init (last: %u bytes, task %s, from %p)", count - reported,
+                ag_last_size, ag_last_task ? pcTaskGetName(ag_last_task) : "?", ag_last_caller);
+        reported = count;
+    }
+    executor_schedule(&ag_timer, REPORT_EVERY);
+}
+
+esp_err_t alloc_guard_watch(TaskHandle_t task) {
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&ag_spinlock);
+    if (ag_num_tasks < ALLOC_GUARD_MAX_TASKS) {
+        ag_tasks[ag_num_tasks++] = task;
+    } else {
+        ret = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&ag_spinlock);
+
+    return ret;
+}
+
+// Adjust the allow_begin() depth of the current task (if watched)
+static void allow(int8_t delta) {
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+
+    taskENTER_CRITICAL(&ag_spinlock);
+    for (int i = 0; i < ag_num_tasks; i++) {
+        if (ag_tasks[i] == current) {
+            ag_allowed[i] += delta;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&ag_spinlock);
+}
+
+void alloc_guard_allow_begin() {
+    allow(1);
+}
+
+void alloc_guard_allow_end() {
+    allow(-1);
+}
+
+void alloc_guard_arm() {
+    ESP_LOGI(TAG, "Heap after init: %u free, %u min free, %u largest block; watching %u task(s)%s",
+            heap_caps_get_free_size(MALLOC_CAP_DEFAULT), heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+            heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT), ag_num_tasks,
+            HOOKED ? "" : " (no CONFIG_HEAP_USE_HOOKS → not really)");
+    ag_armed = true;
+    executor_schedule(&ag_timer, REPORT_EVERY);
+}
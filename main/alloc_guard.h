@@ -0,0 +1,44 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Watches for heap allocations made by firmware-owned tasks after
+ * init (which, with STATIC_ALLOCATION, shouldn't happen), via the heap
+ * allocation hook (CONFIG_HEAP_USE_HOOKS). Also reports the heap watermarks
+ * at the end of boot.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ALLOC_GUARD_MAX_TASKS 4
+#define ALLOC_GUARD_ASSERT 0 // 1 = abort on the first offending allocation (to catch it in the act)
+
+// Watch allocations made from given (firmware-owned) task
+//
+// Only tasks running nothing but our code qualify (not Zigbee_main, nor the
+// esp_timer task, which allocate on behalf of the stacks).
+esp_err_t alloc_guard_watch(TaskHandle_t task);
+
+// Init is over: report heap watermarks and start flagging allocations
+void alloc_guard_arm();
+
+// Let the current task allocate until alloc_guard_allow_end() (nests)
+//
+// For work that allocates inside esp-idf by design, e.g. NVS (nvs_open,
+// commits) on the executor; everything else it does stays watched.
+void alloc_guard_allow_begin();
+void alloc_guard_allow_end();
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,166 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "esp_check.h"
+#include "ha/esp_zigbee_ha_standard.h"
+#include "zboss_api.h"
+
+#include "antenna_diversity.h"
+#include "antenna_diversity_policy.h"
+#include "executor.h"
+#include "global_config.h"
+#include "light_config.h"
+#include "rfswitch.h"
+#include "router_stats.h"
+#include "stream.h"
+#include "trace.h"
+
+#define PROBE_EVERY (15 * 60 * 1000) // ms
+#define FIRST_PROBE_AFTER (60 * 1000) // ms; let the network settle after boot
+#define PING_TIMEOUT 500 // ms; per antenna, no answer → no link
+
+static const char *TAG = "ANTENNA_DIVERSITY";
+volatile static bool ad_initialized = false;
+
+// Probe state; only touched from zigbee context
+typedef enum {
+    AD_Idle,
+    AD_Current, // pinging on the antenna in use
+    AD_Other, // pinging on the other one
+} ad_phase;
+
+static ad_phase ad_probe = AD_Idle;
+static uint8_t ad_seq = 0; // ping in flight (stale answers and timeouts are ignored)
+static uint16_t ad_parent;
+static bool ad_external; // antenna in use when the probe started
+static ad_link ad_current;
+static uint8_t ad_wins = 0;
+
+static void ping_parent();
+
+static void probe_done(ad_link other) {
+    ad_probe = AD_Idle;
+
+    if (light_config->rf_switch_external != ad_external) {
+        // Changed by hand meanwhile; that wins
+        rf_switch_set(light_config->rf_switch_external);
+        ad_wins = 0;
+        return;
+    }
+
+    bool change = ad_should_switch(&ad_wins, ad_current, other);
+    TRACE(antenna_probe, change, ad_current.lqi, other.lqi, ad_external);
+    ESP_LOGI(TAG, "%s: %s %d dBm%s, %s %d dBm%s", change ? "switching" : "staying",
+            ad_external ? "u.fl" : "built-in", ad_current.rssi, ad_current.valid ? "" : " (no answer)",
+            ad_external ? "built-in" : "u.fl", other.rssi, other.valid ? "" : " (no answer)");
+
+    if (change) {
+        bool external = !ad_external;
+        light_config_update(LCFV_rf_switch_external, external); // (→ rf_switch_set)
+        light_config_persist_var(LCFV_rf_switch_external);
+        esp_zb_zcl_set_manufacturer_attribute_val(MY_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_BASIC,
+                ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, MY_MANUF_CODE, MY_MANUF_ATTR_RF_SWITCH_EXTERNAL, &external, false);
+    } else {
+        rf_switch_set(ad_external);
+    }
+}
+
+static void phase_done(ad_link link) {
+    ad_seq++; // whichever of answer/timeout comes second is stale now
+
+    if (ad_probe == AD_Current) {
+        ad_current = link;
+        ad_probe = AD_Other;
+        rf_switch_set(!ad_external);
+        ping_parent();
+    } else if (ad_probe == AD_Other) {
+        probe_done(link);
+    }
+}
+
+static void ping_answer(esp_zb_zdp_status_t zdo_status, esp_zb_ieee_addr_t ieee_addr, void *user_ctx) {
+    if ((uint8_t) (uintptr_t) user_ctx != ad_seq) {
+        return;
+    }
+
+    ad_link link = { false, 0, 0 };
+    if (zdo_status == ESP_ZB_ZDP_STATUS_SUCCESS) {
+        // The answer is the last frame from the parent → link quality on this antenna
+        link.valid = zb_zdo_get_diag_data(ad_parent, &link.lqi, &link.rssi);
+    }
+    phase_done(link);
+}
+
+static void ping_timeout(uint8_t seq) {
+    if (seq == ad_seq) {
+        phase_done((ad_link) { false, 0, 0 });
+    }
+}
+
+// Ask the parent for its own ieee address; smallest unicast round trip there is
+static void ping_parent() {
+    esp_zb_zdo_ieee_addr_req_param_t req = {
+        .dst_nwk_addr = ad_parent,
+        .addr_of_interest = ad_parent,
+        .request_type = 0, // single device
+        .start_index = 0,
+    };
+
+    esp_zb_zdo_ieee_addr_req(&req, ping_answer, (void *) (uintptr_t) ad_seq);
+    esp_zb_scheduler_alarm(ping_timeout, ad_seq, PING_TIMEOUT);
+}
+
+// Runs in zigbee context
+static void probe_start(uint8_t unused) {
+    uint8_t lqi;
+    int8_t rssi;
+
+    if (ad_probe != AD_Idle || !router_stats_parent_link(&ad_parent, &lqi, &rssi)) {
+        return;
+    }
+    ad_external = light_config->rf_switch_external;
+    ad_probe = AD_Current;
+    ping_parent();
+}
+
+static void probe_kick(void *arg);
+static ex_timer_t ad_timer = EX_TIMER_INIT(probe_kick, NULL);
+
+// Executor handler: every PROBE_EVERY, hand the probe over to zigbee
+static void probe_kick(void *arg) {
+    executor_schedule(&ad_timer, PROBE_EVERY);
+
+    if (!light_config->rf_switch_auto || stream_active()) {
+        return; // (don't disturb streaming)
+    }
+    if (!esp_zb_is_started() || !esp_zb_bdb_dev_joined()) {
+        return;
+    }
+    if (!esp_zb_lock_acquire(pdMS_TO_TICKS(50))) {
+        ESP_LOGD(TAG, "zigbee busy, skipping probe");
+        return;
+    }
+    esp_zb_scheduler_alarm(probe_start, 0, 0);
+    esp_zb_lock_release();
+}
+
+esp_err_t antenna_diversity_initialize() {
+    if (ad_initialized) {
+        ESP_LOGW(TAG, "Attempted to initialize antenna diversity more than once");
+        return ESP_OK;
+    }
+
+    if (RF_SWITCH_GPIO < 0) {
+        ESP_LOGI(TAG, "NOT starting (rf switch disabled)");
+        return ESP_OK;
+    }
+
+    executor_schedule(&ad_timer, FIRST_PROBE_AFTER);
+    ad_initialized = true;
+    ESP_LOGI(TAG, "Initialized");
+
+    return ESP_OK;
+}
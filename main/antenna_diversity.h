@@ -0,0 +1,27 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Antenna diversity for the XIAO RF switch. When enabled
+ * (rf_switch_auto), every so often the link to the parent is probed on both
+ * antennas -- a ZDO ping each, the other antenna only for the round trip --
+ * and the better one (with hysteresis) is kept and persisted as
+ * rf_switch_external.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+// Initialize antenna diversity (arms the periodic probe; runs on the executor)
+esp_err_t antenna_diversity_initialize();
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,25 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "antenna_diversity_policy.h"
+
+bool ad_should_switch(uint8_t *wins, ad_link current, ad_link other) {
+    if (!other.valid) {
+        *wins = 0;
+        return false;
+    }
+    // (a lost ping on the current antenna is a win too, but one isn't enough:
+    // near the sensitivity both antennas lose some, and we'd flap)
+    if (current.valid && other.rssi - current.rssi < AD_HYSTERESIS_DB) {
+        *wins = 0;
+        return false;
+    }
+    if (++*wins < AD_SWITCH_AFTER) {
+        return false;
+    }
+    *wins = 0;
+    return true;
+}
@@ -0,0 +1,36 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: When antenna diversity moves to the other antenna, given one
+ * probe of the parent link on each; pure (no I/O), so the host tests can
+ * run it against a link model.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AD_HYSTERESIS_DB 6 // the other antenna must be this much better (rssi)...
+#define AD_SWITCH_AFTER 3 // ...in this many consecutive probes (see host_test/test_antenna_diversity.c)
+
+typedef struct {
+    bool valid; // got an answer
+    uint8_t lqi;
+    int8_t rssi;
+} ad_link;
+
+// Whether to move to the other antenna; wins carries the hysteresis state
+// between probes (start at 0)
+bool ad_should_switch(uint8_t *wins, ad_link current, ad_link other);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,123 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <stddef.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp_check.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "calibration.h"
+#include "global_config.h"
+#include "light_driver.h"
+
+_Static_assert(sizeof(calib_profile_t) == 1968, "calib_profile_t layout must match calib_profile.py");
+
+static const char *TAG = "CALIBRATION";
+volatile static bool cal_initialized = false;
+static const calib_profile_t *cal_profile = NULL; // points into mapped flash
+static esp_partition_mmap_handle_t cal_mmap_handle;
+
+#define FLASH_GPIO_MASK (0x7fULL << 24) // GPIO24..30 drive the SPI flash (ESP32-C6)
+#define FIRMWARE_GPIO_MASK ((1ULL << RESET_BUTTON_GPIO) | (1ULL << RGB_INDICATOR_GPIO) | \
+        (RF_SWITCH_GPIO >= 0 ? 1ULL << RF_SWITCH_GPIO : 0)) // taken by the rest of the firmware
+
+// Check gpio can drive a channel: a real output, not the flash, not used elsewhere
+static bool valid_channel_gpio(int8_t gpio) {
+    return GPIO_IS_VALID_OUTPUT_GPIO(gpio) && !((FLASH_GPIO_MASK | FIRMWARE_GPIO_MASK) & (1ULL << gpio));
+}
+
+// Check the mapped profile is complete, intact and sane
+static esp_err_t validate(const calib_profile_t *p) {
+    if (memcmp(p->magic, CALIB_MAGIC, sizeof(p->magic)) != 0) {
+        return ESP_ERR_NOT_FOUND; // empty partition
+    }
+    if (p->version != CALIB_VERSION || p->size != sizeof(calib_profile_t)) {
+        ESP_LOGW(TAG, "unsupported profile version %u (size %u)", p->version, p->size);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    size_t skip = offsetof(calib_profile_t, crc) + sizeof(p->crc);
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *) p + skip, sizeof(calib_profile_t) - skip);
+    if (crc != p->crc) {
+        ESP_LOGW(TAG, "crc mismatch: 0x%08lx != 0x%08lx", crc, p->crc);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    for (int c = 0; c < CALIB_CHANNELS; c++) {
+        const calib_curve_t *curve = &p->color[c];
+        if (curve->size < 2 || curve->size > CALIB_MAX_KNOTS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        for (int i = 1; i < curve->size; i++) {
+            if (curve->knots[i] <= curve->knots[i - 1]) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+    }
+    if (p->pwm_freq && (p->pwm_freq < LD_MIN_PWM_FREQ || p->pwm_freq > LD_MAX_PWM_FREQ)) {
+        ESP_LOGW(TAG, "pwm frequency %lu Hz out of range", p->pwm_freq);
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint64_t pins = 0;
+    for (int i = 0; i < CALIB_GPIOS; i++) {
+        if (p->gpio[i] < 0) {
+            continue; // (default)
+        }
+        if (!valid_channel_gpio(p->gpio[i]) || (pins & (1ULL << p->gpio[i]))) {
+            ESP_LOGW(TAG, "gpio %d unusable for channel %d (or used twice)", p->gpio[i], i);
+            return ESP_ERR_INVALID_ARG;
+        }
+        pins |= 1ULL << p->gpio[i];
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t calibration_initialize() {
+    if (cal_initialized) {
+        ESP_LOGW(TAG, "Already initialized, skip");
+        return ESP_OK;
+    }
+    cal_initialized = true;
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, CALIB_PARTITION_SUBTYPE,
+            CALIB_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGI(TAG, "No calibration partition, using compiled-in tables");
+        return ESP_OK;
+    }
+    if (part->size < sizeof(calib_profile_t)) {
+        ESP_LOGW(TAG, "Calibration partition too small, using compiled-in tables");
+        return ESP_OK;
+    }
+
+    const void *ptr;
+    esp_err_t err = esp_partition_mmap(part, 0, sizeof(calib_profile_t), ESP_PARTITION_MMAP_DATA, &ptr,
+            &cal_mmap_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "can't mmap calibration: %s", esp_err_to_name(err));
+        return ESP_OK;
+    }
+
+    err = validate(ptr);
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No valid calibration profile (%s), using compiled-in tables", esp_err_to_name(err));
+        esp_partition_munmap(cal_mmap_handle);
+        return ESP_OK;
+    }
+
+    cal_profile = ptr;
+    ESP_LOGI(TAG, "Using calibration profile \"%.*s\"", (int) sizeof(cal_profile->name), cal_profile->name);
+
+    return ESP_OK;
+}
+
+const calib_profile_t *calibration_get() {
+    return cal_profile;
+}
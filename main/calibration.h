@@ -0,0 +1,65 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Fixture calibration profile (color model, brightness curves, pwm
+ * parameters, channel gpios), memory-mapped from the "calib" partition and
+ * used in place (zero copy). Without a valid profile, the compiled-in
+ * tables are used. Profiles are built by calib_profile.py.
+ *
+ * Profile format (little endian): calib_profile_t, with crc32 over
+ * everything after the crc field.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define CALIB_PARTITION_LABEL "calib"
+#define CALIB_PARTITION_SUBTYPE 0x40 // custom data subtype (see partitions.csv)
+#define CALIB_MAGIC "E32C"
+#define CALIB_VERSION 1
+#define CALIB_CHANNELS 3 // normal, cold, warm
+#define CALIB_GPIOS 5 // ledc channels
+#define CALIB_MAX_KNOTS 32
+#define CALIB_ONE 65535 // 1.0 in the Q16 curves
+
+typedef struct calib_curve_s {
+    uint8_t size; // knots used (2..CALIB_MAX_KNOTS)
+    uint8_t reserved;
+    uint16_t knots[CALIB_MAX_KNOTS]; // mireds, ascending
+    uint16_t values[CALIB_MAX_KNOTS]; // Q16 channel fraction
+} calib_curve_t;
+
+typedef struct calib_profile_s { // all fields naturally aligned (no padding)
+    char magic[4]; // CALIB_MAGIC
+    uint8_t version; // CALIB_VERSION
+    uint8_t reserved;
+    uint16_t size; // sizeof(calib_profile_t)
+    uint32_t crc; // crc32 of the rest
+    char name[16]; // profile name (not terminated if 16 long)
+    uint32_t pwm_freq; // Hz, 0 = default
+    int8_t gpio[CALIB_GPIOS]; // gpio per ledc channel, -1 = default
+    uint8_t reserved2[3];
+    calib_curve_t color[CALIB_CHANNELS]; // color model (channel mix) per channel
+    uint16_t brightness[CALIB_CHANNELS][256]; // Q16 brightness curve per channel, by level
+    uint16_t reserved3;
+} calib_profile_t;
+
+// Initialize calibration (maps and validates the profile, if any)
+esp_err_t calibration_initialize();
+
+// Active calibration profile (in flash), NULL = use compiled-in tables
+const calib_profile_t *calibration_get();
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,56 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "color_model.h"
+#include "color_model_data.h"
+
+typedef struct {
+    uint8_t size;
+    const uint16_t *knots; // mireds, ascending
+    const uint16_t *values; // Q16 channel fraction at the knots
+} cm_curve;
+
+static const uint16_t cm_normal_knots[] = COLOR_MODEL_NORMAL_KNOTS;
+static const uint16_t cm_normal_values[] = COLOR_MODEL_NORMAL_VALUES;
+static const uint16_t cm_cold_knots[] = COLOR_MODEL_COLD_KNOTS;
+static const uint16_t cm_cold_values[] = COLOR_MODEL_COLD_VALUES;
+static const uint16_t cm_warm_knots[] = COLOR_MODEL_WARM_KNOTS;
+static const uint16_t cm_warm_values[] = COLOR_MODEL_WARM_VALUES;
+
+static cm_curve cm_curves[] = {
+    [CM_Normal] = { COLOR_MODEL_NORMAL_SIZE, cm_normal_knots, cm_normal_values },
+    [CM_Cold] = { COLOR_MODEL_COLD_SIZE, cm_cold_knots, cm_cold_values },
+    [CM_Warm] = { COLOR_MODEL_WARM_SIZE, cm_warm_knots, cm_warm_values },
+};
+
+void color_model_use(cm_channel channel, uint8_t size, const uint16_t *knots, const uint16_t *values) {
+    cm_curves[channel] = (cm_curve) { size, knots, values };
+}
+
+uint16_t color_model_eval(cm_channel channel, int32_t temperature) {
+    const cm_curve *c = &cm_curves[channel];
+    const int32_t min = c->knots[0] << CM_FRAC_BITS;
+    const int32_t max = c->knots[c->size - 1] << CM_FRAC_BITS;
+
+    if (temperature <= min) {
+        return c->values[0];
+    } else if (temperature >= max) {
+        return c->values[c->size - 1];
+    }
+
+    // Few knots per curve; linear scan beats anything fancier
+    uint8_t i = 1;
+    while (i < c->size - 1 && (c->knots[i] << CM_FRAC_BITS) <= temperature) {
+        i++;
+    }
+
+    int32_t k0 = c->knots[i - 1] << CM_FRAC_BITS;
+    int32_t k1 = c->knots[i] << CM_FRAC_BITS;
+    int32_t v0 = c->values[i - 1];
+    int32_t v1 = c->values[i];
+
+    return v0 + (v1 - v0) * (temperature - k0) / (k1 - k0);
+}
@@ -0,0 +1,40 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Fixed-point piecewise-linear color model (channel mix for given
+ * color temperature), fitted to the Hue dump by color_fit.py.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define CM_FRAC_BITS 4 // fractional mired bits of the temperature argument
+#define CM_ONE 65535 // channel fraction of 1.0 (Q16)
+
+typedef enum cm_channel {
+	CM_Normal,
+	CM_Cold,
+	CM_Warm,
+} cm_channel;
+
+// Use given curve (e.g. from calibration; not copied, must stay valid) instead of the compiled-in one
+//
+// Knots (mireds) must be ascending, values are Q16 (0..CM_ONE); size >= 2.
+void color_model_use(cm_channel channel, uint8_t size, const uint16_t *knots, const uint16_t *values);
+
+// Channel fraction (0..CM_ONE) at given temperature (mireds << CM_FRAC_BITS)
+//
+// Temperature is clamped to the model range, so anything goes.
+uint16_t color_model_eval(cm_channel channel, int32_t temperature);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
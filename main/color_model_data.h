@@ -0,0 +1,26 @@
+/*
+ * ESP32 White Ambiance
+ *
+ * This "code" is licensed under CC0, as it's fitted to the Philips White
+ * Ambiance light PWM data (see data_tables.h).
+ *
+ * Purpose: Piecewise-linear color model knots, generated by color_fit.py
+ * (relative 0.15, tolerance 0.015, floor 0.001, smooth 0) -- don't edit by hand.
+ */
+
+#pragma once
+
+#define COLOR_MODEL_MIN_TEMPERATURE 153
+#define COLOR_MODEL_MAX_TEMPERATURE 454
+
+#define COLOR_MODEL_NORMAL_SIZE 18
+#define COLOR_MODEL_NORMAL_KNOTS {153, 191, 223, 246, 247, 248, 255, 267, 294, 348, 434, 448, 449, 450, 451, 452, 453, 454}
+#define COLOR_MODEL_NORMAL_VALUES {6293, 27116, 46412, 61052, 61052, 63407, 65535, 64503, 50245, 28933, 4424, 1053, 1052, 590, 590, 147, 147, 0}
+
+#define COLOR_MODEL_COLD_SIZE 21
+#define COLOR_MODEL_COLD_KNOTS {153, 253, 265, 266, 267, 268, 269, 270, 273, 278, 298, 326, 370, 422, 441, 442, 445, 446, 447, 448, 454}
+#define COLOR_MODEL_COLD_VALUES {65535, 64825, 58515, 56493, 56493, 54395, 54395, 52379, 51016, 46035, 33144, 20987, 9662, 2304, 727, 471, 336, 201, 201, 68, 0}
+
+#define COLOR_MODEL_WARM_SIZE 32
+#define COLOR_MODEL_WARM_KNOTS {153, 155, 156, 157, 158, 159, 160, 163, 164, 165, 168, 191, 207, 216, 221, 226, 229, 230, 233, 234, 237, 238, 239, 240, 243, 244, 245, 246, 249, 250, 266, 454}
+#define COLOR_MODEL_WARM_VALUES {0, 0, 346, 346, 709, 709, 1519, 1901, 2754, 2754, 4030, 13203, 21617, 27731, 30242, 34733, 36656, 38640, 39622, 41726, 42764, 44980, 44980, 47278, 48404, 50841, 50841, 53409, 54865, 57056, 65535, 65535}
@@ -5,7 +5,7 @@
  * This code is licensed under GPL version 3.
  *
  * Purpose: Takes care of delayed saving into flash, triggered from
- * light_config, and calls back into it.
+ * light_config, and calls back into it (to queue the actual writes).
  */
 
 #pragma once
@@ -14,6 +14,8 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 // Delayed save types (variables) that are suported.
 typedef enum delayed_save_type {
 	DS_onoff,
@@ -24,9 +26,12 @@ typedef enum delayed_save_type {
 // Trigger delayed save for a given variable type, from globals.
 void trigger_delayed_save(delayed_save_type type);
 
-// Create delayed save task that gets triggered by trigger_delayed_save().
-// Must be created before trigger_delayed_save() is called.
-void create_delayed_save_task();
+// Suspend (or resume) saving; triggered saves are held back until resumed.
+void delayed_save_suspend(bool suspend);
+
+// Initialize delayed save (runs on the executor, triggered by trigger_delayed_save()).
+// Must be called before trigger_delayed_save() is.
+void delayed_save_initialize();
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,47 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Temporal dithering of a duty with DITHER_BITS extra fractional
+ * bits: first-order sigma-delta between the two adjacent duty codes, one
+ * step per dither_period(). Pure, so the host tests can simulate the output.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define DITHER_BITS 4 // 16 ticks per cycle → lowest dither tone at 1/(16 * dither_period())
+#define DITHER_MASK ((1 << DITHER_BITS) - 1)
+#define DITHER_PERIOD 500 // μs; at most (see dither_period), so the tone stays ≥ 125 Hz
+
+// Dither tick period (μs) at given pwm frequency: whole PWM periods, as many
+// as fit in DITHER_PERIOD (ledc only latches a new duty at the end of a period,
+// so with any other tick the on-times come out uneven and skew the average);
+// more than DITHER_PERIOD below 2 kHz, where the tone would be visible
+static inline uint32_t dither_period(uint32_t pwm_freq) {
+    uint32_t periods = (uint64_t) DITHER_PERIOD * pwm_freq / 1000000;
+    if (periods == 0) {
+        periods = 1;
+    }
+    return ((uint64_t) periods * 1000000 + pwm_freq / 2) / pwm_freq;
+}
+
+// Next duty code for fine duty target (in 1/(1 << DITHER_BITS) counts);
+// *acc carries the error between steps (start at 0)
+static inline uint32_t dither_step(uint32_t target, uint32_t *acc) {
+    *acc += target & DITHER_MASK;
+    uint32_t duty = (target >> DITHER_BITS) + (*acc >> DITHER_BITS);
+    *acc &= DITHER_MASK;
+    return duty;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
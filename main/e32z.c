@@ -0,0 +1,186 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_rom_crc.h"
+
+#include "e32z.h"
+
+#define E32Z_VERSION 1
+#define E32Z_FLAG_DELTA 0x01
+#define BASE_CHUNK 64 // bytes read from the base image at once
+
+static const char *TAG = "E32Z";
+
+enum {
+    S_HEADER,
+    S_TOKEN,
+    S_LITERAL,
+    S_WINDOW_DIST0,
+    S_WINDOW_DIST1,
+    S_BASE_LEN,
+    S_BASE_OFF0,
+    S_BASE_OFF1,
+    S_BASE_OFF2,
+};
+
+void e32z_init(e32z_decoder_t *d, e32z_write_fn write, e32z_read_base_fn read_base, const uint8_t *base_sha, void *ctx) {
+    memset(d, 0, sizeof(*d));
+    d->write = write;
+    d->read_base = read_base;
+    d->base_sha = base_sha;
+    d->ctx = ctx;
+    d->state = S_HEADER;
+}
+
+static esp_err_t flush(e32z_decoder_t *d) {
+    if (d->out_len == 0) {
+        return ESP_OK;
+    }
+    d->running_crc = esp_rom_crc32_le(d->running_crc, d->out, d->out_len);
+    esp_err_t ret = d->write(d->out, d->out_len, d->ctx);
+    d->out_len = 0;
+    return ret;
+}
+
+static esp_err_t emit(e32z_decoder_t *d, uint8_t b) {
+    if (d->produced >= d->size) {
+        ESP_LOGW(TAG, "output exceeds declared size %lu", d->size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    d->produced++;
+    d->window[d->window_pos] = b;
+    d->window_pos = (d->window_pos + 1) % E32Z_WINDOW;
+    d->out[d->out_len++] = b;
+    return d->out_len == sizeof(d->out) ? flush(d) : ESP_OK;
+}
+
+static esp_err_t window_copy(e32z_decoder_t *d, uint16_t len, uint32_t dist) {
+    if (dist > E32Z_WINDOW || dist > d->produced) {
+        ESP_LOGW(TAG, "window copy distance %lu out of range", dist);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        // byte by byte, so overlapping copies (runs) work
+        ESP_RETURN_ON_ERROR(emit(d, d->window[(d->window_pos + E32Z_WINDOW - dist) % E32Z_WINDOW]), TAG, "window copy");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t base_copy(e32z_decoder_t *d, uint16_t len, uint32_t offset) {
+    uint8_t buf[BASE_CHUNK];
+
+    if (!d->delta) {
+        ESP_LOGW(TAG, "base copy in non-delta stream");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    while (len > 0) {
+        size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+        ESP_RETURN_ON_ERROR(d->read_base(offset, buf, chunk, d->ctx), TAG, "base read at %lu", offset);
+        for (size_t i = 0; i < chunk; i++) {
+            ESP_RETURN_ON_ERROR(emit(d, buf[i]), TAG, "base copy");
+        }
+        offset += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(e32z_decoder_t *d) {
+    const uint8_t *h = d->header;
+
+    if (memcmp(h, "E32Z", 4) != 0 || h[4] != E32Z_VERSION) {
+        ESP_LOGW(TAG, "bad magic or version");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    d->delta = h[5] & E32Z_FLAG_DELTA;
+    memcpy(&d->size, h + 8, sizeof(d->size));
+    memcpy(&d->crc, h + 12, sizeof(d->crc));
+    if (d->delta && (!d->read_base || !d->base_sha || memcmp(h + 16, d->base_sha, 8) != 0)) {
+        ESP_LOGW(TAG, "delta image built against a different base");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    ESP_LOGI(TAG, "stream: %lu bytes, %s", d->size, d->delta ? "delta" : "full");
+    return ESP_OK;
+}
+
+esp_err_t e32z_feed(e32z_decoder_t *d, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        switch (d->state) {
+            case S_HEADER:
+                d->header[d->arg++] = b;
+                if (d->arg == E32Z_HEADER_SIZE) {
+                    ESP_RETURN_ON_ERROR(parse_header(d), TAG, "header");
+                    d->state = S_TOKEN;
+                }
+                break;
+            case S_TOKEN:
+                d->token = b;
+                if (b < 0x80) {
+                    d->arg = b + 1;
+                    d->state = S_LITERAL;
+                } else if (b < 0xc0) {
+                    d->state = S_WINDOW_DIST0;
+                } else {
+                    d->state = S_BASE_LEN;
+                }
+                break;
+            case S_LITERAL:
+                ESP_RETURN_ON_ERROR(emit(d, b), TAG, "literal");
+                if (--d->arg == 0) {
+                    d->state = S_TOKEN;
+                }
+                break;
+            case S_WINDOW_DIST0:
+                d->arg2 = b;
+                d->state = S_WINDOW_DIST1;
+                break;
+            case S_WINDOW_DIST1:
+                d->arg2 |= b << 8;
+                ESP_RETURN_ON_ERROR(window_copy(d, (d->token & 0x3f) + 3, d->arg2 + 1), TAG, "window");
+                d->state = S_TOKEN;
+                break;
+            case S_BASE_LEN:
+                d->arg = ((d->token & 0x3f) << 8 | b) + 1;
+                d->state = S_BASE_OFF0;
+                break;
+            case S_BASE_OFF0:
+                d->arg2 = b;
+                d->state = S_BASE_OFF1;
+                break;
+            case S_BASE_OFF1:
+                d->arg2 |= b << 8;
+                d->state = S_BASE_OFF2;
+                break;
+            case S_BASE_OFF2:
+                d->arg2 |= b << 16;
+                ESP_RETURN_ON_ERROR(base_copy(d, d->arg, d->arg2), TAG, "base");
+                d->state = S_TOKEN;
+                break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t e32z_finish(e32z_decoder_t *d) {
+    ESP_RETURN_ON_ERROR(flush(d), TAG, "flush");
+
+    if (d->state != S_TOKEN || d->produced != d->size) {
+        ESP_LOGW(TAG, "truncated stream: %lu of %lu bytes", d->produced, d->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (d->running_crc != d->crc) {
+        ESP_LOGW(TAG, "crc mismatch: 0x%08lx != 0x%08lx", d->running_crc, d->crc);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    return ESP_OK;
+}
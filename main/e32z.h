@@ -0,0 +1,80 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Streaming decoder of the E32Z compressed (optionally delta against
+ * the running image) OTA format, as produced by ota_image.py.
+ *
+ * Format (little endian):
+ *   header: char magic[4] = "E32Z", u8 version (1), u8 flags (bit 0: delta),
+ *           u16 reserved, u32 output size, u32 output crc32,
+ *           u8 base elf sha256 prefix[8] (delta only, zero otherwise)
+ *   then a stream of ops, each starting with a token byte t:
+ *     0x00-0x7f: literal, t+1 bytes follow
+ *     0x80-0xbf: window copy, length (t & 0x3f) + 3, u16 distance-1 follows
+ *                (copies from the last E32Z_WINDOW bytes of output)
+ *     0xc0-0xff: base copy, length ((t & 0x3f) << 8 | u8) + 1, u24 offset follows
+ *                (copies from the running image; delta only)
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define E32Z_WINDOW 4096 // back reference window (bytes of RAM)
+#define E32Z_HEADER_SIZE 24
+
+// Sink for the decoded data
+typedef esp_err_t (*e32z_write_fn)(const uint8_t *data, size_t len, void *ctx);
+
+// Source of the base image (for delta), reading len bytes at offset
+typedef esp_err_t (*e32z_read_base_fn)(uint32_t offset, uint8_t *data, size_t len, void *ctx);
+
+typedef struct e32z_decoder_s {
+    e32z_write_fn write;
+    e32z_read_base_fn read_base;
+    const uint8_t *base_sha; // first 8 bytes of running image's elf sha256 (for delta check)
+    void *ctx;
+
+    uint8_t header[E32Z_HEADER_SIZE];
+    uint8_t state;
+    uint8_t token;
+    uint16_t arg; // bytes remaining (literal) / partially assembled argument
+    uint32_t arg2;
+    uint32_t size; // expected output size
+    uint32_t crc; // expected output crc32
+    uint32_t produced; // output so far
+    uint32_t running_crc;
+    bool delta;
+
+    uint8_t window[E32Z_WINDOW];
+    uint16_t window_pos;
+    uint8_t out[256]; // write buffer (flushed to write())
+    uint16_t out_len;
+} e32z_decoder_t;
+
+// Reset the decoder (to be fed a new stream)
+void e32z_init(e32z_decoder_t *d, e32z_write_fn write, e32z_read_base_fn read_base, const uint8_t *base_sha, void *ctx);
+
+// Feed len bytes of the compressed stream
+//
+// Returns ESP_ERR_INVALID_RESPONSE on malformed stream (or base mismatch),
+// or whatever write()/read_base() returned on their failure.
+esp_err_t e32z_feed(e32z_decoder_t *d, const uint8_t *data, size_t len);
+
+// Finish the stream: flush the output and verify size + crc
+esp_err_t e32z_finish(e32z_decoder_t *d);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
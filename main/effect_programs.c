@@ -0,0 +1,249 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+
+#include "alloc_guard.h"
+#include "effect_programs.h"
+#include "executor.h"
+#include "global_config.h"
+
+#define EFFECT_PROGRAMS_NVS_NAMESPACE "effect_programs"
+#define LIST_VERSION 1
+#define PERSIST_RETRY_MS 1000 // first retry of a failed flash write ...
+#define PERSIST_RETRY_MAX_MS (10 * 60 * 1000) // ... backing off up to this
+
+static const char *TAG = "EFFECT_PROGRAMS";
+volatile static bool ep_initialized = false;
+
+typedef struct __attribute__((packed)) {
+    uint8_t slot;
+    uint8_t reps;
+    uint8_t frames;
+    uint32_t duration;
+} ep_list_record;
+
+static portMUX_TYPE ep_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static ep_program_t ep_programs[EP_MAX_PROGRAMS]; // static slots; frame_count == 0 → empty
+static uint8_t ep_dirty = 0; // bitmap of slots to write to nvs (erase, if empty)
+_Static_assert(EP_MAX_PROGRAMS <= 8, "ep_dirty is an 8-bit bitmap of slots");
+
+static void slot_to_key(uint8_t slot, char key[NVS_KEY_NAME_MAX_SIZE]) {
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "prog%u", slot);
+}
+
+// Check the program is well-formed and exactly len bytes
+static esp_err_t validate(const uint8_t *data, size_t len) {
+    if (len < EP_PROGRAM_SIZE(1) || len > sizeof(ep_program_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const ep_program_t *p = (const ep_program_t *) data;
+    if (p->frame_count == 0 || p->frame_count > EP_MAX_FRAMES || len != EP_PROGRAM_SIZE(p->frame_count)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (p->version != EP_VERSION || p->reps == 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    for (int i = 0; i < p->frame_count; i++) {
+        const ep_frame_t *f = &p->frames[i];
+        if (f->flags & ~(EP_FRAME_ONOFF | EP_FRAME_ON | EP_FRAME_LEVEL | EP_FRAME_TEMPERATURE | EP_FRAME_ABORTABLE)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if ((f->flags & EP_FRAME_LEVEL) && (f->level == 0 || f->level == 0xff)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if ((f->flags & EP_FRAME_TEMPERATURE) &&
+                (f->temperature < COLOR_MIN_TEMPERATURE || f->temperature > COLOR_MAX_TEMPERATURE)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (f->time == 0) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t effect_programs_initialize() {
+    if (ep_initialized) {
+        ESP_LOGW(TAG, "Already initialized, skip");
+        return ESP_OK;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(EFFECT_PROGRAMS_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle); // readonly + empty flash → oops
+    ESP_RETURN_ON_ERROR(err, TAG, "can't open nvs");
+
+    for (uint8_t slot = 0; slot < EP_MAX_PROGRAMS; slot++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        size_t len = sizeof(ep_program_t);
+        slot_to_key(slot, key);
+
+        // Read straight into the slot (no heap), then drop it if it doesn't validate
+        err = nvs_get_blob(nvs_handle, key, &ep_programs[slot], &len);
+        if (err == ESP_OK && validate((const uint8_t *) &ep_programs[slot], len) == ESP_OK) {
+            ESP_LOGI(TAG, "Loaded program %u: %u frames, %u reps", slot,
+                    ep_programs[slot].frame_count, ep_programs[slot].reps);
+        } else {
+            if (err != ESP_ERR_NVS_NOT_FOUND) {
+                ESP_LOGW(TAG, "can't load program %u: %s", slot, esp_err_to_name(err == ESP_OK ? ESP_ERR_INVALID_RESPONSE : err));
+            }
+            memset(&ep_programs[slot], 0, sizeof(ep_programs[slot]));
+        }
+    }
+
+    nvs_close(nvs_handle);
+    ep_initialized = true;
+
+    return ESP_OK;
+}
+
+static void ep_persist_run(void *arg);
+static ex_timer_t ep_persist_timer = EX_TIMER_INIT(ep_persist_run, NULL);
+static uint32_t ep_persist_retry_ms = PERSIST_RETRY_MS; // (executor only)
+
+// Executor handler: write the dirty slots (current contents) with one commit
+static void ep_persist_run(void *arg) {
+    taskENTER_CRITICAL(&ep_spinlock);
+    uint8_t dirty = ep_dirty;
+    ep_dirty = 0;
+    taskEXIT_CRITICAL(&ep_spinlock);
+
+    if (!dirty) {
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    alloc_guard_allow_begin(); // (nvs allocates)
+    esp_err_t err = nvs_open(EFFECT_PROGRAMS_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        for (uint8_t slot = 0; slot < EP_MAX_PROGRAMS && err == ESP_OK; slot++) {
+            if (!(dirty & (1 << slot))) {
+                continue;
+            }
+            char key[NVS_KEY_NAME_MAX_SIZE];
+            slot_to_key(slot, key);
+
+            taskENTER_CRITICAL(&ep_spinlock);
+            ep_program_t program = ep_programs[slot];
+            taskEXIT_CRITICAL(&ep_spinlock);
+
+            if (program.frame_count > 0) {
+                err = nvs_set_blob(nvs_handle, key, &program, EP_PROGRAM_SIZE(program.frame_count));
+            } else {
+                err = nvs_erase_key(nvs_handle, key);
+                err = err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err; // (stored and deleted before it got saved)
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    alloc_guard_allow_end();
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "can't save programs (0x%02x), retry in %lu ms: %s", dirty, ep_persist_retry_ms,
+                esp_err_to_name(err));
+        taskENTER_CRITICAL(&ep_spinlock);
+        ep_dirty |= dirty;
+        taskEXIT_CRITICAL(&ep_spinlock);
+        executor_schedule(&ep_persist_timer, ep_persist_retry_ms); // (a new request retries right away)
+        ep_persist_retry_ms = ep_persist_retry_ms < PERSIST_RETRY_MAX_MS / 2 ? 2 * ep_persist_retry_ms
+                : PERSIST_RETRY_MAX_MS;
+    } else {
+        ep_persist_retry_ms = PERSIST_RETRY_MS;
+    }
+}
+
+esp_err_t effect_programs_store(uint8_t slot, const uint8_t *data, size_t len) {
+    if (slot >= EP_MAX_PROGRAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ESP_RETURN_ON_ERROR(validate(data, len), TAG, "invalid program for slot %u", slot);
+
+    taskENTER_CRITICAL(&ep_spinlock);
+    memset(&ep_programs[slot], 0, sizeof(ep_programs[slot]));
+    memcpy(&ep_programs[slot], data, len);
+    ep_dirty |= 1 << slot;
+    taskEXIT_CRITICAL(&ep_spinlock);
+    executor_schedule(&ep_persist_timer, 0);
+
+    ESP_LOGI(TAG, "Stored program %u: %u frames", slot, ((const ep_program_t *) data)->frame_count);
+
+    return ESP_OK;
+}
+
+esp_err_t effect_programs_delete(uint8_t slot) {
+    if (slot >= EP_MAX_PROGRAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&ep_spinlock);
+    bool used = ep_programs[slot].frame_count > 0;
+    memset(&ep_programs[slot], 0, sizeof(ep_programs[slot]));
+    ep_dirty |= used ? 1 << slot : 0;
+    taskEXIT_CRITICAL(&ep_spinlock);
+
+    if (!used) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    executor_schedule(&ep_persist_timer, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t effect_programs_get(uint8_t slot, ep_program_t *program) {
+    if (slot >= EP_MAX_PROGRAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&ep_spinlock);
+    *program = ep_programs[slot];
+    taskEXIT_CRITICAL(&ep_spinlock);
+
+    return program->frame_count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+size_t effect_programs_list(uint8_t *out, size_t size) {
+    size_t len = 2;
+    uint8_t used = 0;
+
+    if (size < len) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL(&ep_spinlock);
+    for (uint8_t slot = 0; slot < EP_MAX_PROGRAMS; slot++) {
+        const ep_program_t *p = &ep_programs[slot];
+        if (p->frame_count == 0 || len + sizeof(ep_list_record) > size) {
+            continue;
+        }
+
+        ep_list_record rec = { .slot = slot, .reps = p->reps, .frames = p->frame_count, .duration = 0 };
+        for (int i = 0; i < p->frame_count; i++) {
+            rec.duration += p->frames[i].time;
+        }
+        rec.duration *= p->reps;
+
+        memcpy(out + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+        used |= 1 << slot;
+    }
+    taskEXIT_CRITICAL(&ep_spinlock);
+
+    out[0] = LIST_VERSION;
+    out[1] = used;
+
+    return len;
+}
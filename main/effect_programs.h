@@ -0,0 +1,82 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: User-uploadable effect programs (custom identify-like animations),
+ * validated on upload, persisted in NVS and kept in static slots.
+ *
+ * Program format (little endian), as uploaded:
+ *   u8 version (1), u8 repetitions (1+), u8 number of frames (1..EP_MAX_FRAMES),
+ *   then per frame: u8 flags (EP_FRAME_*), u8 level (1..254),
+ *                   u16 temperature (mireds), u16 time (ms, 1+)
+ * Level/temperature are only used when flagged; unflagged values follow the
+ * current light state (like the built-in effects).
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define EP_MAX_PROGRAMS 8 // number of program slots
+#define EP_MAX_FRAMES 12 // keeps the upload within a single (unfragmented) frame
+#define EP_VERSION 1
+
+#define EP_FRAME_ONOFF 0x01 // frame sets onoff
+#define EP_FRAME_ON 0x02 // onoff value (if EP_FRAME_ONOFF)
+#define EP_FRAME_LEVEL 0x04 // frame sets level
+#define EP_FRAME_TEMPERATURE 0x08 // frame sets temperature
+#define EP_FRAME_ABORTABLE 0x10 // effect finish may stop after this frame
+
+typedef struct __attribute__((packed)) ep_frame_s {
+    uint8_t flags;
+    uint8_t level;
+    uint16_t temperature;
+    uint16_t time;
+} ep_frame_t;
+
+typedef struct __attribute__((packed)) ep_program_s {
+    uint8_t version;
+    uint8_t reps;
+    uint8_t frame_count;
+    ep_frame_t frames[EP_MAX_FRAMES];
+} ep_program_t;
+
+#define EP_PROGRAM_SIZE(n) (offsetof(ep_program_t, frames) + (n) * sizeof(ep_frame_t))
+
+// Initialize effect programs (loads stored programs from NVS)
+esp_err_t effect_programs_initialize();
+
+// Validate and store program (len bytes) into given slot (replacing what's there)
+//
+// Returns ESP_ERR_INVALID_ARG on bad slot, ESP_ERR_INVALID_SIZE on bad length
+// and ESP_ERR_INVALID_RESPONSE on invalid contents. Returns right away; the
+// flash write is queued on the executor (and retried if it fails), like the
+// delete.
+esp_err_t effect_programs_store(uint8_t slot, const uint8_t *data, size_t len);
+
+// Delete program in given slot (ESP_ERR_NOT_FOUND if empty)
+esp_err_t effect_programs_delete(uint8_t slot);
+
+// Copy program in given slot to program (ESP_ERR_NOT_FOUND if empty)
+esp_err_t effect_programs_get(uint8_t slot, ep_program_t *program);
+
+// Write the program listing to out (at most size bytes)
+//
+// Returns number of bytes written. Format (little endian):
+//   u8 version, u8 bitmap of used slots,
+//   then per used slot: u8 slot, u8 repetitions, u8 frames, u32 total duration (ms)
+size_t effect_programs_list(uint8_t *out, size_t size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
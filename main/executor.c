@@ -0,0 +1,184 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "alloc_guard.h"
+#include "executor.h"
+#include "global_config.h"
+
+#define QUEUE_LENGTH 8 // pending events
+#define STACK_SIZE 4096 // shared by all the handlers
+#define PRIORITY 3 // below the light driver (4) and zigbee (5)
+
+static const char *TAG = "EXECUTOR";
+static TaskHandle_t ex_task_handle;
+static QueueHandle_t ex_queue;
+volatile static bool ex_initialized = false;
+
+typedef struct {
+    ex_handler_t handler; // NULL = just wake up (timers changed)
+    void *arg;
+} ex_event;
+
+static portMUX_TYPE ex_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static ex_timer_t *ex_timers = NULL; // armed timers, soonest first
+static ex_stats_t ex_stats; // (written by the executor only)
+
+// Run handler, keeping the stats
+static void run_handler(ex_handler_t handler, void *arg) {
+    int64_t start = esp_timer_get_time();
+    handler(arg);
+    uint32_t took = esp_timer_get_time() - start;
+
+    taskENTER_CRITICAL(&ex_spinlock);
+    ex_stats.handlers++;
+    if (took > ex_stats.longest) {
+        ex_stats.longest = took;
+    }
+    taskEXIT_CRITICAL(&ex_spinlock);
+}
+
+// Take timer out of the list; must hold ex_spinlock
+static void unlink_timer(ex_timer_t *timer) {
+    for (ex_timer_t **p = &ex_timers; *p; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    timer->armed = false;
+    timer->next = NULL;
+}
+
+// Run due timers; returns how long to wait for the next one
+static TickType_t run_timers() {
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = portMAX_DELAY;
+
+        taskENTER_CRITICAL(&ex_spinlock);
+        ex_timer_t *timer = ex_timers;
+        if (timer && timer->at <= now) {
+            unlink_timer(timer);
+        } else {
+            if (timer) {
+                TickType_t ticks = pdMS_TO_TICKS((timer->at - now + 999) / 1000);
+                wait = ticks > 0 ? ticks : 1;
+            }
+            timer = NULL;
+        }
+        taskEXIT_CRITICAL(&ex_spinlock);
+
+        if (!timer) {
+            return wait;
+        }
+        run_handler(timer->handler, timer->arg);
+    }
+}
+
+static void executor_task(void *pvParameters) {
+    ex_event event;
+
+    while (true) {
+        TickType_t wait = run_timers();
+        bool received = xQueueReceive(ex_queue, &event, wait) == pdTRUE;
+        taskENTER_CRITICAL(&ex_spinlock);
+        ex_stats.wakeups++;
+        taskEXIT_CRITICAL(&ex_spinlock);
+        if (received && event.handler) {
+            run_handler(event.handler, event.arg);
+        }
+    }
+}
+
+esp_err_t executor_initialize() {
+    if (ex_initialized) {
+        ESP_LOGW(TAG, "Attempted to initialize executor more than once");
+        return ESP_OK;
+    }
+
+#if STATIC_ALLOCATION
+    static StaticQueue_t queue;
+    static uint8_t queue_storage[QUEUE_LENGTH * sizeof(ex_event)];
+    static StaticTask_t task;
+    static StackType_t stack[STACK_SIZE];
+    ex_queue = xQueueCreateStatic(QUEUE_LENGTH, sizeof(ex_event), queue_storage, &queue);
+    ex_task_handle = xTaskCreateStatic(executor_task, "executor", STACK_SIZE, NULL, PRIORITY, stack, &task);
+#else
+    ex_queue = xQueueCreate(QUEUE_LENGTH, sizeof(ex_event));
+    if (ex_queue) {
+        xTaskCreate(executor_task, "executor", STACK_SIZE, NULL, PRIORITY, &ex_task_handle);
+    }
+#endif
+    if (!ex_queue || !ex_task_handle) {
+        ESP_LOGE(TAG, "can't create queue/task");
+        return ESP_ERR_NO_MEM;
+    }
+    alloc_guard_watch(ex_task_handle);
+    ex_initialized = true;
+    ESP_LOGI(TAG, "Initialized");
+
+    return ESP_OK;
+}
+
+esp_err_t executor_post(ex_handler_t handler, void *arg) {
+    ex_event event = { handler, arg };
+
+    return xQueueSend(ex_queue, &event, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t IRAM_ATTR executor_post_from_isr(ex_handler_t handler, void *arg) {
+    ex_event event = { handler, arg };
+    BaseType_t woken = pdFALSE;
+
+    BaseType_t ret = xQueueSendFromISR(ex_queue, &event, &woken);
+    portYIELD_FROM_ISR(woken);
+
+    return ret == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void executor_schedule(ex_timer_t *timer, uint32_t delay_ms) {
+    int64_t at = esp_timer_get_time() + delay_ms * 1000LL;
+
+    taskENTER_CRITICAL(&ex_spinlock);
+    if (timer->armed) {
+        unlink_timer(timer);
+    }
+    ex_timer_t **p = &ex_timers;
+    while (*p && (*p)->at <= at) {
+        p = &(*p)->next;
+    }
+    timer->at = at;
+    timer->next = *p;
+    timer->armed = true;
+    *p = timer;
+    bool soonest = ex_timers == timer;
+    taskEXIT_CRITICAL(&ex_spinlock);
+
+    // The executor recomputes its wait before sleeping again; others need to wake it up
+    if (soonest && xTaskGetCurrentTaskHandle() != ex_task_handle) {
+        executor_post(NULL, NULL); // (full queue → it's awake anyway)
+    }
+}
+
+void executor_cancel(ex_timer_t *timer) {
+    taskENTER_CRITICAL(&ex_spinlock);
+    if (timer->armed) {
+        unlink_timer(timer);
+    }
+    taskEXIT_CRITICAL(&ex_spinlock);
+}
+
+void executor_get_stats(ex_stats_t *stats) {
+    taskENTER_CRITICAL(&ex_spinlock);
+    *stats = ex_stats;
+    taskEXIT_CRITICAL(&ex_spinlock);
+}
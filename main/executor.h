@@ -0,0 +1,69 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Single cooperative executor (one task, one stack) hosting the
+ * background chores -- delayed save, status indicator, indicator led, reset
+ * button, delayed reboot, health monitor and router stats sampling, flash
+ * writes of light_config and effect programs -- as
+ * handlers, instead of a task (or an esp_timer callback) each. Handlers run
+ * one at a time, to completion: either posted as events (also from ISR), or
+ * fired by one-shot timers. Keep them short; the light driver (which needs
+ * low latency) keeps its own task.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef void (*ex_handler_t)(void *arg);
+
+// One-shot timer; owned by the caller (typically static), initialize with EX_TIMER_INIT()
+typedef struct ex_timer_s {
+    ex_handler_t handler;
+    void *arg;
+    int64_t at; // when to fire (esp_timer_get_time() μs), if armed
+    bool armed;
+    struct ex_timer_s *next; // (executor's list of armed timers, soonest first)
+} ex_timer_t;
+
+#define EX_TIMER_INIT(_handler, _arg) { .handler = (_handler), .arg = (_arg), .at = 0, .armed = false, .next = NULL }
+
+typedef struct {
+    uint32_t wakeups; // times the task woke up (≈ context switches into it)
+    uint32_t handlers; // handlers run (events and timers)
+    uint32_t longest; // μs; longest handler (everything else waited that long)
+} ex_stats_t;
+
+// Initialize executor (starts its task); must come before any of the hosted modules
+esp_err_t executor_initialize();
+
+// Run handler(arg) on the executor asap
+//
+// Returns ESP_ERR_NO_MEM if the event queue is full.
+esp_err_t executor_post(ex_handler_t handler, void *arg);
+
+// Same as executor_post(), from ISR
+esp_err_t executor_post_from_isr(ex_handler_t handler, void *arg);
+
+// (Re)arm timer to fire after delay_ms (0 = asap); re-arming moves an armed timer
+void executor_schedule(ex_timer_t *timer, uint32_t delay_ms);
+
+// Disarm timer (if armed)
+void executor_cancel(ex_timer_t *timer);
+
+// Counters since boot (see health_monitor)
+void executor_get_stats(ex_stats_t *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
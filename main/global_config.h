@@ -36,23 +36,78 @@
     .app_device_version = 1, \
 }
 
+#define TRACE_ENABLED 1 // binary event trace (see trace.h); 0 compiles it out
+#define STATIC_ALLOCATION 1 // firmware-owned tasks, queues and mutexes statically allocated; 0 = from heap (see alloc_guard.h)
+
 #define COLOR_MIN_TEMPERATURE 153
 #define COLOR_MAX_TEMPERATURE 454
 
 // Custom attributes
 #define MY_MANUF_CODE 0x131B // Espressif; we can't use any other
 #define MY_MANUF_ATTR_RF_SWITCH_EXTERNAL 0x7a69 // manufacturer-specific attribute for RF switch external
+#define MY_MANUF_ATTR_RF_SWITCH_AUTO 0x7a6a // bool: antenna diversity (pick rf switch position by link quality)
+#define MY_MANUF_ATTR_PWM_FREQUENCY 0x7a90 // u16: PWM frequency (Hz, 0 = default; duty resolution follows)
+#define MY_MANUF_ATTR_DITHERING 0x7a91 // bool: temporal dithering at deep dim levels
 #define MY_MANUF_CMD_MAGIC 0x1337c0d3 // magic token to avoid accidental activation (send in network order)
 #define MY_MANUF_CMD_REBOOT 0xaa // manufacturer-specific cmd: reboot (on basic cluster)
 #define MY_MANUF_CMD_CLEAR_NVS 0xb0 // manufacturer-specific cmd: clear nvs(on basic cluster)
+#define MY_MANUF_CMD_HEALTH_DUMP 0xb1 // manufacturer-specific cmd: binary health dump (on basic cluster)
+#define MY_MANUF_CMD_TRACE_DUMP 0xb2 // manufacturer-specific cmd: binary event trace dump (on basic cluster)
+#define MY_MANUF_CMD_SET_STATE 0xc0 // manufacturer-specific cmd: set onoff+level+temperature+transition at once (on basic cluster)
+#define MY_MANUF_CMD_GET_STATE 0xc1 // manufacturer-specific cmd: packed light state snapshot (on basic cluster)
+#define MY_MANUF_CMD_TIME_REF 0xc2 // manufacturer-specific cmd: time reference for scheduled starts (on basic cluster)
+#define MY_MANUF_CMD_SCHEDULED_START 0xc3 // manufacturer-specific cmd: state/effect starting at given reference time (on basic cluster)
+#define MY_MANUF_CMD_PROGRAM_UPLOAD 0xd0 // manufacturer-specific cmd: store effect program into slot (on basic cluster)
+#define MY_MANUF_CMD_PROGRAM_LIST 0xd1 // manufacturer-specific cmd: list stored effect programs (on basic cluster)
+#define MY_MANUF_CMD_PROGRAM_DELETE 0xd2 // manufacturer-specific cmd: delete effect program (on basic cluster)
+#define MY_MANUF_CMD_PROGRAM_TRIGGER 0xd3 // manufacturer-specific cmd: play effect program (on basic cluster)
+#define MY_MANUF_CMD_STREAM_START 0xe0 // manufacturer-specific cmd: enter level/temperature streaming mode (on basic cluster)
+#define MY_MANUF_CMD_STREAM_SAMPLE 0xe1 // manufacturer-specific cmd: timestamped stream sample (on basic cluster)
+#define MY_MANUF_CMD_STREAM_STOP 0xe2 // manufacturer-specific cmd: leave streaming mode (on basic cluster)
+
+// Runtime health (manufacturer-specific, read-only attributes on basic cluster)
+#define MY_MANUF_ATTR_HEALTH_FREE_HEAP 0x7a70 // u32: free heap (bytes)
+#define MY_MANUF_ATTR_HEALTH_MIN_FREE_HEAP 0x7a71 // u32: minimum free heap since boot (bytes)
+#define MY_MANUF_ATTR_HEALTH_LARGEST_FREE_BLOCK 0x7a72 // u32: largest free heap block (bytes)
+#define MY_MANUF_ATTR_HEALTH_MIN_STACK_FREE 0x7a73 // u16: smallest stack high water mark of all tasks (bytes)
+#define MY_MANUF_ATTR_HEALTH_CPU_LOAD 0x7a74 // u16: cpu load (‰, time not spent idle)
+#define MY_MANUF_ATTR_HEALTH_LED_TRANSFERS 0x7a75 // u32: indicator led RMT transfers during the last full hour
+
+// Router statistics (manufacturer-specific, read-only attributes on basic cluster)
+#define MY_MANUF_ATTR_ROUTER_RELAYED 0x7a80 // u32: relayed unicast frames (estimate: mac tx - aps tx)
+#define MY_MANUF_ATTR_ROUTER_MAC_TX 0x7a81 // u32: mac unicast tx total
+#define MY_MANUF_ATTR_ROUTER_MAC_RETRIES 0x7a82 // u32: mac unicast tx retries
+#define MY_MANUF_ATTR_ROUTER_MAC_FAILURES 0x7a83 // u32: mac unicast tx failures
+#define MY_MANUF_ATTR_ROUTER_APS_RETRIES 0x7a84 // u32: aps unicast tx retries
+#define MY_MANUF_ATTR_ROUTER_CHILDREN 0x7a85 // u8: occupied child table entries (out of max_children)
+#define MY_MANUF_ATTR_ROUTER_NEIGHBORS 0x7a86 // u8: neighbor table entries
+#define MY_MANUF_ATTR_ROUTER_PARENT_LQI_MIN 0x7a87 // u8: parent lqi, min over the window
+#define MY_MANUF_ATTR_ROUTER_PARENT_LQI_AVG 0x7a88 // u8: parent lqi, avg over the window
+#define MY_MANUF_ATTR_ROUTER_PARENT_LQI_MAX 0x7a89 // u8: parent lqi, max over the window
+#define MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MIN 0x7a8a // s8: parent rssi (dBm), min over the window
+#define MY_MANUF_ATTR_ROUTER_PARENT_RSSI_AVG 0x7a8b // s8: parent rssi (dBm), avg over the window
+#define MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MAX 0x7a8c // s8: parent rssi (dBm), max over the window
+#define MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MIN 0x7a8d // u8: avg lqi of all neighbors, min over the window
+#define MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_AVG 0x7a8e // u8: avg lqi of all neighbors, avg over the window
+#define MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MAX 0x7a8f // u8: avg lqi of all neighbors, max over the window
+
+// OTA upgrade (zigbee OTA Upgrade cluster client)
+#define MY_OTA_IMAGE_TYPE 0xe32a // image type (with MY_MANUF_CODE) our images are built with
+#define MY_OTA_HW_VERSION 1
+#define MY_OTA_FILE_VERSION BUILD_EPOCH // unix time of the build; newer builds → higher version
+#define MY_OTA_MAX_DATA_SIZE 64 // bytes per image block (fits a single unfragmented frame)
 
 // XIAO rfswitch (antenna connector)
 #define RF_SWITCH_GPIO 14 // rf switch gpio (-1 to turn off)
 #define RF_SWITCH_EXTERNAL true // false: built-in, true: u.fl
+#define RF_SWITCH_AUTO false // antenna diversity on by default
 
 /* Used to initialize light_config_t in light_config.c */
 #define MY_LIGHT_CONFIG() { \
     .rf_switch_external = RF_SWITCH_EXTERNAL, \
+    .rf_switch_auto = RF_SWITCH_AUTO, \
+    .pwm_frequency = 0, \
+    .dithering = false, \
     .manufacturer_name = "wejn.org", \
     .model_identifier = "e32wamb", \
     .date_code = BUILD_DATE_CODE, \
@@ -74,12 +129,23 @@
 #define RESET_BUTTON_GPIO 1
 
 #define RGB_INDICATOR_GPIO 0
-#define RGB_INDICATOR_MODEL LED_MODEL_WS2812
-#define RGB_INDICATOR_FORMAT LED_STRIP_COLOR_COMPONENT_FMT_GRB
-#define RGB_INDICATOR_MAX_BRIGHTNESS 0.2
+#define RGB_INDICATOR_ORDER_GRB true // WS2812 wants green, red, blue (false: red, green, blue)
+#define RGB_INDICATOR_MAX_BRIGHTNESS 51 // out of 255 (= 20%)
 
 #define MY_LIGHT_PWM_CH0_GPIO 18 // normal
 #define MY_LIGHT_PWM_CH1_GPIO 19 // cold
 #define MY_LIGHT_PWM_CH2_GPIO 20 // hot
 #define MY_LIGHT_PWM_CH3_GPIO 21 // unused
 #define MY_LIGHT_PWM_CH4_GPIO 22 // unused
+
+// Output channel map: {gpio, role} per ledc channel (in order, up to LD_MAX_CHANNELS).
+// Only channels with an active role get PWM (fades, fade-end interrupts);
+// LD_Role_Unused pins are merely held low. E.g. 2-channel CCT fixture:
+// { {18, LD_Role_Cold}, {19, LD_Role_Warm} }, single-channel dimmable: { {18, LD_Role_Dim} }
+#define MY_LIGHT_CHANNEL_MAP { \
+    { MY_LIGHT_PWM_CH0_GPIO, LD_Role_Normal }, \
+    { MY_LIGHT_PWM_CH1_GPIO, LD_Role_Cold }, \
+    { MY_LIGHT_PWM_CH2_GPIO, LD_Role_Warm }, \
+    { MY_LIGHT_PWM_CH3_GPIO, LD_Role_Unused }, \
+    { MY_LIGHT_PWM_CH4_GPIO, LD_Role_Unused }, \
+}
@@ -0,0 +1,237 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ha/esp_zigbee_ha_standard.h"
+
+#include "executor.h"
+#include "global_config.h"
+#include "health_monitor.h"
+#include "indicator_led.h"
+
+#define SAMPLE_EVERY_MS (60 * 1000)
+#define MAX_TASKS 24 // more than we'll ever have (incl. system tasks)
+#define TASK_NAME_LEN 8
+#define DUMP_VERSION 1
+
+static const char *TAG = "HEALTH_MONITOR";
+volatile static bool hm_initialized = false;
+
+static void health_monitor_sample(void *arg);
+static ex_timer_t hm_timer = EX_TIMER_INIT(health_monitor_sample, NULL);
+
+typedef struct __attribute__((packed)) {
+    char name[TASK_NAME_LEN];
+    uint16_t cpu; // ‰ of the last sampling period
+    uint16_t stack_free; // high water mark, in bytes
+} hm_task_record;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t num_tasks;
+    uint8_t first_task;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t largest_free_block;
+} hm_dump_header;
+
+static portMUX_TYPE hm_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static hm_task_record hm_tasks[MAX_TASKS];
+static uint8_t hm_num_tasks = 0;
+static uint32_t hm_free_heap = 0;
+static uint32_t hm_min_free_heap = 0;
+static uint32_t hm_largest_free_block = 0;
+static uint16_t hm_min_stack_free = 0;
+static uint16_t hm_cpu_load = 0; // ‰ of time not spent in IDLE
+static uint32_t hm_led_transfers = 0; // indicator led RMT transfers during the last full hour
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+// Sampler-private state (only touched from the timer callback)
+static TaskStatus_t hm_status[MAX_TASKS];
+static struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} hm_prev[MAX_TASKS];
+static uint8_t hm_prev_num = 0;
+static uint32_t hm_prev_total = 0;
+
+static uint32_t previous_run_time(TaskHandle_t handle) {
+    for (uint8_t i = 0; i < hm_prev_num; i++) {
+        if (hm_prev[i].handle == handle) {
+            return hm_prev[i].run_time;
+        }
+    }
+    return 0;
+}
+#endif
+
+static void publish_attributes() {
+    if (!esp_zb_is_started() || !esp_zb_lock_acquire(pdMS_TO_TICKS(50))) {
+        return; // next time...
+    }
+
+    uint32_t free_heap = hm_free_heap;
+    uint32_t min_free_heap = hm_min_free_heap;
+    uint32_t largest_free_block = hm_largest_free_block;
+    uint16_t min_stack_free = hm_min_stack_free;
+    uint16_t cpu_load = hm_cpu_load;
+    uint32_t led_transfers = hm_led_transfers;
+
+#define SET_ATTR(attr, val) esp_zb_zcl_set_manufacturer_attribute_val(MY_LIGHT_ENDPOINT, \
+        ESP_ZB_ZCL_CLUSTER_ID_BASIC, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, MY_MANUF_CODE, attr, &val, false)
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_FREE_HEAP, free_heap);
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_MIN_FREE_HEAP, min_free_heap);
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_LARGEST_FREE_BLOCK, largest_free_block);
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_MIN_STACK_FREE, min_stack_free);
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_CPU_LOAD, cpu_load);
+    SET_ATTR(MY_MANUF_ATTR_HEALTH_LED_TRANSFERS, led_transfers);
+#undef SET_ATTR
+
+    esp_zb_lock_release();
+}
+
+// Executor handler: every SAMPLE_EVERY_MS
+static void health_monitor_sample(void *arg) {
+    executor_schedule(&hm_timer, SAMPLE_EVERY_MS);
+
+    hm_task_record tasks[MAX_TASKS];
+    uint8_t num_tasks = 0;
+    uint16_t min_stack_free = UINT16_MAX;
+    uint16_t cpu_load = 0;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t total = 0;
+    UBaseType_t num = uxTaskGetSystemState(hm_status, MAX_TASKS, &total);
+    uint32_t total_delta = total - hm_prev_total;
+
+    for (UBaseType_t i = 0; i < num; i++) {
+        TaskStatus_t *t = &hm_status[i];
+        hm_task_record *r = &tasks[num_tasks++];
+
+        strncpy(r->name, t->pcTaskName, TASK_NAME_LEN);
+        r->stack_free = uxTaskGetStackHighWaterMark(t->xHandle); // StackType_t is a byte on esp-idf
+        if (r->stack_free < min_stack_free) {
+            min_stack_free = r->stack_free;
+        }
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        uint32_t delta = t->ulRunTimeCounter - previous_run_time(t->xHandle);
+        r->cpu = total_delta ? (uint64_t) delta * 1000 / total_delta : 0;
+        if (strncmp(t->pcTaskName, "IDLE", 4) == 0) {
+            cpu_load = r->cpu < 1000 ? 1000 - r->cpu : 0;
+        }
+#else
+        r->cpu = 0;
+#endif
+    }
+
+    // Remember the counters for the next round
+    for (UBaseType_t i = 0; i < num; i++) {
+        hm_prev[i].handle = hm_status[i].xHandle;
+        hm_prev[i].run_time = hm_status[i].ulRunTimeCounter;
+    }
+    hm_prev_num = num;
+    hm_prev_total = total;
+#endif
+
+    uint32_t free_heap = esp_get_free_heap_size();
+    uint32_t min_free_heap = esp_get_minimum_free_heap_size();
+    uint32_t largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    uint32_t led_transfers = indicator_led_transfers_last_hour(); // (≈ 0 on a connected, idle light)
+
+    taskENTER_CRITICAL(&hm_spinlock);
+    memcpy(hm_tasks, tasks, sizeof(hm_tasks[0]) * num_tasks);
+    hm_num_tasks = num_tasks;
+    hm_free_heap = free_heap;
+    hm_min_free_heap = min_free_heap;
+    hm_largest_free_block = largest_free_block;
+    hm_min_stack_free = num_tasks ? min_stack_free : 0;
+    hm_cpu_load = cpu_load;
+    hm_led_transfers = led_transfers;
+    taskEXIT_CRITICAL(&hm_spinlock);
+
+    ESP_LOGD(TAG, "heap: free %lu, min %lu, largest %lu; tasks: %d, min stack free: %u, cpu: %u‰",
+            free_heap, min_free_heap, largest_free_block, num_tasks, hm_min_stack_free, cpu_load);
+    ex_stats_t ex;
+    executor_get_stats(&ex);
+    ESP_LOGD(TAG, "executor: %lu wakeups, %lu handlers, longest %lu μs", ex.wakeups, ex.handlers, ex.longest);
+
+    publish_attributes();
+}
+
+void health_monitor_add_attrs(esp_zb_attribute_list_t *basic_attr) {
+    uint32_t zero32 = 0;
+    uint16_t zero16 = 0;
+
+#define ADD_ATTR(attr, type, val) do { \
+    esp_err_t err = esp_zb_cluster_add_manufacturer_attr(basic_attr, \
+            basic_attr->next->cluster_id, \
+            attr, MY_MANUF_CODE, type, \
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_MANUF_SPEC, \
+            &val); \
+    if (err != ESP_OK) { \
+        ESP_LOGW(TAG, "Failed to add %s manuf attr: %s", #attr, esp_err_to_name(err)); \
+    } \
+} while (0)
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_FREE_HEAP, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_MIN_FREE_HEAP, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_LARGEST_FREE_BLOCK, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_MIN_STACK_FREE, ESP_ZB_ZCL_ATTR_TYPE_U16, zero16);
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_CPU_LOAD, ESP_ZB_ZCL_ATTR_TYPE_U16, zero16);
+    ADD_ATTR(MY_MANUF_ATTR_HEALTH_LED_TRANSFERS, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+#undef ADD_ATTR
+}
+
+size_t health_monitor_dump(uint8_t page, uint8_t *out, size_t size) {
+    hm_dump_header hdr = {
+        .version = DUMP_VERSION,
+        .first_task = page * HEALTH_TASKS_PER_PAGE,
+    };
+    size_t len = sizeof(hdr);
+
+    if (size < sizeof(hdr)) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL(&hm_spinlock);
+    hdr.num_tasks = hm_num_tasks;
+    hdr.free_heap = hm_free_heap;
+    hdr.min_free_heap = hm_min_free_heap;
+    hdr.largest_free_block = hm_largest_free_block;
+    for (uint8_t i = hdr.first_task; i < hm_num_tasks && i < hdr.first_task + HEALTH_TASKS_PER_PAGE; i++) {
+        if (len + sizeof(hm_task_record) > size) {
+            break;
+        }
+        memcpy(out + len, &hm_tasks[i], sizeof(hm_task_record));
+        len += sizeof(hm_task_record);
+    }
+    taskEXIT_CRITICAL(&hm_spinlock);
+
+    memcpy(out, &hdr, sizeof(hdr));
+
+    return len;
+}
+
+esp_err_t health_monitor_initialize() {
+    esp_err_t ret = ESP_OK;
+
+    if (hm_initialized) {
+        ESP_LOGW(TAG, "Attempted to initialize health monitor more than once");
+    } else {
+        executor_schedule(&hm_timer, SAMPLE_EVERY_MS);
+
+        hm_initialized = true;
+        ESP_LOGI(TAG, "Initialized");
+    }
+
+    return ret;
+}
@@ -0,0 +1,43 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Periodically samples runtime health (per-task cpu usage, stack
+ * high-water marks, heap, indicator led transfers) and publishes it over
+ * zigbee.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+#define HEALTH_TASKS_PER_PAGE 4 // keeps the dump within a single (unfragmented) frame
+
+// Initialize health monitor (starts the periodic sampler)
+esp_err_t health_monitor_initialize();
+
+// Add health manufacturer-specific attributes to the basic cluster
+void health_monitor_add_attrs(esp_zb_attribute_list_t *basic_attr);
+
+// Write given page of the binary health dump to out (at most size bytes)
+//
+// Returns number of bytes written. Format (little endian):
+//   u8 version, u8 number of tasks, u8 index of the first task in this page,
+//   u32 free heap, u32 minimum free heap, u32 largest free block,
+//   then (up to) HEALTH_TASKS_PER_PAGE task records of:
+//   char name[8] (not terminated if 8 long), u16 cpu (‰), u16 stack free (bytes)
+size_t health_monitor_dump(uint8_t page, uint8_t *out, size_t size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
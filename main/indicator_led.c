@@ -4,19 +4,47 @@
  *
  * This code is licensed under GPL version 3.
  */
+#include "driver/rmt_tx.h"
 #include "esp_check.h"
-#include "led_strip.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
+#include "executor.h"
 #include "global_config.h"
 #include "indicator_led.h"
 
+#define RMT_RESOLUTION_HZ 10 * 1000 * 1000 // 10MHz → 0.1μs per tick
+#define WS2812_T0H 3 // "0" bit: 0.3μs high...
+#define WS2812_T0L 9 // ... and 0.9μs low
+#define WS2812_T1H 9 // "1" bit: 0.9μs high...
+#define WS2812_T1L 3 // ... and 0.3μs low
+#define WS2812_RESET_TICKS 1400 // 2x 140μs low → latch
+#define PIXEL_SYMBOLS (24 + 1) // 24 bits of color + reset
+#define HOUR_US (3600LL * 1000 * 1000) // h in μs
+
+#define MAX_FRAMES 2
+#define NUM_STATES (IS_reset_pending + 1)
+
 static const char *TAG = "INDICATOR_LED";
-static TaskHandle_t il_task_handle;
 volatile static bool il_initialized = false;
 volatile static indicator_state il_state = IS_initial;
 volatile static indicator_state il_state_before_lock = IS_initial;
 volatile bool il_locked = false;
-static led_strip_handle_t il_led_strip;
+
+static void indicator_led_render(void *arg);
+
+static SemaphoreHandle_t il_mutex; // mutex governing these (+ the timer arming):
+static ex_timer_t il_timer = EX_TIMER_INIT(indicator_led_render, NULL);
+static bool il_restart = true; // start il_state pattern from the first frame
+static uint8_t il_frame = 0; // currently displayed frame
+static uint32_t il_pixel = UINT32_MAX; // currently displayed (scaled) pixel, UINT32_MAX = unknown
+static int64_t il_hour_start = 0; // start of the current transfer counting window
+static uint32_t il_transfers_this_hour = 0;
+static uint32_t il_transfers_last_hour = 0;
+
+static rmt_channel_handle_t il_rmt_channel;
+static rmt_encoder_handle_t il_rmt_encoder;
 
 typedef struct {
     bool valid;
@@ -26,30 +54,100 @@ typedef struct {
     uint16_t delay;
 } indicator_frame;
 
-static void indicator_led_task(void *pvParameters) {
-    float max_brightness = RGB_INDICATOR_MAX_BRIGHTNESS;
-#define MAX_FRAMES 2
-    indicator_frame frames[][MAX_FRAMES] = {
-        {{true, 255, 0, 0, 500}, {true, 64, 0, 0, 500}}, // IS_initial
-        {{true, 0, 0, 255, 500}, {true, 0, 0, 64, 500}}, // IS_commissioning
-        {{true, 64, 64, 0, 200}, {true, 0, 0, 0, 4800}}, // IS_connected_no_coord
-        {{true, 0, 64, 0, 20}, {true, 0, 0, 0, 4980}}, // IS_connected
-        {{true, 255, 255, 255, 100}, {true, 0, 0, 0, 100}}, // IS_reset_pending
-    };
-    uint8_t current_frame = MAX_FRAMES - 1;
-    indicator_frame *f = NULL;
-    while (true) {
-        f = frames[il_state];
-        if (current_frame + 1 > MAX_FRAMES - 1 || !f[current_frame + 1].valid) {
-            current_frame = 0;
+static const indicator_frame il_patterns[NUM_STATES][MAX_FRAMES] = {
+    {{true, 255, 0, 0, 500}, {true, 64, 0, 0, 500}}, // IS_initial
+    {{true, 0, 0, 255, 500}, {true, 0, 0, 64, 500}}, // IS_commissioning
+    {{true, 64, 64, 0, 200}, {true, 0, 0, 0, 4800}}, // IS_connected_no_coord
+    {{true, 0, 64, 0, 20}, {true, 0, 0, 0, 4980}}, // IS_connected
+    {{true, 255, 255, 255, 100}, {true, 0, 0, 0, 100}}, // IS_reset_pending
+};
+
+// Precomputed (brightness scaled) pixel values and their RMT symbols for all the frames above
+static uint32_t il_pixels[NUM_STATES][MAX_FRAMES];
+static rmt_symbol_word_t il_symbols[NUM_STATES][MAX_FRAMES][PIXEL_SYMBOLS];
+
+static uint8_t scale(uint8_t component) {
+    return (component * RGB_INDICATOR_MAX_BRIGHTNESS + 127) / 255;
+}
+
+static void precompute_frame(indicator_state state, uint8_t frame) {
+    const indicator_frame *f = &il_patterns[state][frame];
+    uint32_t pixel;
+    if (RGB_INDICATOR_ORDER_GRB) {
+        pixel = scale(f->green) << 16 | scale(f->red) << 8 | scale(f->blue);
+    } else {
+        pixel = scale(f->red) << 16 | scale(f->green) << 8 | scale(f->blue);
+    }
+    il_pixels[state][frame] = pixel;
+
+    rmt_symbol_word_t *s = il_symbols[state][frame];
+    for (int bit = 23; bit >= 0; bit--, s++) { // MSB first
+        bool one = pixel & (1 << bit);
+        s->level0 = 1;
+        s->duration0 = one ? WS2812_T1H : WS2812_T0H;
+        s->level1 = 0;
+        s->duration1 = one ? WS2812_T1L : WS2812_T0L;
+    }
+    s->level0 = 0;
+    s->duration0 = WS2812_RESET_TICKS;
+    s->level1 = 0;
+    s->duration1 = WS2812_RESET_TICKS;
+}
+
+// Roll over the transfer counting window; must hold il_mutex
+static void roll_transfer_counters(int64_t now) {
+    if (now - il_hour_start >= HOUR_US) {
+        il_transfers_last_hour = (now - il_hour_start >= 2 * HOUR_US) ? 0 : il_transfers_this_hour;
+        il_transfers_this_hour = 0;
+        il_hour_start = now - (now - il_hour_start) % HOUR_US;
+        ESP_LOGI(TAG, "RMT transfers in the last hour: %lu", il_transfers_last_hour);
+    }
+}
+
+// Executor handler: render the current frame of il_state, and arm the timer for the next one (if any)
+static void indicator_led_render(void *arg) {
+    xSemaphoreTake(il_mutex, portMAX_DELAY);
+
+    indicator_state state = il_state;
+    const indicator_frame *f = il_patterns[state];
+    if (il_restart || il_frame + 1 > MAX_FRAMES - 1 || !f[il_frame + 1].valid) {
+        il_frame = 0;
+    } else {
+        il_frame++;
+    }
+    il_restart = false;
+
+    // Only talk to the led when the pixel actually changes
+    if (il_pixels[state][il_frame] != il_pixel) {
+        rmt_transmit_config_t tx_config = {
+            .loop_count = 0,
+        };
+        esp_err_t err = rmt_transmit(il_rmt_channel, il_rmt_encoder, il_symbols[state][il_frame],
+                sizeof(il_symbols[state][il_frame]), &tx_config);
+        if (err == ESP_OK) {
+            il_pixel = il_pixels[state][il_frame];
+            roll_transfer_counters(esp_timer_get_time());
+            il_transfers_this_hour++;
         } else {
-            current_frame++;
+            ESP_LOGW(TAG, "can't transmit: %s", esp_err_to_name(err));
         }
-        f = &f[current_frame];
-        led_strip_set_pixel(il_led_strip, 0, f->red * max_brightness, f->green * max_brightness, f->blue * max_brightness);
-        led_strip_refresh(il_led_strip);
-        xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(f->delay));
     }
+
+    // Single-frame patterns are static → no need to wake up again
+    if (f[1].valid) {
+        executor_schedule(&il_timer, f[il_frame].delay);
+    }
+
+    xSemaphoreGive(il_mutex);
+}
+
+// Switch to state, restarting its pattern asap
+static void indicator_led_set(indicator_state state) {
+    xSemaphoreTake(il_mutex, portMAX_DELAY);
+    il_state = state;
+    il_restart = true;
+    executor_schedule(&il_timer, 0); // (moves it, if armed)
+    xSemaphoreGive(il_mutex);
 }
 
 esp_err_t indicator_led_initialize() {
@@ -58,33 +156,57 @@ esp_err_t indicator_led_initialize() {
     if (il_initialized) {
         ESP_LOGW(TAG, "Attempted to initialize indicator led more than once");
     } else {
-        led_strip_config_t strip_config = {
-            .strip_gpio_num = RGB_INDICATOR_GPIO,
-            .max_leds = 1,
-            .led_model = RGB_INDICATOR_MODEL,
-            .color_component_format = RGB_INDICATOR_FORMAT,
-            .flags = {
-                .invert_out = false,
+        for (int state = 0; state < NUM_STATES; state++) {
+            for (int frame = 0; frame < MAX_FRAMES; frame++) {
+                precompute_frame(state, frame);
             }
-        };
+        }
 
-        led_strip_rmt_config_t rmt_config = {
+        rmt_tx_channel_config_t tx_chan_config = {
+            .gpio_num = RGB_INDICATOR_GPIO,
             .clk_src = RMT_CLK_SRC_DEFAULT,
-            .resolution_hz = 10 * 1000 * 1000,
+            .resolution_hz = RMT_RESOLUTION_HZ,
             .mem_block_symbols = 64,
+            .trans_queue_depth = 4,
             .flags = {
+                .invert_out = false,
                 .with_dma = false,
             }
         };
+        ret = rmt_new_tx_channel(&tx_chan_config, &il_rmt_channel);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "can't create rmt channel: %s", esp_err_to_name(ret));
+            return ret;
+        }
 
-        ret = led_strip_new_rmt_device(&strip_config, &rmt_config, &il_led_strip);
+        rmt_copy_encoder_config_t encoder_config = {};
+        ret = rmt_new_copy_encoder(&encoder_config, &il_rmt_encoder);
         if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "can't initialize indicator led: %s", esp_err_to_name(ret));
-        } else {
-            il_initialized = true;
-            xTaskCreate(indicator_led_task, "indicator_led", 4096, NULL, 0, &il_task_handle);
-            ESP_LOGI(TAG, "Initialized");
+            ESP_LOGW(TAG, "can't create rmt encoder: %s", esp_err_to_name(ret));
+            return ret;
         }
+
+        ret = rmt_enable(il_rmt_channel);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "can't enable rmt channel: %s", esp_err_to_name(ret));
+            return ret;
+        }
+
+#if STATIC_ALLOCATION
+        static StaticSemaphore_t mutex;
+        il_mutex = xSemaphoreCreateMutexStatic(&mutex);
+#else
+        il_mutex = xSemaphoreCreateMutex();
+#endif
+        if (!il_mutex) {
+            ESP_LOGW(TAG, "can't create mutex");
+            return ESP_ERR_NO_MEM;
+        }
+
+        il_hour_start = esp_timer_get_time();
+        il_initialized = true;
+        indicator_led_set(il_state);
+        ESP_LOGI(TAG, "Initialized");
     }
 
     return ret;
@@ -98,8 +220,7 @@ esp_err_t indicator_led_switch(indicator_state state) {
         if (il_locked) {
             // nothing...
         } else {
-            il_state = state;
-            xTaskNotifyGive(il_task_handle);
+            indicator_led_set(state);
         }
     }
 
@@ -117,8 +238,7 @@ esp_err_t indicator_led_lock(indicator_state state) {
         } else {
             il_locked = true;
             il_state_before_lock = il_state;
-            il_state = state;
-            xTaskNotifyGive(il_task_handle);
+            indicator_led_set(state);
         }
     }
 
@@ -134,11 +254,23 @@ esp_err_t indicator_led_unlock() {
             ESP_LOGE(TAG, "Can't unlock what's not locked, skip");
             return ESP_ERR_NOT_SUPPORTED;
         } else {
-            il_state = il_state_before_lock;
             il_locked = false;
-            xTaskNotifyGive(il_task_handle);
+            indicator_led_set(il_state_before_lock);
         }
     }
 
     return ESP_OK;
 }
+
+uint32_t indicator_led_transfers_last_hour() {
+    uint32_t ret = 0;
+
+    if (il_initialized) {
+        xSemaphoreTake(il_mutex, portMAX_DELAY);
+        roll_transfer_counters(esp_timer_get_time());
+        ret = il_transfers_last_hour;
+        xSemaphoreGive(il_mutex);
+    }
+
+    return ret;
+}
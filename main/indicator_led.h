@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "esp_err.h"
 
 typedef enum indicator_state {
@@ -35,6 +37,9 @@ esp_err_t indicator_led_lock(indicator_state state);
 // Unlock indicator to previous state
 esp_err_t indicator_led_unlock();
 
+// Number of RMT transfers (led updates) during the last full hour
+uint32_t indicator_led_transfers_last_hour();
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -10,14 +10,25 @@
 #include "esp_app_desc.h"
 #include "esp_check.h"
 #include "esp_err.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
 #include "nvs.h"
 
+#include "alloc_guard.h"
 #include "delayed_save.h"
+#include "executor.h"
 #include "global_config.h"
+#include "health_monitor.h"
 #include "light_config.h"
 #include "light_driver.h"
+#include "ota.h"
 #include "rfswitch.h"
+#include "router_stats.h"
+#include "seqlock.h"
+#include "trace.h"
 
 #define LIGHT_CONFIG_NVS_NAMESPACE "light_config"
 #define STARTUP_ONOFF_TOGGLE 2
@@ -31,6 +42,51 @@ static light_config_t light_config_rw = MY_LIGHT_CONFIG();
 bool light_config_initialized_rw = false;
 const light_config_t * const light_config = &light_config_rw;
 const bool * const light_config_initialized = &light_config_initialized_rw;
+volatile static uint32_t lc_generation = 0; // seqlock: +1 before, +1 after every update (from zigbee context)
+
+#define SNAPSHOT_SPINS 8 // retries before yielding to a (preempted) writer
+
+// Start updating light_config_rw (lc_generation → odd; readers retry)
+static void lc_write_begin() {
+    seqlock_write_begin(&lc_generation);
+}
+
+// Done updating light_config_rw (lc_generation → even); no-op unless in update
+static void lc_write_end() {
+    seqlock_write_end(&lc_generation);
+}
+
+// Flash writes are queued (and coalesced) here, carried out on the executor
+#define LCFV_AS_ONE(NAME) + 1
+enum { LCFV_COUNT = 0 _LCFV_ITER(LCFV_AS_ONE) };
+#undef LCFV_AS_ONE
+_Static_assert(LCFV_COUNT <= 32, "lc_dirty is a 32-bit bitmap of flash variables");
+
+static portMUX_TYPE lc_persist_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static uint32_t lc_dirty = 0; // bitmap of lc_flash_var_t to write
+static bool lc_erase_pending = false; // erase the namespace (before writing lc_dirty)
+
+#define STATE_DUMP_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint32_t generation;
+} lc_state_dump_header;
+
+typedef struct __attribute__((packed)) {
+    uint8_t onoff;
+    uint8_t level;
+    uint16_t temperature;
+    uint8_t startup_onoff;
+    uint8_t startup_level;
+    uint16_t startup_temperature;
+    uint8_t level_options;
+    uint8_t color_options;
+    uint8_t rf_switch_external;
+    uint8_t effect;
+    uint8_t fade_progress;
+    uint16_t fade_remaining;
+} lc_state_dump;
 
 
 #if(NVS_KEY_NAME_MAX_SIZE < 16)
@@ -45,7 +101,7 @@ static const char *lc_flash_var_to_key(lc_flash_var_t var) {
 }
 #undef LCFV_AS_STRING
 
-esp_err_t light_config_erase_flash() {
+static esp_err_t lc_erase_flash() {
     esp_err_t err;
     nvs_handle_t nvs_handle;
 
@@ -75,14 +131,11 @@ esp_err_t light_config_erase_flash() {
 
 }
 
-esp_err_t light_config_persist_var(lc_flash_var_t key) {
-    lc_flash_var_t vars[] = { key };
-    return light_config_persist_vars(vars, 1);
-}
-
-esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num) {
+// Write the vars in dirty (bitmap of lc_flash_var_t) with one commit; current values
+static esp_err_t lc_write_vars(uint32_t dirty) {
     esp_err_t err;
     nvs_handle_t nvs_handle;
+    size_t num = 0;
 
     err = nvs_open(LIGHT_CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
@@ -92,21 +145,27 @@ esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num) {
 
     char k[NVS_KEY_NAME_MAX_SIZE];
     uint32_t value = 0;
+    lc_snapshot_t snapshot; // (runs on the executor)
+    light_config_snapshot(&snapshot);
 
-    for (size_t i = 0; i < num; i++) {
-        const char *ck = lc_flash_var_to_key(vars[i]);
+    for (lc_flash_var_t var = 0; var < (lc_flash_var_t) LCFV_COUNT; var++) {
+        if (!(dirty & (1UL << var))) {
+            continue;
+        }
+        const char *ck = lc_flash_var_to_key(var);
         strncpy(k, ck, NVS_KEY_NAME_MAX_SIZE); // need to trim the key, sigh
         k[NVS_KEY_NAME_MAX_SIZE-1] = 0; // the max length is NVS_KEY_NAME_MAX_SIZE-1
 
-#define LCFV_AS_LC_DEREF(NAME) case LCFV_##NAME: value = light_config->NAME; break;
-        switch (vars[i]) {
+#define LCFV_AS_LC_DEREF(NAME) case LCFV_##NAME: value = snapshot.config.NAME; break;
+        switch (var) {
             _LCFV_ITER(LCFV_AS_LC_DEREF)
         }
 #undef LCFV_AS_LC_DEREF
 
         err = nvs_set_u32(nvs_handle, k, value);
         if (err == ESP_OK) {
-            ESP_LOGI(TAG, "saved %s to flash: %lu", ck, value);
+            TRACE(persist_var, var, 0, 0, value);
+            num++;
         } else {
             ESP_LOGW(TAG, "save of %s to flash err: %s", ck, esp_err_to_name(err));
             break;
@@ -115,9 +174,8 @@ esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num) {
 
     if (err == ESP_OK) {
         err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "committed %d vars to flash", num);
-        } else {
+        TRACE(persist_commit, num, 0, 0, err);
+        if (err != ESP_OK) {
             ESP_LOGW(TAG, "commit of %d vars to flash err: %s", num, esp_err_to_name(err));
         }
     }
@@ -127,6 +185,114 @@ esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num) {
     return err;
 }
 
+#define PERSIST_RETRY_MS 1000 // first retry of a failed flash write ...
+#define PERSIST_RETRY_MAX_MS (10 * 60 * 1000) // ... backing off up to this
+
+static void lc_persist_run(void *arg);
+static ex_timer_t lc_persist_timer = EX_TIMER_INIT(lc_persist_run, NULL);
+static uint32_t lc_persist_retry_ms = PERSIST_RETRY_MS; // (executor only)
+
+// Carry out one piece of the queued flash work: the erase, or else all the
+// dirty vars (from one snapshot, with one commit)
+//
+// Returns ESP_ERR_NOT_FOUND if nothing is queued; a piece that fails is
+// queued again (unless an erase queued meanwhile makes it moot).
+static esp_err_t lc_persist_step() {
+    taskENTER_CRITICAL(&lc_persist_spinlock);
+    bool erase = lc_erase_pending;
+    uint32_t dirty = erase ? 0 : lc_dirty; // (the writes go on the next turn, after the erase)
+    lc_erase_pending = false;
+    lc_dirty &= ~dirty;
+    taskEXIT_CRITICAL(&lc_persist_spinlock);
+
+    if (!erase && !dirty) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int64_t start = esp_timer_get_time();
+    alloc_guard_allow_begin(); // (nvs allocates)
+    esp_err_t err = erase ? lc_erase_flash() : lc_write_vars(dirty);
+    alloc_guard_allow_end();
+    uint32_t took = esp_timer_get_time() - start; // (how long the executor is held up)
+    TRACE(persist_flush, erase, __builtin_popcount(dirty), 0, took);
+
+    if (err != ESP_OK) {
+        taskENTER_CRITICAL(&lc_persist_spinlock);
+        if (!lc_erase_pending) {
+            lc_erase_pending = erase;
+            lc_dirty |= dirty;
+        }
+        taskEXIT_CRITICAL(&lc_persist_spinlock);
+    }
+
+    return err;
+}
+
+// Arm lc_persist_timer for whatever is left after lc_persist_step() returned err
+static void lc_persist_rearm(esp_err_t err) {
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "flash write failed, retry in %lu ms", lc_persist_retry_ms);
+        executor_schedule(&lc_persist_timer, lc_persist_retry_ms); // (a new request retries right away)
+        lc_persist_retry_ms = lc_persist_retry_ms < PERSIST_RETRY_MAX_MS / 2 ? 2 * lc_persist_retry_ms
+                : PERSIST_RETRY_MAX_MS;
+        return;
+    }
+    lc_persist_retry_ms = PERSIST_RETRY_MS;
+
+    taskENTER_CRITICAL(&lc_persist_spinlock);
+    bool pending = lc_erase_pending || lc_dirty;
+    taskEXIT_CRITICAL(&lc_persist_spinlock);
+    if (pending) {
+        executor_schedule(&lc_persist_timer, 0); // (after the timers already due)
+    }
+}
+
+// Executor handler: one piece of the queued flash work per turn, so that the
+// other timers on the executor (indicator led, reset button) run between
+// an erase and the writes queued after it
+static void lc_persist_run(void *arg) {
+    lc_persist_rearm(lc_persist_step());
+}
+
+esp_err_t light_config_erase_flash() {
+    taskENTER_CRITICAL(&lc_persist_spinlock);
+    lc_erase_pending = true;
+    lc_dirty = 0; // (would be erased anyway)
+    taskEXIT_CRITICAL(&lc_persist_spinlock);
+    executor_schedule(&lc_persist_timer, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t light_config_persist_var(lc_flash_var_t key) {
+    lc_flash_var_t vars[] = { key };
+    return light_config_persist_vars(vars, 1);
+}
+
+esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num) {
+    uint32_t dirty = 0;
+
+    for (size_t i = 0; i < num; i++) {
+        dirty |= 1UL << vars[i];
+    }
+
+    taskENTER_CRITICAL(&lc_persist_spinlock);
+    lc_dirty |= dirty;
+    taskEXIT_CRITICAL(&lc_persist_spinlock);
+    executor_schedule(&lc_persist_timer, 0); // (already armed → just moves it)
+
+    return ESP_OK;
+}
+
+void light_config_flush() {
+    esp_err_t err;
+
+    executor_cancel(&lc_persist_timer);
+    while ((err = lc_persist_step()) == ESP_OK) {
+    }
+    lc_persist_rearm(err);
+}
+
 static esp_err_t lc_read_var_from_flash(nvs_handle_t nvs_handle, lc_flash_var_t key, uint32_t *val) {
     const char *ck = lc_flash_var_to_key(key);
     char k[NVS_KEY_NAME_MAX_SIZE];
@@ -163,6 +329,17 @@ esp_err_t lc_restore_cfg_from_flash() {
     val = light_config_rw.rf_switch_external;
     lc_read_var_from_flash(nvs_handle, LCFV_rf_switch_external, &val);
     light_config_rw.rf_switch_external = val;
+    val = light_config_rw.rf_switch_auto;
+    lc_read_var_from_flash(nvs_handle, LCFV_rf_switch_auto, &val);
+    light_config_rw.rf_switch_auto = val;
+
+    // output tuning
+    val = light_config_rw.pwm_frequency;
+    lc_read_var_from_flash(nvs_handle, LCFV_pwm_frequency, &val);
+    light_config_rw.pwm_frequency = val;
+    val = light_config_rw.dithering;
+    lc_read_var_from_flash(nvs_handle, LCFV_dithering, &val);
+    light_config_rw.dithering = val;
 
     // onoff
     val = light_config_rw.startup_onoff;
@@ -308,6 +485,44 @@ esp_zb_cluster_list_t *light_config_clusters_create() {
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Failed to add rf switch manuf attr: %s", esp_err_to_name(err));
     }
+    bool rf_switch_auto = light_config_rw.rf_switch_auto;
+    err = esp_zb_cluster_add_manufacturer_attr(basic_attr,
+            basic_attr->next->cluster_id,
+            MY_MANUF_ATTR_RF_SWITCH_AUTO,
+            MY_MANUF_CODE, ESP_ZB_ZCL_ATTR_TYPE_BOOL,
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_MANUF_SPEC,
+            &rf_switch_auto);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add rf switch auto manuf attr: %s", esp_err_to_name(err));
+    }
+
+    // Output tuning custom attribs
+    uint16_t pwm_frequency = light_config_rw.pwm_frequency;
+    err = esp_zb_cluster_add_manufacturer_attr(basic_attr,
+            basic_attr->next->cluster_id,
+            MY_MANUF_ATTR_PWM_FREQUENCY,
+            MY_MANUF_CODE, ESP_ZB_ZCL_ATTR_TYPE_U16,
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_MANUF_SPEC,
+            &pwm_frequency);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add pwm frequency manuf attr: %s", esp_err_to_name(err));
+    }
+    bool dithering = light_config_rw.dithering;
+    err = esp_zb_cluster_add_manufacturer_attr(basic_attr,
+            basic_attr->next->cluster_id,
+            MY_MANUF_ATTR_DITHERING,
+            MY_MANUF_CODE, ESP_ZB_ZCL_ATTR_TYPE_BOOL,
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_MANUF_SPEC,
+            &dithering);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add dithering manuf attr: %s", esp_err_to_name(err));
+    }
+
+    // Runtime health custom attribs
+    health_monitor_add_attrs(basic_attr);
+
+    // Router statistics custom attribs
+    router_stats_add_attrs(basic_attr);
 
     esp_zb_cluster_list_add_basic_cluster(cluster_list, basic_attr, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
@@ -376,22 +591,31 @@ esp_zb_cluster_list_t *light_config_clusters_create() {
     ADD_OR_WARN(esp_zb_color_control_cluster_add_attr, color_attr, ESP_ZB_ZCL_ATTR_COLOR_CONTROL_COUPLE_COLOR_TEMP_TO_LEVEL_MIN_MIREDS_ID, &light_config_rw.couple_min_temperature);
     esp_zb_cluster_list_add_color_control_cluster(cluster_list, color_attr, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    // ota cluster (client)
+    ota_add_cluster(cluster_list);
+
     return cluster_list;
 }
 
 esp_err_t light_config_initialize() {
     esp_err_t ret = ESP_OK;
 
-    create_delayed_save_task();
+    delayed_save_initialize();
 
     ret = lc_restore_cfg_from_flash();
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "restore from flash failed: %s", esp_err_to_name(ret));
     }
 
+    lc_generation = esp_random() & ~1UL; // (even: no update in progress)
     light_config_initialized_rw = true;
 
-    esp_err_t err = light_driver_update();
+    esp_err_t err = light_driver_set_output(light_config_rw.pwm_frequency, light_config_rw.dithering);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "light driver output config failed: %s", esp_err_to_name(err));
+    }
+
+    err = light_driver_update();
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "light driver update failed: %s", esp_err_to_name(err));
         if (ret == ESP_OK) {
@@ -417,19 +641,46 @@ esp_err_t light_config_update(lc_flash_var_t key, uint32_t val) {
 esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_effect_type effect) {
     esp_err_t ret = ESP_OK;
 
+    // Every case ends the write (lc_write_end()) right after its assignments,
+    // before the side effects; the one after the switch covers the rest
+    lc_write_begin();
+
     switch (key) {
         case LCFV_rf_switch_external:
             if (light_config_rw.rf_switch_external == val) {
+                lc_write_end();
                 // already set: persist (→ set twice to the same value to persist)
                 light_config_persist_var(LCFV_rf_switch_external);
             } else {
                 // change: switch without persisting
                 light_config_rw.rf_switch_external = val;
+                lc_write_end();
                 rf_switch_set(light_config_rw.rf_switch_external);
             }
             break;
+        case LCFV_rf_switch_auto:
+            light_config_rw.rf_switch_auto = val;
+            lc_write_end();
+            light_config_persist_var(LCFV_rf_switch_auto);
+            break;
+        case LCFV_pwm_frequency:
+        case LCFV_dithering: {
+            uint16_t pwm_frequency = key == LCFV_pwm_frequency ? val : light_config_rw.pwm_frequency;
+            bool dithering = key == LCFV_dithering ? val : light_config_rw.dithering;
+            ret = light_driver_set_output(pwm_frequency, dithering);
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "Invalid output config (%u Hz), skip.", pwm_frequency);
+                break;
+            }
+            light_config_rw.pwm_frequency = pwm_frequency;
+            light_config_rw.dithering = dithering;
+            lc_write_end();
+            light_config_persist_var(key);
+            break;
+        }
         case LCFV_onoff:
             light_config_rw.onoff = val;
+            lc_write_end();
             if (light_config->startup_onoff == STARTUP_ONOFF_PREVIOUS ||
                     light_config->startup_onoff == STARTUP_ONOFF_TOGGLE) {
                 trigger_delayed_save(DS_onoff);
@@ -442,6 +693,7 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
             break;
         case LCFV_startup_onoff:
             light_config_rw.startup_onoff = val;
+            lc_write_end();
             if (val == STARTUP_ONOFF_PREVIOUS || val == STARTUP_ONOFF_TOGGLE) {
                 light_config_persist_var(LCFV_onoff);
             }
@@ -450,6 +702,7 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
         case LCFV_level_options:
             uint32_t oldval = light_config_rw.level_options;
             light_config_rw.level_options = val;
+            lc_write_end();
             light_config_persist_var(LCFV_level_options);
             if ((oldval & 2) != (val & 2)) { // has "Couple changes to level with Color temp" changed?
                 ret = light_driver_update();
@@ -460,6 +713,7 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
                 ESP_LOGW(TAG, "Invalid level 0, skip.");
             } else {
                 light_config_rw.level = val;
+                lc_write_end();
                 if (light_config->startup_level == STARTUP_LEVEL_PREVIOUS) {
                     trigger_delayed_save(DS_level);
                 }
@@ -468,6 +722,7 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
             break;
         case LCFV_startup_level:
             light_config_rw.startup_level = val;
+            lc_write_end();
             if (val == STARTUP_LEVEL_PREVIOUS) {
                 light_config_persist_var(LCFV_level);
             }
@@ -475,10 +730,12 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
             break;
         case LCFV_color_options:
             light_config_rw.color_options = val;
+            lc_write_end();
             light_config_persist_var(LCFV_color_options);
             break;
         case LCFV_temperature:
             light_config_rw.temperature = val;
+            lc_write_end();
             if (light_config->startup_temperature == STARTUP_TEMP_PREVIOUS) {
                 trigger_delayed_save(DS_temperature);
             }
@@ -486,12 +743,126 @@ esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_e
             break;
         case LCFV_startup_temperature:
             light_config_rw.startup_temperature = val;
+            lc_write_end();
             if (val == STARTUP_TEMP_PREVIOUS) {
                 light_config_persist_var(LCFV_temperature);
             }
             light_config_persist_var(LCFV_startup_temperature);
             break;
     }
+    lc_write_end();
 
     return ret;
 }
+
+esp_err_t light_config_check_state(uint8_t fields, uint8_t level, uint16_t temperature) {
+    if ((fields & LC_STATE_LEVEL) && (level == 0 || level == 0xff)) {
+        ESP_LOGW(TAG, "Invalid level %d, skip.", level);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((fields & LC_STATE_TEMPERATURE) &&
+            (temperature < light_config->min_temperature || temperature > light_config->max_temperature)) {
+        ESP_LOGW(TAG, "Invalid temperature %d, skip.", temperature);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t light_config_update_state(uint8_t fields, bool onoff, uint8_t level, uint16_t temperature, uint16_t transition_ms) {
+    esp_err_t err = light_config_check_state(fields, level, temperature);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // All at once, so no reader sees e.g. the new level with the old temperature
+    lc_write_begin();
+    if (fields & LC_STATE_ONOFF) {
+        light_config_rw.onoff = onoff;
+    }
+    if (fields & LC_STATE_LEVEL) {
+        light_config_rw.level = level;
+    }
+    if (fields & LC_STATE_TEMPERATURE) {
+        light_config_rw.temperature = temperature;
+    }
+    lc_write_end();
+
+    if ((fields & LC_STATE_ONOFF) && (light_config->startup_onoff == STARTUP_ONOFF_PREVIOUS ||
+                light_config->startup_onoff == STARTUP_ONOFF_TOGGLE)) {
+        trigger_delayed_save(DS_onoff);
+    }
+    if ((fields & LC_STATE_LEVEL) && light_config->startup_level == STARTUP_LEVEL_PREVIOUS) {
+        trigger_delayed_save(DS_level);
+    }
+    if ((fields & LC_STATE_TEMPERATURE) && light_config->startup_temperature == STARTUP_TEMP_PREVIOUS) {
+        trigger_delayed_save(DS_temperature);
+    }
+
+    return light_driver_update_with_transition(transition_ms);
+}
+
+uint32_t light_config_generation() {
+    return lc_generation;
+}
+
+uint32_t light_config_snapshot(lc_snapshot_t *snapshot) {
+    uint32_t generation;
+
+    for (uint8_t tries = 1; ; tries++) {
+        if (seqlock_read_begin(&lc_generation, &generation)) {
+            snapshot->config = light_config_rw;
+            if (seqlock_read_valid(&lc_generation, generation)) {
+                break;
+            }
+        }
+        if (tries >= SNAPSHOT_SPINS) {
+            vTaskDelay(1); // writer got preempted mid-update; let it finish
+            tries = 0;
+        }
+    }
+    snapshot->generation = generation;
+
+    return generation;
+}
+
+size_t light_config_dump_state(uint32_t generation, uint8_t *out, size_t size) {
+    ld_status_t status;
+    light_driver_get_status(&status);
+
+    // Effect/fade fields move without config writes: while they do, report an odd
+    // generation (never a settled one) and always send everything, so a caller
+    // polling with the last seen generation also sees them progress and finish
+    bool busy = status.effect != LD_Effect_None || status.fade_progress < 100;
+    lc_state_dump_header hdr = {
+        .version = STATE_DUMP_VERSION,
+        .generation = lc_generation | busy,
+    };
+
+    if (size < sizeof(hdr)) {
+        return 0;
+    }
+    memcpy(out, &hdr, sizeof(hdr));
+
+    if ((!busy && hdr.generation == generation) || size < sizeof(hdr) + sizeof(lc_state_dump)) {
+        return sizeof(hdr);
+    }
+
+    lc_state_dump state = {
+        .onoff = light_config->onoff,
+        .level = light_config->level,
+        .temperature = light_config->temperature,
+        .startup_onoff = light_config->startup_onoff,
+        .startup_level = light_config->startup_level,
+        .startup_temperature = light_config->startup_temperature,
+        .level_options = light_config->level_options,
+        .color_options = light_config->color_options,
+        .rf_switch_external = light_config->rf_switch_external,
+        .effect = status.effect,
+        .fade_progress = status.fade_progress,
+        .fade_remaining = status.fade_remaining,
+    };
+    memcpy(out + sizeof(hdr), &state, sizeof(state));
+
+    return sizeof(hdr) + sizeof(state);
+}
@@ -22,6 +22,9 @@ extern "C" {
 // Light config for state tracking & zibgbee cluster creation
 typedef struct light_config_s {
     bool rf_switch_external; // external antenna (u.fl) for rfswitch
+    bool rf_switch_auto; // [RW] antenna diversity: rf_switch_external follows link quality
+    uint16_t pwm_frequency; // [RW] PWM frequency (Hz), 0 = default (calibration or compiled-in)
+    bool dithering; // [RW] temporal dithering for extra resolution at deep dim levels
 
     // Basic cluster
     char *manufacturer_name; // [R] up to 32 bytes
@@ -49,13 +52,25 @@ typedef struct light_config_s {
 } light_config_t;
 
 // Global accessor of the light config
+//
+// Written from zigbee context only; other tasks should read through
+// light_config_snapshot() to get values consistent with each other.
 extern const light_config_t * const light_config;
 extern const bool * const light_config_initialized;
 
+// Consistent copy of the light config (see light_config_snapshot())
+typedef struct lc_snapshot_s {
+    uint32_t generation; // light_config_generation() the copy is of
+    light_config_t config;
+} lc_snapshot_t;
+
 // All the flash variables we'll be storing (used for enum and to_string),
 // all of them will get stored in uint32_t. All generated with LCFV_ prefix.
 #define _LCFV_ITER(X) \
     X(rf_switch_external) \
+    X(rf_switch_auto) \
+    X(pwm_frequency) \
+    X(dithering) \
     X(onoff) \
     X(startup_onoff) \
     X(level_options) \
@@ -71,19 +86,28 @@ typedef enum lc_flash_var_s {
 } lc_flash_var_t;
 #undef LCFV_AS_ENUM
 
-// Save num variables to nvs at the same time
+// Queue num variables for saving to nvs (one commit, on the executor)
 //
-// Normally taken care of by light_config_update()
+// Returns right away; the values written are the current ones at that
+// point (all of them from one snapshot), and repeated requests coalesce.
+// Failed writes are retried (backing off). Normally taken care of by
+// light_config_update().
 esp_err_t light_config_persist_vars(lc_flash_var_t *vars, size_t num);
 
-// Save given variable (key) to nvs
+// Queue given variable (key) for saving to nvs
 //
 // Normally taken care of by light_config_update()
 esp_err_t light_config_persist_var(lc_flash_var_t key);
 
-// Erase all keys from nvs
+// Queue erase of all keys from nvs (drops writes queued so far)
 esp_err_t light_config_erase_flash();
 
+// Carry out the queued flash work now, on the caller
+//
+// For when it must be done before moving on (e.g. erase before a factory
+// reset); call from the executor, so it doesn't race the queued run.
+void light_config_flush();
+
 // Create zigbee light clusters based on the config
 esp_zb_cluster_list_t *light_config_clusters_create();
 
@@ -101,6 +125,48 @@ esp_err_t light_config_update(lc_flash_var_t key, uint32_t val);
 // Note: currently only LCVF_onoff implements effect trigger
 esp_err_t light_config_update_with_effect(lc_flash_var_t key, uint32_t val, ld_effect_type effect);
 
+// Fields present in light_config_update_state() call (bitmask)
+#define LC_STATE_ONOFF 0x01
+#define LC_STATE_LEVEL 0x02
+#define LC_STATE_TEMPERATURE 0x04
+
+// Update onoff, level and temperature (those present in fields) at once,
+// with a single light update fading over transition_ms
+//
+// Returns ESP_ERR_INVALID_ARG (and changes nothing) if any value is out of range.
+esp_err_t light_config_update_state(uint8_t fields, bool onoff, uint8_t level, uint16_t temperature, uint16_t transition_ms);
+
+// Check values (those present in fields) the way light_config_update_state() does, without applying
+//
+// Returns ESP_ERR_INVALID_ARG if any value is out of range.
+esp_err_t light_config_check_state(uint8_t fields, uint8_t level, uint16_t temperature);
+
+// Generation of the light state; changes whenever any of the variables does
+//
+// Starts at a random value on boot, so callers can't mistake a rebooted light
+// for an unchanged one. Always even once initialized (odd = update in progress).
+uint32_t light_config_generation();
+
+// Copy the light config to snapshot, without locks, from any task (not ISR)
+//
+// The copy is never torn by a concurrent update (seqlock: retried if an
+// update ran meanwhile). Returns the generation of the copy; comparing
+// light_config_generation() to it is a cheap way to skip a fresh copy.
+uint32_t light_config_snapshot(lc_snapshot_t *snapshot);
+
+// Write packed snapshot of the light state to out (at most size bytes)
+//
+// If generation matches the current one, only the header is written (→ unchanged).
+// While an effect or fade is in progress, the generation written is odd and the
+// full state is always sent (back to the even one once it settles).
+// Returns number of bytes written. Format (little endian):
+//   u8 version, u32 generation,
+//   then (if changed): u8 onoff, u8 level, u16 temperature,
+//   u8 startup_onoff, u8 startup_level, u16 startup_temperature,
+//   u8 level_options, u8 color_options, u8 rf_switch_external,
+//   u8 effect in progress (ld_effect_type), u8 fade progress (%), u16 fade remaining (ms)
+size_t light_config_dump_state(uint32_t generation, uint8_t *out, size_t size);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
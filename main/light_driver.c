@@ -4,6 +4,8 @@
  *
  * This code is licensed under GPL version 3.
  */
+#include <string.h>
+
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "esp_check.h"
@@ -11,10 +13,20 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "alloc_guard.h"
+#include "calibration.h"
+#include "color_model.h"
 #include "data_tables.h"
+#include "dither.h"
+#include "effect_programs.h"
 #include "global_config.h"
 #include "light_config.h"
 #include "light_driver.h"
+#include "pwm_stagger.h"
+#include "trace.h"
+
+#define DEFAULT_TRANSITION 100 // ms
+#define FINISH_TRANSITION 500 // ms; winding down a hw sequence on LD_Effect_Finish
 
 static const char *TAG = "LIGHT_DRIVER";
 static TaskHandle_t ld_task_handle;
@@ -23,23 +35,91 @@ volatile static bool ld_initialized = false;
 static portMUX_TYPE ld_fade_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
 volatile static uint8_t ld_channels_fading = 0; // bitmap for when given channel fade is active
 volatile static bool ld_ledc_fade_active = false; // whether there's active fade
+static int64_t ld_fade_start = 0; // when the last fade started (μs)
+static uint16_t ld_fade_time = 0; // duration of the last fade (ms)
+volatile static ld_effect_type ld_active_effect = LD_Effect_None; // effect being played (for status)
 
 static portMUX_TYPE ld_update_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
 volatile static bool light_config_updated = false; // when onoff, color, or level updated
+volatile static uint16_t update_transition = DEFAULT_TRANSITION; // fade time for the pending update (ms)
 volatile static ld_effect_type desired_effect = LD_Effect_None; // other than None overrides light config fully
+volatile static uint8_t desired_program = 0; // effect program slot (for LD_Effect_Custom)
+static int64_t ld_hold_until = 0; // don't start anything before this time (μs)
+static bool ld_streaming = false; // stream overrides effects and light_config while set
+static bool stream_updated = false; // new stream target pending
+static uint8_t stream_level = 0;
+static uint16_t stream_temperature = 0; // fractional mireds
+static uint16_t stream_time = 0; // fade time to the stream target (ms)
+static bool output_updated = false; // new output configuration pending:
+static uint16_t output_pwm_freq = 0; // ... pwm frequency (Hz, 0 = default)
+static bool output_dithering = false; // ... temporal dithering
+static esp_timer_handle_t ld_hold_timer; // wakes the task up at ld_hold_until
+
+static const double brightness_normal[256] = BRIGHTNESS_DATA_NORMAL;
+static const double brightness_cold[256] = BRIGHTNESS_DATA_COLD;
+static const double brightness_warm[256] = BRIGHTNESS_DATA_HOT;
+static const double *const brightness_tables[CALIB_CHANNELS] = { brightness_normal, brightness_cold, brightness_warm };
+static const calib_profile_t *ld_calib = NULL; // calibration profile (in flash), NULL = compiled-in tables
+
+typedef struct {
+    int gpio; // -1 = not connected
+    ld_channel_role role;
+} ld_channel;
+
+static ld_channel ld_channels[] = MY_LIGHT_CHANNEL_MAP; // index = ledc channel
+#define NUM_CHANNELS (sizeof(ld_channels) / sizeof(ld_channels[0]))
+_Static_assert(NUM_CHANNELS >= 1 && NUM_CHANNELS <= LD_MAX_CHANNELS, "bad MY_LIGHT_CHANNEL_MAP");
+_Static_assert(LD_MAX_CHANNELS <= CALIB_GPIOS, "calibration can't cover all channels");
+_Static_assert(LD_TEMPERATURE_FRAC_BITS == CM_FRAC_BITS, "streamed temperatures go to the color model as they are");
+static uint8_t ld_active_channels = 0; // bitmap of channels with PWM (role other than LD_Role_Unused)
 
-#define COLOR_TABLE_SIZE COLOR_MAX_TEMPERATURE - COLOR_MIN_TEMPERATURE + 1
-static double color_normal[COLOR_TABLE_SIZE] = COLOR_DATA_NORMAL;
-static double color_cold[COLOR_TABLE_SIZE] = COLOR_DATA_COLD;
-static double color_warm[COLOR_TABLE_SIZE] = COLOR_DATA_HOT;
-static double brightness_normal[256] = BRIGHTNESS_DATA_NORMAL;
-static double brightness_cold[256] = BRIGHTNESS_DATA_COLD;
-static double brightness_warm[256] = BRIGHTNESS_DATA_HOT;
+#define FOR_ACTIVE_CHANNELS(c) \
+    for (int c = 0; c < (int) NUM_CHANNELS; c++) if (ld_active_channels & (1 << c))
 
 #define MY_SPD_MODE LEDC_LOW_SPEED_MODE
-#define MY_DUTY_RES LEDC_TIMER_13_BIT
-#define MAX_DUTY ((1 << MY_DUTY_RES) - 1)
-#define MAX_CHANNELS 5 // this better be set right, or the fading won't work
+#define MY_PWM_FREQ 5000 // default; Hue runs at 1k (see light_driver_set_output)
+#define LEDC_SRC_HZ 80000000 // PLL_F80M, what LEDC_AUTO_CLK picks on the ESP32-C6
+#define MIN_DUTY_RES 8
+#define MAX_DUTY_RES (SOC_LEDC_TIMER_BIT_WIDTH < 16 ? SOC_LEDC_TIMER_BIT_WIDTH : 16) // curves are Q16 anyway
+static uint32_t ld_default_pwm_freq = MY_PWM_FREQ; // (calibration may override)
+static uint32_t ld_pwm_freq = MY_PWM_FREQ; // current frequency...
+static uint32_t ld_max_duty = (1 << 13) - 1; // ... and full duty at the current resolution
+#define MAX_DUTY ld_max_duty
+
+// Temporal dithering: duties are computed with DITHER_BITS extra fractional
+// bits; at rest, deep-dim channels alternate between the two adjacent duty
+// codes (see dither.h). The tick runs from the esp_timer task: ledc_set_duty
+// takes the fade semaphore, so it's not safe from an ISR (with or without
+// CONFIG_LEDC_CTRL_FUNC_IN_IRAM); the tick jitter that adds is harmless
+// (host_test/test_dither.c).
+#define DITHER_BELOW (ld_max_duty / 32) // only dither below ~3% duty (above that, a step is invisible)
+static bool ld_dithering = false; // dithering enabled (task only)
+static lc_snapshot_t ld_lc = { .generation = 1 }; // light_config as of the last update (task only; 1 = never taken)
+static uint32_t ld_duty_target[LD_MAX_CHANNELS]; // last fade target, in 1/(1 << DITHER_BITS) duty
+static uint32_t ld_dither_acc[LD_MAX_CHANNELS]; // sigma-delta accumulators
+volatile static uint8_t ld_dither_channels = 0; // bitmap of channels being dithered (0 = timer stopped)
+static esp_timer_handle_t ld_dither_timer;
+static uint32_t ld_hpoints[LD_MAX_CHANNELS]; // current hpoint per channel (see stagger_hpoints)
+
+// Coherent updates: channel updates are staged with the ledc timer paused, so
+// they all latch on the same PWM period (instead of whenever each call lands;
+// costs one period stretched by the staging time)
+#define COHERENT_UPDATES 1
+static int64_t ld_stage_start = 0; // when staging started (μs)
+volatile static uint16_t ld_stage_time = 0; // staging time of the last update (μs; coherent: timer paused this long)
+volatile static uint16_t ld_max_stage_time = 0; // ... max since boot
+volatile static uint16_t ld_start_skew = 0; // first to last channel start of the last update (μs; 0 if coherent)
+volatile static uint16_t ld_max_start_skew = 0; // ... max since boot
+
+#if SOC_LEDC_GAMMA_CURVE_FADE_SUPPORTED
+// Effects get compiled into multi-range LEDC fades, played back by hardware
+#define HW_SEQUENCES 1
+#define HW_MAX_RANGES SOC_LEDC_GAMMA_CURVE_FADE_RANGE_MAX
+#define HW_MAX_PARAM ((1 << SOC_LEDC_FADE_PARAM_BIT_WIDTH) - 1)
+#define HW_RANGES_PER_FRAME 2 // linear fade = up to two ranges (see frame_to_ranges)
+#else
+#define HW_SEQUENCES 0
+#endif
 
 static IRAM_ATTR bool cb_fade_end(const ledc_cb_param_t *param, void *user_arg) {
     BaseType_t taskAwoken = pdFALSE;
@@ -51,6 +131,7 @@ static IRAM_ATTR bool cb_fade_end(const ledc_cb_param_t *param, void *user_arg)
         ld_channels_fading &= ~(1 << param->channel); // clear this channel
         if (prev && ! ld_channels_fading) {
             ld_ledc_fade_active = false;
+            TRACE(fade_end, param->channel, 0, 0, 0);
             vTaskNotifyGiveFromISR(ld_task_handle, &taskAwoken);
         }
         taskEXIT_CRITICAL_ISR(&ld_fade_spinlock);
@@ -63,52 +144,205 @@ static IRAM_ATTR bool cb_fade_end(const ledc_cb_param_t *param, void *user_arg)
     ledc_set_fade_time_and_start(MY_SPD_MODE, chan, (duty), (time), LEDC_FADE_NO_WAIT); \
 } while(0)
 
-static void fade_to(bool onoff, uint8_t level, uint16_t temperature, uint16_t time) {
-    // Mark all channels active
-    taskENTER_CRITICAL(&ld_fade_spinlock);
-    ld_ledc_fade_active = true;
-    ld_channels_fading = (1 << MAX_CHANNELS) - 1;
-    taskEXIT_CRITICAL(&ld_fade_spinlock);
+static void stop_fading();
 
-    // Kick off the fading
+// Start staging updates of all active channels (see COHERENT_UPDATES)
+//
+// Stops whatever still fades first (a no-op if the caller did already): ledc
+// takes a new duty or fade on a fading channel only once that fade ends, and
+// with the timer paused it never does.
+static void stage_begin() {
+    stop_fading();
+#if COHERENT_UPDATES
+    ledc_timer_pause(MY_SPD_MODE, LEDC_TIMER_0);
+#endif
+    ld_stage_start = esp_timer_get_time();
+}
+
+// Latch the staged updates, recording the staging time and the skew between
+// the first and last channel start
+static void stage_end() {
+    int64_t took = esp_timer_get_time() - ld_stage_start;
+#if COHERENT_UPDATES
+    ledc_timer_resume(MY_SPD_MODE, LEDC_TIMER_0);
+    int64_t skew = 0; // (all latch on the resumed period)
+#else
+    int64_t skew = took; // (each channel started as its update landed)
+#endif
+    ld_stage_time = took < UINT16_MAX ? took : UINT16_MAX;
+    if (ld_stage_time > ld_max_stage_time) {
+        ld_max_stage_time = ld_stage_time;
+    }
+    ld_start_skew = skew < UINT16_MAX ? skew : UINT16_MAX;
+    if (ld_start_skew > ld_max_start_skew) {
+        ld_max_start_skew = ld_start_skew;
+    }
+    TRACE(start_skew, COHERENT_UPDATES, ld_active_channels, ld_stage_time, skew);
+}
+
+// Brightness (0..1) of given channel at level
+static double brightness(int channel, uint8_t level) {
+    if (ld_calib) {
+        return ld_calib->brightness[channel][level] / (double) CALIB_ONE;
+    }
+    return brightness_tables[channel][level];
+}
+
+// Duty (in 1/(1 << DITHER_BITS) counts) of a channel with given role at (fractional) temperature and level
+static uint32_t channel_duty(ld_channel_role role, int32_t temperature, uint8_t level) {
+    double full = (double) (MAX_DUTY << DITHER_BITS);
+    switch (role) {
+        case LD_Role_Normal:
+            return full * (color_model_eval(CM_Normal, temperature) / (double) CM_ONE) * brightness(0, level);
+        case LD_Role_Cold:
+            return full * (color_model_eval(CM_Cold, temperature) / (double) CM_ONE) * brightness(1, level);
+        case LD_Role_Warm:
+            return full * (color_model_eval(CM_Warm, temperature) / (double) CM_ONE) * brightness(2, level);
+        case LD_Role_Dim:
+            return full * brightness(0, level);
+        default:
+            return 0;
+    }
+}
+
+// Compute fine duties (1/(1 << DITHER_BITS) counts) of all channels (by their role) for given state
+// (temperature in fractional mireds); unused ones get 0
+static void compute_fine_duties(bool onoff, uint8_t level, int32_t temperature, uint32_t duties[LD_MAX_CHANNELS]) {
+    memset(duties, 0, LD_MAX_CHANNELS * sizeof(duties[0]));
     if (! onoff) {
-        ESP_LOGI(TAG, "Set to off, t: %u", time);
-        FADE(LEDC_CHANNEL_0, 0, time);
-        FADE(LEDC_CHANNEL_1, 0, time);
-        FADE(LEDC_CHANNEL_2, 0, time);
-        FADE(LEDC_CHANNEL_3, 0, time); // XXX: unused
-        FADE(LEDC_CHANNEL_4, 0, time); // XXX: unused
-    } else {
-        uint8_t new_level = level;
-        uint16_t new_temp = temperature;
-        if (light_config->level_options&2) {
+        return;
+    }
+
+    uint8_t new_level = level;
+    int32_t new_temp = temperature; // (model clamps)
+    if (ld_lc.config.level_options&2) {
 #define MAX_LEVEL 254
 #define MIN_LEVEL 1
-            uint16_t min_temp = light_config->couple_min_temperature;
-            uint16_t max_temp = temperature;
-            // My reading of ZCLv8 is that when coupled, it is:
-            new_temp = max_temp - ((new_level - MIN_LEVEL) * (max_temp - min_temp)) / (MAX_LEVEL - MIN_LEVEL);
+        int32_t min_temp = ld_lc.config.couple_min_temperature << CM_FRAC_BITS;
+        int32_t max_temp = new_temp;
+        // My reading of ZCLv8 is that when coupled, it is:
+        new_temp = max_temp - ((new_level - MIN_LEVEL) * (max_temp - min_temp)) / (MAX_LEVEL - MIN_LEVEL);
+    }
+    FOR_ACTIVE_CHANNELS(c) {
+        duties[c] = channel_duty(ld_channels[c].role, new_temp, new_level);
+    }
+}
+
+// Compute duties of all channels for given state
+static void compute_duties(bool onoff, uint8_t level, uint16_t temperature, uint32_t duties[LD_MAX_CHANNELS]) {
+    compute_fine_duties(onoff, level, temperature << CM_FRAC_BITS, duties);
+    for (int c = 0; c < LD_MAX_CHANNELS; c++) {
+        duties[c] >>= DITHER_BITS;
+    }
+}
+
+static void dither_tick_cb(void *arg) {
+    uint8_t channels = ld_dither_channels;
+    for (int c = 0; c < LD_MAX_CHANNELS; c++) {
+        if (channels & (1 << c)) {
+            uint32_t duty = dither_step(ld_duty_target[c], &ld_dither_acc[c]);
+            ledc_set_duty(MY_SPD_MODE, c, duty);
+            ledc_update_duty(MY_SPD_MODE, c);
+        }
+    }
+}
+
+// Stop dithering (before anything else touches the duties)
+static void dither_stop() {
+    if (ld_dither_channels) {
+        esp_timer_stop(ld_dither_timer);
+        ld_dither_channels = 0;
+    }
+}
+
+// Start dithering the deep-dim channels resting between two duty codes (if enabled)
+static void dither_start() {
+    uint8_t channels = 0;
+
+    // (below 2 kHz the tone would flicker visibly; resolution is ≥ 14 bit there anyway)
+    if (!ld_dithering || ld_dither_channels || dither_period(ld_pwm_freq) > DITHER_PERIOD) {
+        return;
+    }
+    FOR_ACTIVE_CHANNELS(c) {
+        if ((ld_duty_target[c] & DITHER_MASK) && (ld_duty_target[c] >> DITHER_BITS) < DITHER_BELOW) {
+            ld_dither_acc[c] = 0;
+            channels |= 1 << c;
+        }
+    }
+    if (!channels) {
+        return;
+    }
+
+    ld_dither_channels = channels;
+    esp_err_t err = esp_timer_start_periodic(ld_dither_timer, dither_period(ld_pwm_freq));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "can't start dither timer: %s", esp_err_to_name(err));
+        ld_dither_channels = 0;
+    }
+}
+
+// Spread the channels' on-times across the PWM period for a fade to duties
+// (see pwm_stagger; host_test/test_pwm_stagger.c has the supply current).
+//
+// Only touches the hpoint (with the current duty), which ledc keeps through
+// fades; the new one latches at the next period (i.e. when the fade starts).
+// No channel may be mid-fade: ledc would wait for that fade to end.
+static void stagger_hpoints(const uint32_t duties[LD_MAX_CHANNELS]) {
+    uint32_t spans[LD_MAX_CHANNELS] = { 0 }, hpoints[LD_MAX_CHANNELS] = { 0 };
+
+    FOR_ACTIVE_CHANNELS(c) {
+        uint32_t duty = ledc_get_duty(MY_SPD_MODE, c);
+        spans[c] = duty > duties[c] ? duty : duties[c]; // (fades pass through both)
+    }
+    pwm_stagger(MAX_DUTY + 1, ld_active_channels, duties, spans, hpoints);
+    FOR_ACTIVE_CHANNELS(c) {
+        if (ld_hpoints[c] != hpoints[c]) {
+            ledc_set_duty_with_hpoint(MY_SPD_MODE, c, ledc_get_duty(MY_SPD_MODE, c), hpoints[c]);
+            ld_hpoints[c] = hpoints[c];
         }
-        double normal = color_normal[new_temp - COLOR_MIN_TEMPERATURE] * brightness_normal[new_level];
-        double cold = color_cold[new_temp - COLOR_MIN_TEMPERATURE] * brightness_cold[new_level];
-        double warm = color_warm[new_temp - COLOR_MIN_TEMPERATURE] * brightness_warm[new_level];
-        ESP_LOGI(TAG, "Set to %.04f, %.04f, %.04f (o/l/t: [%d, %d, %d], t: %u)",
-                normal, cold, warm, onoff, new_level, new_temp, time);
-        FADE(LEDC_CHANNEL_0, MAX_DUTY * normal, time);
-        FADE(LEDC_CHANNEL_1, MAX_DUTY * cold, time);
-        FADE(LEDC_CHANNEL_2, MAX_DUTY * warm, time);
-        FADE(LEDC_CHANNEL_3, 0, time); // XXX: unused
-        FADE(LEDC_CHANNEL_4, 0, time); // XXX: unused
     }
 }
 
-#define STOP_FADE(chan) ledc_fade_stop(MY_SPD_MODE, chan)
+// Note: not staged; ledc_fade_stop() waits for the fade isr, which doesn't
+// come with the timer paused. Stopped channels merely hold their duty, and
+// whatever comes next starts coherently again.
 static void stop_fading() {
-    STOP_FADE(LEDC_CHANNEL_0);
-    STOP_FADE(LEDC_CHANNEL_1);
-    STOP_FADE(LEDC_CHANNEL_2);
-    STOP_FADE(LEDC_CHANNEL_3);
-    STOP_FADE(LEDC_CHANNEL_4);
+    dither_stop();
+    FOR_ACTIVE_CHANNELS(c) {
+        ledc_fade_stop(MY_SPD_MODE, c);
+    }
+}
+
+// Fade to given state; temperature in fractional mireds (mireds << CM_FRAC_BITS)
+static void fade_to_fine(bool onoff, uint8_t level, int32_t temperature, uint16_t time) {
+    stop_fading(); // (see stagger_hpoints)
+
+    // Mark all active channels fading
+    taskENTER_CRITICAL(&ld_fade_spinlock);
+    ld_ledc_fade_active = true;
+    ld_channels_fading = ld_active_channels;
+    ld_fade_start = esp_timer_get_time();
+    ld_fade_time = time;
+    taskEXIT_CRITICAL(&ld_fade_spinlock);
+
+    // Kick off the fading
+    uint32_t duties[LD_MAX_CHANNELS];
+    compute_fine_duties(onoff, level, temperature, ld_duty_target);
+    for (int c = 0; c < LD_MAX_CHANNELS; c++) {
+        duties[c] = ld_duty_target[c] >> DITHER_BITS;
+    }
+    TRACE(fade_start, onoff, level, temperature >> CM_FRAC_BITS, time);
+    TRACE(fade_duties, 0, duties[0], duties[1], duties[2]);
+    stage_begin();
+    stagger_hpoints(duties);
+    FOR_ACTIVE_CHANNELS(c) {
+        FADE(c, duties[c], time);
+    }
+    stage_end();
+}
+
+static void fade_to(bool onoff, uint8_t level, uint16_t temperature, uint16_t time) {
+    fade_to_fine(onoff, level, temperature << CM_FRAC_BITS, time);
 }
 
 typedef struct {
@@ -117,7 +351,7 @@ typedef struct {
     const bool *onoff;
     const uint8_t *level;
     const uint16_t *temperature;
-    const uint16_t time;
+    uint16_t time;
 } effect_frame;
 
 static bool on = true;
@@ -163,17 +397,242 @@ static effect_frame Effect_DyingLight0[] = {
     LAST_FRAME,
 };
 
+// Custom effect (program) being played; only touched from the task
+static effect_frame ld_custom_frames[EP_MAX_FRAMES + 1];
+static bool ld_custom_onoff[EP_MAX_FRAMES];
+static uint8_t ld_custom_level[EP_MAX_FRAMES];
+static uint16_t ld_custom_temperature[EP_MAX_FRAMES];
+static ep_program_t ld_custom_program;
+
+// Load effect program from given slot into ld_custom_frames; returns its reps (0 = no such program)
+static uint8_t load_custom_effect(uint8_t slot) {
+    if (effect_programs_get(slot, &ld_custom_program) != ESP_OK) {
+        return 0;
+    }
+
+    for (int i = 0; i < ld_custom_program.frame_count; i++) {
+        const ep_frame_t *f = &ld_custom_program.frames[i];
+        ld_custom_onoff[i] = f->flags & EP_FRAME_ON;
+        ld_custom_level[i] = f->level;
+        ld_custom_temperature[i] = f->temperature;
+        ld_custom_frames[i] = (effect_frame) {
+            true,
+            f->flags & EP_FRAME_ABORTABLE,
+            f->flags & EP_FRAME_ONOFF ? &ld_custom_onoff[i] : NULL,
+            f->flags & EP_FRAME_LEVEL ? &ld_custom_level[i] : NULL,
+            f->flags & EP_FRAME_TEMPERATURE ? &ld_custom_temperature[i] : NULL,
+            f->time,
+        };
+    }
+    ld_custom_frames[ld_custom_program.frame_count] = (effect_frame) LAST_FRAME;
+
+    return ld_custom_program.reps;
+}
+
+static bool ld_hw_sequence_active = false; // effect frames being played by hardware (task only)
+
+#if HW_SEQUENCES
+// Append linear fade from *duty to target over given PWM cycles as (up to) two ranges
+//
+// The step count and step length only depend on cycles, so all the channels
+// stay in lockstep; the duty delta is spread as scale+1 for the first `rest`
+// steps and scale for the others. Returns number of ranges (0 = can't do).
+static uint8_t frame_to_ranges(uint32_t *duty, uint32_t target, uint32_t cycles, ledc_fade_param_config_t *r) {
+    uint32_t cycle_num = (cycles + HW_MAX_PARAM - 1) / HW_MAX_PARAM; // PWM cycles per step
+    uint32_t steps = cycles / cycle_num;
+    bool up = target >= *duty;
+    uint32_t delta = up ? target - *duty : *duty - target;
+    uint32_t scale = delta / steps;
+    uint32_t rest = delta % steps;
+    uint8_t n = 0;
+
+    if (scale + (rest ? 1 : 0) > HW_MAX_PARAM) {
+        return 0; // too steep for the hardware
+    }
+    if (rest) {
+        r[n++] = (ledc_fade_param_config_t) { .dir = up, .cycle_num = cycle_num, .scale = scale + 1, .step_num = rest };
+    }
+    if (steps > rest) {
+        r[n++] = (ledc_fade_param_config_t) { .dir = up, .cycle_num = cycle_num, .scale = scale, .step_num = steps - rest };
+    }
+    *duty = target;
+
+    return n;
+}
+
+// Compile as many effect frames (from *frame_no, *reps on) as fit into one
+// multi-range fade per channel, and start it. The task then only wakes up
+// when the whole sequence ends (or on abort).
+//
+// Advances *frame_no and *reps past the programmed frames; returns number of
+// frames programmed (0 = nothing, play in software).
+static uint8_t play_hw_sequence(const effect_frame *effect, uint8_t *frame_no, uint8_t *reps) {
+    static ledc_fade_param_config_t ranges[LD_MAX_CHANNELS][HW_MAX_RANGES];
+    uint8_t num[LD_MAX_CHANNELS] = {};
+    uint32_t start[LD_MAX_CHANNELS];
+    uint32_t duty[LD_MAX_CHANNELS];
+    uint8_t f = *frame_no;
+    uint8_t r = *reps;
+    uint8_t frames = 0;
+    uint32_t time = 0;
+
+    stop_fading(); // (so the start duties hold)
+    FOR_ACTIVE_CHANNELS(c) {
+        start[c] = duty[c] = ledc_get_duty(MY_SPD_MODE, c);
+    }
+
+    while (true) {
+        if (!effect[f].valid) {
+            if (r > 1) {
+                r--; // next rep
+                f = 0;
+                continue;
+            }
+            break; // end of the animation
+        }
+
+        uint32_t target[LD_MAX_CHANNELS];
+        uint32_t next[LD_MAX_CHANNELS];
+        ledc_fade_param_config_t fr[LD_MAX_CHANNELS][HW_RANGES_PER_FRAME];
+        uint8_t n[LD_MAX_CHANNELS] = {};
+        uint32_t cycles = effect[f].time * ld_pwm_freq / 1000;
+        bool fits = cycles > 0;
+
+        compute_duties(
+                effect[f].onoff ? *effect[f].onoff : ld_lc.config.onoff,
+                effect[f].level ? *effect[f].level : ld_lc.config.level,
+                effect[f].temperature ? *effect[f].temperature : ld_lc.config.temperature,
+                target);
+        FOR_ACTIVE_CHANNELS(c) {
+            if (!fits) {
+                break;
+            }
+            next[c] = duty[c];
+            n[c] = frame_to_ranges(&next[c], target[c], cycles, fr[c]);
+            fits = n[c] > 0 && num[c] + n[c] <= HW_MAX_RANGES;
+        }
+        if (!fits) {
+            break; // out of ranges (or can't do this frame at all)
+        }
+
+        FOR_ACTIVE_CHANNELS(c) {
+            memcpy(&ranges[c][num[c]], fr[c], n[c] * sizeof(fr[c][0]));
+            num[c] += n[c];
+            duty[c] = next[c];
+        }
+        time += effect[f].time;
+        frames++;
+        f++;
+    }
+
+    if (frames == 0) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL(&ld_fade_spinlock);
+    ld_ledc_fade_active = true;
+    ld_channels_fading = ld_active_channels;
+    ld_fade_start = esp_timer_get_time();
+    ld_fade_time = time < UINT16_MAX ? time : UINT16_MAX;
+    taskEXIT_CRITICAL(&ld_fade_spinlock);
+
+    stage_begin();
+    FOR_ACTIVE_CHANNELS(c) {
+        esp_err_t err = ledc_set_multi_fade_and_start(MY_SPD_MODE, c, start[c], ranges[c], num[c], LEDC_FADE_NO_WAIT);
+        if (err != ESP_OK) {
+            stage_end();
+            ESP_LOGW(TAG, "can't start hw sequence on chan %d: %s", c, esp_err_to_name(err));
+            stop_fading();
+            taskENTER_CRITICAL(&ld_fade_spinlock);
+            ld_ledc_fade_active = false;
+            ld_channels_fading = 0;
+            taskEXIT_CRITICAL(&ld_fade_spinlock);
+            return 0;
+        }
+    }
+    stage_end();
+
+    uint8_t most = 0; // ranges used by the busiest channel
+    FOR_ACTIVE_CHANNELS(c) {
+        most = num[c] > most ? num[c] : most;
+    }
+    TRACE(hw_sequence, frames, most, 0, time);
+    ld_hw_sequence_active = true;
+    *frame_no = f;
+    *reps = r;
+
+    return frames;
+}
+#endif
+
+// Set the ledc timer up for freq, at the finest duty resolution the clock allows
+static esp_err_t configure_timer(uint32_t freq) {
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    for (uint32_t bits = MAX_DUTY_RES; bits >= MIN_DUTY_RES; bits--) {
+        if (((uint64_t) freq << bits) > LEDC_SRC_HZ) {
+            continue; // clock too slow for this resolution
+        }
+        ledc_timer_config_t ledc_timer = {
+            .speed_mode = MY_SPD_MODE,
+            .timer_num = LEDC_TIMER_0,
+            .duty_resolution = bits,
+            .freq_hz = freq,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        ret = ledc_timer_config(&ledc_timer);
+        if (ret == ESP_OK) {
+            ld_pwm_freq = freq;
+            ld_max_duty = (1 << bits) - 1;
+            ESP_LOGI(TAG, "PWM at %lu Hz, %lu bit", freq, bits);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+// Apply new pwm frequency and dithering; cuts whatever runs short (the caller re-fades)
+static void reconfigure_output(uint16_t pwm_freq, bool dithering) {
+    stop_fading();
+    taskENTER_CRITICAL(&ld_fade_spinlock);
+    ld_ledc_fade_active = false;
+    ld_channels_fading = 0;
+    taskEXIT_CRITICAL(&ld_fade_spinlock);
+
+    uint32_t freq = pwm_freq ? pwm_freq : ld_default_pwm_freq;
+    if (freq != ld_pwm_freq) {
+        memset(ld_hpoints, 0xff, sizeof(ld_hpoints)); // rewrite all at the new resolution
+        esp_err_t err = configure_timer(freq);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "can't switch PWM to %lu Hz: %s, keeping %lu Hz", freq, esp_err_to_name(err), ld_pwm_freq);
+            configure_timer(ld_pwm_freq);
+        }
+    }
+    ld_dithering = dithering;
+}
 
 #define ACTIVATE_EFFECT(_reps, what) do { \
     ESP_LOGD(TAG, "Activating effect: %s with %d reps", #what, _reps); \
     current_effect = (what); \
+    ld_active_effect = want_effect; \
     frame_no = 0; \
     reps = _reps; \
+    wakeups = 0; \
+    hw_sequences = 0; \
     want_effect = LD_Effect_None; \
 } while (0)
 
 #define RESET_EFFECTS() do { \
+    if (current_effect) { \
+        TRACE(effect_end, ld_active_effect, wakeups, hw_sequences, 0); \
+        ESP_LOGD(TAG, "Effect %d done after %u wakeups (%u hw sequences)", ld_active_effect, wakeups, hw_sequences); \
+    } \
+    wakeups = 0; \
+    hw_sequences = 0; \
+    ld_hw_sequence_active = false; \
     current_effect = NULL; \
+    ld_active_effect = LD_Effect_None; \
     abort_effect = false; \
     frame_start = 0; \
     frame_duration = 0; \
@@ -186,23 +645,85 @@ static void light_driver_task(void *pvParameters) {
     uint8_t reps = 1;
     bool abort_effect = false;
     ld_effect_type want_effect = LD_Effect_None;
+    uint8_t want_program = 0;
     uint64_t frame_start = 0;
     int16_t frame_duration = 0;
+    uint16_t transition = DEFAULT_TRANSITION;
+    uint16_t wakeups = 0; // task wakeups during the current effect
+    uint16_t hw_sequences = 0; // hw sequences played during the current effect
 
     xTaskNotifyWait(0, 0, NULL, portMAX_DELAY); // block immediately ;)
     while (true) {
+        if (current_effect) {
+            wakeups++;
+        }
+
+        taskENTER_CRITICAL(&ld_update_spinlock);
+        int64_t hold_until = ld_hold_until;
+        taskEXIT_CRITICAL(&ld_update_spinlock);
+        if (hold_until > esp_timer_get_time()) {
+            // Scheduled start pending; keep collecting updates, ld_hold_timer wakes us up
+            xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+            continue;
+        }
+
         if (! *light_config_initialized) {
             ESP_LOGW(TAG, "The light_config not initialized yet, skip");
         } else {
             taskENTER_CRITICAL(&ld_update_spinlock);
+            if (light_config_updated) {
+                transition = update_transition;
+            }
             updated |= light_config_updated;
             light_config_updated = false;
+            update_transition = DEFAULT_TRANSITION;
             if (desired_effect != LD_Effect_None) {
                 want_effect = desired_effect;
+                want_program = desired_program;
             }
             desired_effect = LD_Effect_None;
+            bool streaming = ld_streaming;
+            bool stream_new = stream_updated;
+            uint8_t s_level = stream_level;
+            uint16_t s_temperature = stream_temperature;
+            uint16_t s_time = stream_time;
+            stream_updated = false;
+            bool output_new = output_updated;
+            uint16_t o_pwm_freq = output_pwm_freq;
+            bool o_dithering = output_dithering;
+            output_updated = false;
             taskEXIT_CRITICAL(&ld_update_spinlock);
 
+            // Only after consuming light_config_updated: zigbee writes the config before
+            // setting it, so an update landing from here on sets it again (another pass)
+            if (light_config_generation() != ld_lc.generation) {
+                light_config_snapshot(&ld_lc); // (zigbee might be mid-update; never torn)
+            }
+
+            if (output_new) {
+                // Duties change scale with the resolution: drop effects, snap to the new state
+                RESET_EFFECTS();
+                reconfigure_output(o_pwm_freq, o_dithering);
+                updated = true;
+                transition = 1;
+                stream_new = streaming;
+                s_time = 1;
+            }
+
+            if (streaming) {
+                // Streamed targets come in faster than fades end: cut the running one short
+                if (current_effect) {
+                    RESET_EFFECTS();
+                }
+                want_effect = LD_Effect_None; // effects don't play while streaming
+                if (stream_new) {
+                    stop_fading();
+                    fade_to_fine(true, s_level, s_temperature, s_time);
+                }
+                xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+                continue;
+            }
+
             // do we have another effect to process?
             switch (want_effect) {
                 case LD_Effect_None: // no new instruction, maybe continue current effect
@@ -210,6 +731,7 @@ static void light_driver_task(void *pvParameters) {
                         ESP_LOGD(TAG, "Fade still running, sleep");
                     } else { // fade ended, get new frame or update
                         ESP_LOGD(TAG, "No fade active...");
+                        ld_hw_sequence_active = false;
                         if (current_effect) {
                             if (frame_start > 0) {
                                 uint16_t sofar = (esp_timer_get_time() - frame_start) / 1000;
@@ -221,13 +743,20 @@ static void light_driver_task(void *pvParameters) {
                             }
                             ESP_LOGD(TAG, "We have effect to run...");
                             if (current_effect[frame_no].valid) {
+#if HW_SEQUENCES
+                                if (!abort_effect && play_hw_sequence(current_effect, &frame_no, &reps)) {
+                                    hw_sequences++;
+                                    frame_start = 0; // hardware keeps the frame timing
+                                    break;
+                                }
+#endif
                                 ESP_LOGD(TAG, "Starting frame %d, reps: %d, time: %d...", frame_no, reps, current_effect[frame_no].time);
                                 frame_start = esp_timer_get_time();
                                 frame_duration = current_effect[frame_no].time;
                                 fade_to(
-                                        current_effect[frame_no].onoff ? *current_effect[frame_no].onoff : light_config->onoff,
-                                        current_effect[frame_no].level ? *current_effect[frame_no].level : light_config->level,
-                                        current_effect[frame_no].temperature ? *current_effect[frame_no].temperature : light_config->temperature,
+                                        current_effect[frame_no].onoff ? *current_effect[frame_no].onoff : ld_lc.config.onoff,
+                                        current_effect[frame_no].level ? *current_effect[frame_no].level : ld_lc.config.level,
+                                        current_effect[frame_no].temperature ? *current_effect[frame_no].temperature : ld_lc.config.temperature,
                                         current_effect[frame_no].time);
                                 if (abort_effect && current_effect[frame_no].abortable) {
                                     ESP_LOGD(TAG, "Aborting now.");
@@ -245,7 +774,7 @@ static void light_driver_task(void *pvParameters) {
                                 } else { // no more reps → end of animation
                                     ESP_LOGD(TAG, "End of animation...");
                                     RESET_EFFECTS();
-                                    fade_to(light_config->onoff, light_config->level, light_config->temperature, 100);
+                                    fade_to(ld_lc.config.onoff, ld_lc.config.level, ld_lc.config.temperature, 100);
                                 }
                             }
                             break; // processed, get out.
@@ -253,47 +782,56 @@ static void light_driver_task(void *pvParameters) {
                             if (updated) {
                                 ESP_LOGD(TAG, "Running update...");
                                 updated = false;
-                                fade_to(light_config->onoff, light_config->level, light_config->temperature, 100);
+                                fade_to(ld_lc.config.onoff, ld_lc.config.level, ld_lc.config.temperature, transition);
+                                transition = DEFAULT_TRANSITION;
                             } else {
-                                ESP_LOGD(TAG, "No update, no effects. No-op");
+                                ESP_LOGD(TAG, "No update, no effects. Dither (if needed)");
+                                dither_start();
                             }
                         }
                     }
                     break;
                 case LD_Effect_Blink: // identify: flash once
-                    ACTIVATE_EFFECT(1, light_config->onoff ? Effect_Blink_FromOn : Effect_Blink_FromOff);
+                    ACTIVATE_EFFECT(1, ld_lc.config.onoff ? Effect_Blink_FromOn : Effect_Blink_FromOff);
                     continue;
                 case LD_Effect_Breathe: // identify: on/off over 1s, repeated 15x
                     ACTIVATE_EFFECT(15, Effect_Breathe);
                     continue;
                 case LD_Effect_Okay: // identify: flash twice
-                    ACTIVATE_EFFECT(2, light_config->onoff ? Effect_Blink_FromOn : Effect_Blink_FromOff);
+                    ACTIVATE_EFFECT(2, ld_lc.config.onoff ? Effect_Blink_FromOn : Effect_Blink_FromOff);
                     continue;
                 case LD_Effect_ChannelChange: // identify: max brightness 0.5s, then min brightness for 7.5s
                     ACTIVATE_EFFECT(1, Effect_ChannelChange);
                     continue;
                 case LD_Effect_Finish:
                     ESP_LOGD(TAG, "Triggering effect finish");
-                    abort_effect = true;
+                    if (ld_hw_sequence_active) {
+                        // can't stop hardware at a frame boundary; wind down from where we are instead
+                        stop_fading();
+                        RESET_EFFECTS();
+                        fade_to(ld_lc.config.onoff, ld_lc.config.level, ld_lc.config.temperature, FINISH_TRANSITION);
+                    } else {
+                        abort_effect = true;
+                    }
                     want_effect = LD_Effect_None; // clear it (processed)
                     break;
                 case LD_Effect_Stop:
                     ESP_LOGD(TAG, "Triggering effect stop");
                     RESET_EFFECTS();
                     stop_fading(); // we might be in the middle of one; don't wait
-                    fade_to(light_config->onoff, light_config->level, light_config->temperature, 100);
+                    fade_to(ld_lc.config.onoff, ld_lc.config.level, ld_lc.config.temperature, 100);
                     want_effect = LD_Effect_None; // clear it (processed)
                     break;
                 case LD_Effect_DelayedOff0: // fade to off in 0.8s
                     ESP_LOGD(TAG, "Triggering effect DelayedOff0");
                     RESET_EFFECTS();
-                    fade_to(false, light_config->level, light_config->temperature, 800);
+                    fade_to(false, ld_lc.config.level, ld_lc.config.temperature, 800);
                     want_effect = LD_Effect_None; // clear it (processed)
                     break;
                 case LD_Effect_DelayedOff1: // no fade (??)
                     ESP_LOGD(TAG, "Triggering effect DelayedOff1");
                     RESET_EFFECTS();
-                    fade_to(false, light_config->level, light_config->temperature, 1);
+                    fade_to(false, ld_lc.config.level, ld_lc.config.temperature, 1);
                     want_effect = LD_Effect_None; // clear it (processed)
                     break;
                 case LD_Effect_DelayedOff2: // off with effect: 50% dim down in 0.8s, then fade to off in 12s
@@ -304,6 +842,17 @@ static void light_driver_task(void *pvParameters) {
                     ESP_LOGD(TAG, "Triggering effect DyingLight0");
                     ACTIVATE_EFFECT(1, Effect_DyingLight0);
                     continue;
+                case LD_Effect_Custom: { // user-uploaded effect program
+                    ESP_LOGD(TAG, "Triggering effect program %u", want_program);
+                    uint8_t program_reps = load_custom_effect(want_program);
+                    if (program_reps) {
+                        ACTIVATE_EFFECT(program_reps, ld_custom_frames);
+                    } else {
+                        ESP_LOGW(TAG, "No effect program in slot %u, skip", want_program);
+                        want_effect = LD_Effect_None; // clear it (processed)
+                    }
+                    continue;
+                }
             }
         }
         xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
@@ -311,12 +860,17 @@ static void light_driver_task(void *pvParameters) {
 }
 
 esp_err_t light_driver_update() {
+    return light_driver_update_with_transition(DEFAULT_TRANSITION);
+}
+
+esp_err_t light_driver_update_with_transition(uint16_t time_ms) {
     if (!ld_initialized) {
         ESP_LOGE(TAG, "Update triggered without initialization, skip");
         return ESP_ERR_NOT_SUPPORTED;
     } else {
         taskENTER_CRITICAL(&ld_update_spinlock);
         light_config_updated = true;
+        update_transition = time_ms > 0 ? time_ms : 1; // ledc doesn't like zero time fades
         taskEXIT_CRITICAL(&ld_update_spinlock);
         xTaskNotifyGive(ld_task_handle);
     }
@@ -338,23 +892,160 @@ esp_err_t light_driver_trigger_effect(const ld_effect_type effect) {
     return ESP_OK;
 }
 
+esp_err_t light_driver_trigger_program(uint8_t slot) {
+    if (!ld_initialized) {
+        ESP_LOGE(TAG, "Effect program triggered without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    } else {
+        taskENTER_CRITICAL(&ld_update_spinlock);
+        desired_effect = LD_Effect_Custom;
+        desired_program = slot;
+        taskEXIT_CRITICAL(&ld_update_spinlock);
+        xTaskNotifyGive(ld_task_handle);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_stream_to(uint8_t level, uint16_t temperature, uint16_t time_ms) {
+    if (!ld_initialized) {
+        ESP_LOGE(TAG, "Stream triggered without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    } else {
+        taskENTER_CRITICAL(&ld_update_spinlock);
+        ld_streaming = true;
+        stream_updated = true;
+        stream_level = level;
+        stream_temperature = temperature;
+        stream_time = time_ms > 0 ? time_ms : 1; // ledc doesn't like zero time fades
+        taskEXIT_CRITICAL(&ld_update_spinlock);
+        xTaskNotifyGive(ld_task_handle);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_stream_end() {
+    if (!ld_initialized) {
+        ESP_LOGE(TAG, "Stream end triggered without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    } else {
+        taskENTER_CRITICAL(&ld_update_spinlock);
+        ld_streaming = false;
+        stream_updated = false;
+        light_config_updated = true; // back to light_config
+        update_transition = DEFAULT_TRANSITION;
+        taskEXIT_CRITICAL(&ld_update_spinlock);
+        xTaskNotifyGive(ld_task_handle);
+    }
+
+    return ESP_OK;
+}
+
+static void hold_timer_cb(void *arg) {
+    xTaskNotifyGive(ld_task_handle);
+}
+
+esp_err_t light_driver_set_output(uint16_t pwm_freq, bool dithering) {
+    if (pwm_freq && (pwm_freq < LD_MIN_PWM_FREQ || pwm_freq > LD_MAX_PWM_FREQ)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!ld_initialized) {
+        ESP_LOGE(TAG, "Output configured without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    taskENTER_CRITICAL(&ld_update_spinlock);
+    output_updated = true;
+    output_pwm_freq = pwm_freq;
+    output_dithering = dithering;
+    taskEXIT_CRITICAL(&ld_update_spinlock);
+    xTaskNotifyGive(ld_task_handle);
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_hold_until(int64_t deadline) {
+    if (!ld_initialized) {
+        ESP_LOGE(TAG, "Hold triggered without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (deadline <= now) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&ld_update_spinlock);
+    ld_hold_until = deadline;
+    taskEXIT_CRITICAL(&ld_update_spinlock);
+
+    esp_timer_stop(ld_hold_timer); // might not be running; that's fine
+    esp_err_t ret = esp_timer_start_once(ld_hold_timer, deadline - now);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "can't start hold timer: %s", esp_err_to_name(ret));
+        taskENTER_CRITICAL(&ld_update_spinlock);
+        ld_hold_until = 0;
+        taskEXIT_CRITICAL(&ld_update_spinlock);
+    }
+
+    return ret;
+}
+
+void light_driver_release_hold() {
+    if (!ld_initialized) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&ld_update_spinlock);
+    ld_hold_until = 0;
+    taskEXIT_CRITICAL(&ld_update_spinlock);
+
+    esp_timer_stop(ld_hold_timer); // might not be running; that's fine
+    xTaskNotifyGive(ld_task_handle);
+}
+
+void light_driver_get_status(ld_status_t *status) {
+    int64_t now = esp_timer_get_time();
+
+    status->effect = ld_active_effect;
+    status->stage_time = ld_stage_time;
+    status->max_stage_time = ld_max_stage_time;
+    status->start_skew = ld_start_skew;
+    status->max_start_skew = ld_max_start_skew;
+
+    taskENTER_CRITICAL(&ld_fade_spinlock);
+    bool active = ld_ledc_fade_active;
+    int64_t elapsed = (now - ld_fade_start) / 1000;
+    uint16_t time = ld_fade_time;
+    taskEXIT_CRITICAL(&ld_fade_spinlock);
+
+    if (!active || time == 0 || elapsed >= time) {
+        status->fade_progress = 100;
+        status->fade_remaining = 0;
+    } else {
+        status->fade_progress = elapsed * 100 / time;
+        status->fade_remaining = time - elapsed;
+    }
+}
+
 #define CONFIG_CHAN(PIN, NUM) do { \
-    ledc_channel_config_t chan_##NUM = { \
+    ledc_channel_config_t chan_cfg = { \
         .speed_mode = MY_SPD_MODE, \
-        .channel = LEDC_CHANNEL_##NUM, \
+        .channel = (NUM), \
         .timer_sel = timer, \
         .intr_type = LEDC_INTR_FADE_END, \
         .gpio_num = PIN, \
         .duty = 0, \
-        .hpoint = 0, /* ?? */ \
+        .hpoint = 0, /* (see stagger_hpoints) */ \
         .flags.output_invert = 0, \
     }; \
-    ret = ledc_channel_config(&chan_##NUM); \
+    ret = ledc_channel_config(&chan_cfg); \
     if (ret != ESP_OK) { \
         ESP_LOGE(TAG, "can't config ledc chan %d: %s, abort", NUM, esp_err_to_name(ret)); \
         return ret; \
     } \
-    ret = ledc_cb_register(MY_SPD_MODE, LEDC_CHANNEL_##NUM, &ledc_callbacks, NULL); \
+    ret = ledc_cb_register(MY_SPD_MODE, (NUM), &ledc_callbacks, NULL); \
     if (ret != ESP_OK) { \
         ESP_LOGE(TAG, "can't register ledc fade cb for chan %d: %s, abort", NUM, esp_err_to_name(ret)); \
         return ret; \
@@ -367,11 +1058,54 @@ esp_err_t light_driver_initialize() {
     if (ld_initialized) {
         ESP_LOGW(TAG, "Attempted to initialize light driver more than once");
     } else {
+        ld_calib = calibration_get();
+        if (ld_calib) {
+            // Fixture calibration overrides the compiled-in defaults (gpios only if they
+            // don't clash with the defaults left in place)
+            uint64_t calib_pins = 0;
+            bool clash = false;
+            for (int i = 0; i < (int) NUM_CHANNELS; i++) {
+                int gpio = ld_calib->gpio[i] >= 0 ? ld_calib->gpio[i] : ld_channels[i].gpio;
+                if (gpio >= 0) {
+                    clash |= (calib_pins & (1ULL << gpio)) != 0;
+                    calib_pins |= 1ULL << gpio;
+                }
+            }
+            for (int i = 0; i < (int) NUM_CHANNELS && !clash; i++) {
+                if (ld_calib->gpio[i] >= 0) {
+                    ld_channels[i].gpio = ld_calib->gpio[i];
+                }
+            }
+            if (clash) {
+                ESP_LOGW(TAG, "calibration gpios clash with the channel map, keeping compiled-in gpios");
+            }
+            if (ld_calib->pwm_freq) {
+                ld_default_pwm_freq = ld_calib->pwm_freq;
+            }
+            for (int c = 0; c < CALIB_CHANNELS; c++) {
+                color_model_use(c, ld_calib->color[c].size, ld_calib->color[c].knots, ld_calib->color[c].values);
+            }
+        }
+
+        uint64_t pins = 0;
+        for (int i = 0; i < (int) NUM_CHANNELS; i++) {
+            if (ld_channels[i].gpio < 0) {
+                continue;
+            }
+            pins |= 1ULL << ld_channels[i].gpio;
+            if (ld_channels[i].role != LD_Role_Unused) {
+                ld_active_channels |= 1 << i;
+            }
+        }
+        if (!ld_active_channels) {
+            ESP_LOGE(TAG, "no active channel in the channel map, abort");
+            return ESP_ERR_INVALID_STATE;
+        }
+
         gpio_config_t io_conf = {
             .intr_type = GPIO_INTR_DISABLE,
             .mode = GPIO_MODE_OUTPUT,
-            .pin_bit_mask = 1ULL<<MY_LIGHT_PWM_CH0_GPIO | 1ULL<<MY_LIGHT_PWM_CH1_GPIO | 1ULL<<MY_LIGHT_PWM_CH2_GPIO |
-                1ULL<<MY_LIGHT_PWM_CH3_GPIO | 1ULL<<MY_LIGHT_PWM_CH4_GPIO,
+            .pin_bit_mask = pins, // unused ones stay plain outputs, held low
             .pull_down_en = 1,
             .pull_up_en = 0,
         };
@@ -380,16 +1114,15 @@ esp_err_t light_driver_initialize() {
             ESP_LOGW(TAG, "gpio_config failed with: %s", esp_err_to_name(ret));
         }
 
-        ledc_timer_t timer = LEDC_TIMER_0;
+        ledc_timer_t timer = LEDC_TIMER_0; // (see configure_timer)
 
-        ledc_timer_config_t ledc_timer = {
-            .speed_mode = MY_SPD_MODE,
-            .timer_num = timer,
-            .duty_resolution = MY_DUTY_RES,
-            .freq_hz = 5000, // FIXME: Maybe 1k like Hue?
-            .clk_cfg = LEDC_AUTO_CLK,
-        };
-        ret = ledc_timer_config(&ledc_timer);
+        ret = configure_timer(ld_default_pwm_freq);
+        if (ret != ESP_OK && ld_default_pwm_freq != MY_PWM_FREQ) {
+            ESP_LOGW(TAG, "can't run PWM at calibrated %lu Hz: %s, using %d Hz", ld_default_pwm_freq,
+                    esp_err_to_name(ret), MY_PWM_FREQ);
+            ld_default_pwm_freq = MY_PWM_FREQ;
+            ret = configure_timer(ld_default_pwm_freq);
+        }
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "can't config ledc: %s, abort", esp_err_to_name(ret));
             return ret;
@@ -405,14 +1138,43 @@ esp_err_t light_driver_initialize() {
             .fade_cb = cb_fade_end,
         };
 
-        CONFIG_CHAN(MY_LIGHT_PWM_CH0_GPIO, 0);
-        CONFIG_CHAN(MY_LIGHT_PWM_CH1_GPIO, 1);
-        CONFIG_CHAN(MY_LIGHT_PWM_CH2_GPIO, 2);
-        CONFIG_CHAN(MY_LIGHT_PWM_CH3_GPIO, 3);
-        CONFIG_CHAN(MY_LIGHT_PWM_CH4_GPIO, 4);
+        // Only active channels get ledc (and fade-end interrupts)
+        FOR_ACTIVE_CHANNELS(c) {
+            CONFIG_CHAN(ld_channels[c].gpio, c);
+        }
+        ESP_LOGI(TAG, "%d channel(s), active bitmap 0x%02x", (int) NUM_CHANNELS, ld_active_channels);
+
+        esp_timer_create_args_t timer_args = {
+            .callback = hold_timer_cb,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "light_driver_hold",
+        };
+        ret = esp_timer_create(&timer_args, &ld_hold_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "can't create hold timer: %s, abort", esp_err_to_name(ret));
+            return ret;
+        }
+
+        esp_timer_create_args_t dither_args = {
+            .callback = dither_tick_cb,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "light_driver_dither",
+        };
+        ret = esp_timer_create(&dither_args, &ld_dither_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "can't create dither timer: %s, abort", esp_err_to_name(ret));
+            return ret;
+        }
 
         ld_initialized = true;
+#if STATIC_ALLOCATION
+        static StaticTask_t task;
+        static StackType_t stack[4096];
+        ld_task_handle = xTaskCreateStatic(light_driver_task, "light_driver", sizeof(stack), NULL, 4, stack, &task);
+#else
         xTaskCreate(light_driver_task, "light_driver", 4096, NULL, 4, &ld_task_handle);
+#endif
+        alloc_guard_watch(ld_task_handle);
         ESP_LOGI(TAG, "Initialized");
     }
 
@@ -14,6 +14,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "esp_err.h"
 
 typedef enum ld_effect_type {
@@ -28,17 +30,80 @@ typedef enum ld_effect_type {
 	LD_Effect_DelayedOff1, // no fade (??)
 	LD_Effect_DelayedOff2, // off with effect: 50% dim down in 0.8s, then fade to off in 12s
 	LD_Effect_DyingLight0, // off with effect: 20% dim up in 0.5s, then fade to off in 1s
+	LD_Effect_Custom, // user-uploaded effect program (see effect_programs.h)
 } ld_effect_type;
 
+#define LD_MIN_PWM_FREQ 100 // Hz
+#define LD_MAX_PWM_FREQ 20000 // Hz (still 11 bit duty)
+#define LD_MAX_CHANNELS 5 // ledc channels the driver can use (see MY_LIGHT_CHANNEL_MAP)
+#define LD_TEMPERATURE_FRAC_BITS 4 // fractional mired bits of light_driver_stream_to() temperature
+
+// What an output channel drives (see MY_LIGHT_CHANNEL_MAP)
+typedef enum ld_channel_role {
+	LD_Role_Unused, // no PWM, pin held low
+	LD_Role_Normal, // white ambiance "normal" channel (color model + brightness curve)
+	LD_Role_Cold, // cold white (color model + brightness curve)
+	LD_Role_Warm, // warm white (color model + brightness curve)
+	LD_Role_Dim, // single-channel dimmable (brightness curve only)
+} ld_channel_role;
+
+// Snapshot of what the driver is doing right now
+typedef struct ld_status_s {
+	ld_effect_type effect; // effect in progress (LD_Effect_None if none)
+	uint8_t fade_progress; // progress of the current fade: 0-100 (%), 100 when idle
+	uint16_t fade_remaining; // remaining time of the current fade (ms)
+	uint16_t stage_time; // staging time of the last update (μs; coherent updates: how long one PWM period got stretched)
+	uint16_t max_stage_time; // ... max since boot (μs)
+	uint16_t start_skew; // first to last channel start of the last update (μs; 0 with coherent updates)
+	uint16_t max_start_skew; // ... max since boot (μs)
+} ld_status_t;
+
 // Initialize light driver (keeps all channels off)
 esp_err_t light_driver_initialize();
 
 // Trigger effect
 esp_err_t light_driver_trigger_effect(const ld_effect_type effect);
 
+// Trigger effect program from given slot (LD_Effect_Custom)
+esp_err_t light_driver_trigger_program(uint8_t slot);
+
 // Update channels based on light_config
 esp_err_t light_driver_update();
 
+// Update channels based on light_config, fading over time_ms
+esp_err_t light_driver_update_with_transition(uint16_t time_ms);
+
+// Stream mode: fade straight to level/temperature (light on) over time_ms
+//
+// Temperature is in fractional mireds (mireds << LD_TEMPERATURE_FRAC_BITS),
+// so slow ramps don't step. Overrides light_config and effects until
+// light_driver_stream_end(); meant for short fades at high rate (each cuts
+// the previous one short).
+esp_err_t light_driver_stream_to(uint8_t level, uint16_t temperature, uint16_t time_ms);
+
+// Leave stream mode (fade back to light_config)
+esp_err_t light_driver_stream_end();
+
+// Configure output: PWM frequency (Hz, 0 = default) and temporal dithering
+//
+// Duty resolution follows the frequency (finest the clock allows, up to 16
+// bit). Dithering alternates deep-dim channels between adjacent duty codes
+// while at rest, for extra resolution near off. Running fades and effects are
+// cut short. Returns ESP_ERR_INVALID_ARG on out of range frequency.
+esp_err_t light_driver_set_output(uint16_t pwm_freq, bool dithering);
+
+// Don't start any fade or effect frame before deadline (esp_timer_get_time() μs)
+//
+// Updates and effects triggered in the meantime are queued up and all start
+// at the deadline; used to start fades in sync across many lights.
+esp_err_t light_driver_hold_until(int64_t deadline);
+
+// Drop the hold (if any); whatever got queued up meanwhile starts now
+void light_driver_release_hold();
+
+// Get current driver status (effect, fade progress)
+void light_driver_get_status(ld_status_t *status);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -15,13 +15,24 @@
 #include "zboss_api.h"
 #include "lwip/opt.h"
 
+#include "alloc_guard.h"
+#include "antenna_diversity.h"
+#include "calibration.h"
+#include "effect_programs.h"
+#include "executor.h"
 #include "global_config.h"
+#include "health_monitor.h"
 #include "light_config.h"
 #include "light_driver.h"
 #include "main.h"
+#include "ota.h"
 #include "reset_button.h"
+#include "router_stats.h"
 #include "scenes.h"
 #include "status_indicator.h"
+#include "stream.h"
+#include "sync_clock.h"
+#include "trace.h"
 
 #if !defined CONFIG_ZB_ZCZR
 #error Define ZB_ZCZR in idf.py menuconfig to compile light (Router) source code.
@@ -63,6 +74,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct) {
           esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
         } else {
           ESP_LOGI(TAG, "Device rebooted, joining network 0x%04hx as 0x%04hx", esp_zb_get_pan_id(), esp_zb_get_short_address());
+          ota_mark_running_valid(); // got this far with the network → keep the image
         }
       } else {
         ESP_LOGW(TAG, "Failed to initialize Zigbee stack; status: %s", esp_err_to_name(err_status));
@@ -76,6 +88,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct) {
             extended_pan_id[7], extended_pan_id[6], extended_pan_id[5], extended_pan_id[4],
             extended_pan_id[3], extended_pan_id[2], extended_pan_id[1], extended_pan_id[0],
             esp_zb_get_pan_id(), esp_zb_get_current_channel(), esp_zb_get_short_address());
+        ota_mark_running_valid();
       } else {
         ESP_LOGI(TAG, "No network joined yet (status: %s)", esp_err_to_name(err_status));
         esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb, ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
@@ -139,6 +152,8 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct) {
   } else if (! message->attribute.data.value) { \
     ESP_LOGW(TAG, "%s: unexpectedly no value for %s", cluster, attr); \
   } else
+#define TRACE_ATTR_WRITE(a0, value) \
+  TRACE(attr_write, (a0), message->info.cluster, message->attribute.id, (value))
 
 static ld_effect_type owe_effect = LD_Effect_None;
 
@@ -149,30 +164,30 @@ static esp_err_t onoff_attribute_handler(const esp_zb_zcl_set_attr_value_message
         bool onoff = *(bool *)message->attribute.data.value;
         if (!onoff && owe_effect != LD_Effect_None) {
           light_config_update_with_effect(LCFV_onoff, onoff, owe_effect);
-          ESP_LOGI(TAG, "Light turns off (with effect: %d)", owe_effect);
+          TRACE_ATTR_WRITE(owe_effect, onoff);
           owe_effect = LD_Effect_None;
         } else {
           light_config_update(LCFV_onoff, onoff);
-          ESP_LOGI(TAG, "Light turns %s", onoff ? "on" : "off");
+          TRACE_ATTR_WRITE(0, onoff);
         }
       }
       break;
     case ESP_ZB_ZCL_ATTR_ON_OFF_ON_TIME: // uint16
       IF_ATTR_IS_TYPE_AND_PRESENT("onoff", "on_time", ESP_ZB_ZCL_ATTR_TYPE_U16) {
         // no-op, handled internally by zboss
-        ESP_LOGI(TAG, "On time: %u", *(uint16_t *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, *(uint16_t *)message->attribute.data.value);
       }
       break;
     case ESP_ZB_ZCL_ATTR_ON_OFF_OFF_WAIT_TIME: // uint16
       IF_ATTR_IS_TYPE_AND_PRESENT("onoff", "off_wait_time", ESP_ZB_ZCL_ATTR_TYPE_U16) {
         // no-op, handled internally by zboss
-        ESP_LOGI(TAG, "Off wait time: %u", *(uint16_t *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, *(uint16_t *)message->attribute.data.value);
       }
       break;
     case ESP_ZB_ZCL_ATTR_ON_OFF_START_UP_ON_OFF: // enum8
       IF_ATTR_IS_TYPE_AND_PRESENT("onoff", "startup_onoff", ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM) {
         light_config_update(LCFV_startup_onoff, *(uint8_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Startup onoff: %u", light_config->startup_onoff);
+        TRACE_ATTR_WRITE(0, light_config->startup_onoff);
       }
       break;
     default:
@@ -186,19 +201,19 @@ static esp_err_t level_attribute_handler(const esp_zb_zcl_set_attr_value_message
     case ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID:
       IF_ATTR_IS_TYPE_AND_PRESENT("level", "current_level", ESP_ZB_ZCL_ATTR_TYPE_U8) {
         light_config_update(LCFV_level, *(uint8_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Light level changes to %u", light_config->level);
+        TRACE_ATTR_WRITE(0, light_config->level);
       }
       break;
     case ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_START_UP_CURRENT_LEVEL_ID: // uint8
       IF_ATTR_IS_TYPE_AND_PRESENT("level", "startup_level", ESP_ZB_ZCL_ATTR_TYPE_U8) {
         light_config_update(LCFV_startup_level, *(uint8_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Startup level: %u", light_config->startup_level);
+        TRACE_ATTR_WRITE(0, light_config->startup_level);
       }
       break;
     case ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_OPTIONS_ID: // map8
       IF_ATTR_IS_TYPE_AND_PRESENT("level", "options", ESP_ZB_ZCL_ATTR_TYPE_8BITMAP) {
         light_config_update(LCFV_level_options, *(uint8_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Level options: %x", light_config->level_options);
+        TRACE_ATTR_WRITE(0, light_config->level_options);
       }
       break;
     default:
@@ -212,19 +227,19 @@ static esp_err_t color_attribute_handler(const esp_zb_zcl_set_attr_value_message
     case ESP_ZB_ZCL_ATTR_COLOR_CONTROL_COLOR_TEMPERATURE_ID:
       IF_ATTR_IS_TYPE_AND_PRESENT("color", "temperature", ESP_ZB_ZCL_ATTR_TYPE_U16) {
         light_config_update(LCFV_temperature, *(uint16_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Light temperature change to %u", light_config->temperature);
+        TRACE_ATTR_WRITE(0, light_config->temperature);
       }
       break;
     case ESP_ZB_ZCL_ATTR_COLOR_CONTROL_OPTIONS_ID: // map8
       IF_ATTR_IS_TYPE_AND_PRESENT("color", "options", ESP_ZB_ZCL_ATTR_TYPE_8BITMAP) {
         light_config_update(LCFV_color_options, *(uint8_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Color options: %x", light_config->color_options);
+        TRACE_ATTR_WRITE(0, light_config->color_options);
       }
       break;
     case ESP_ZB_ZCL_ATTR_COLOR_CONTROL_START_UP_COLOR_TEMPERATURE_MIREDS_ID: // uint16
       IF_ATTR_IS_TYPE_AND_PRESENT("level", "startup_temperature", ESP_ZB_ZCL_ATTR_TYPE_U16) {
         light_config_update(LCFV_startup_temperature, *(uint16_t *)message->attribute.data.value);
-        ESP_LOGI(TAG, "Startup temperature: %u", light_config->startup_temperature);
+        TRACE_ATTR_WRITE(0, light_config->startup_temperature);
       }
       break;
     default:
@@ -237,8 +252,26 @@ static esp_err_t basic_attribute_handler(const esp_zb_zcl_set_attr_value_message
   switch (message->attribute.id) {
     case MY_MANUF_ATTR_RF_SWITCH_EXTERNAL:
       IF_ATTR_IS_TYPE_AND_PRESENT("basic", "rf_switch_external", ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
-        ESP_LOGI(TAG, "RF switch change to %s", light_config->rf_switch_external ? "u.fl" : "built-in");
         light_config_update(LCFV_rf_switch_external, *(bool *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, light_config->rf_switch_external);
+      }
+      break;
+    case MY_MANUF_ATTR_RF_SWITCH_AUTO:
+      IF_ATTR_IS_TYPE_AND_PRESENT("basic", "rf_switch_auto", ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
+        light_config_update(LCFV_rf_switch_auto, *(bool *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, light_config->rf_switch_auto);
+      }
+      break;
+    case MY_MANUF_ATTR_PWM_FREQUENCY:
+      IF_ATTR_IS_TYPE_AND_PRESENT("basic", "pwm_frequency", ESP_ZB_ZCL_ATTR_TYPE_U16) {
+        light_config_update(LCFV_pwm_frequency, *(uint16_t *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, light_config->pwm_frequency);
+      }
+      break;
+    case MY_MANUF_ATTR_DITHERING:
+      IF_ATTR_IS_TYPE_AND_PRESENT("basic", "dithering", ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
+        light_config_update(LCFV_dithering, *(bool *)message->attribute.data.value);
+        TRACE_ATTR_WRITE(0, light_config->dithering);
       }
       break;
     default:
@@ -277,7 +310,13 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
   esp_err_t ret = ESP_OK;
   switch (callback_id) {
     case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID:
+      int64_t start = esp_timer_get_time();
       ret = zb_attribute_handler((esp_zb_zcl_set_attr_value_message_t *)message);
+      if (message) {
+        // (how long the zigbee task is held up by an attribute write; flash work is in persist_flush)
+        const esp_zb_zcl_set_attr_value_message_t *m = message;
+        TRACE(attr_handled, 0, m->info.cluster, m->attribute.id, esp_timer_get_time() - start);
+      }
       break;
     case ESP_ZB_CORE_SCENES_STORE_SCENE_CB_ID:
       ret = store_scene((esp_zb_zcl_store_scene_message_t*) message);
@@ -293,6 +332,9 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
       ESP_LOGW(TAG, "CMD default resp; cmd: 0x%x, status: 0x%x, info: [src: 0x%04hx, dst: 0x%04hx, se: %d, de: %d, cl: 0x%04hx, prof: 0x%04hx]", cdr->resp_to_cmd, cdr->status_code, i->src_address.u.short_addr, i->dst_address, i->src_endpoint, i->dst_endpoint, i->cluster, i->profile);
       // XXX: ^^ this will show bullshit src address IF not a short one.
       break;
+    case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
+      ret = ota_upgrade_value_handler((esp_zb_zcl_ota_upgrade_value_message_t *) message);
+      break;
     case ESP_ZB_CORE_IDENTIFY_EFFECT_CB_ID:
       esp_zb_zcl_identify_effect_message_t *ie = (esp_zb_zcl_identify_effect_message_t *) message;
       ESP_LOGI(TAG, "Identify: effect: %02x, variant: %02x", ie->effect_id, ie->effect_variant);
@@ -328,15 +370,200 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
   return ret;
 }
 
-static void delayed_reboot_task(void *pvParameters) {
-  ESP_LOGI(TAG, "Delayed reboot queued...");
-  vTaskDelay(500 / portTICK_PERIOD_MS);
+static void delayed_reboot(void *arg) {
   ESP_LOGI(TAG, "Delayed reboot triggered...");
   while (true) {
     esp_restart();
   }
 }
 
+static ex_timer_t delayed_reboot_timer = EX_TIMER_INIT(delayed_reboot, NULL);
+
+// Respond to manufacturer-specific cmd (reusing its buffer) with same cmd id + payload
+static void send_manuf_specific_response(uint8_t bufid, zb_zcl_parsed_hdr_t *cmd_info, const uint8_t *payload, size_t len) {
+  zb_zcl_parsed_hdr_t hdr = *cmd_info; // lives in the buffer we're about to overwrite
+  uint8_t *ptr = ZB_ZCL_START_PACKET(bufid);
+  ZB_ZCL_CONSTRUCT_SPECIFIC_COMMAND_RES_FRAME_CONTROL_A(ptr, ZB_ZCL_FRAME_DIRECTION_TO_CLI, ZB_TRUE);
+  ZB_ZCL_CONSTRUCT_COMMAND_HEADER_EXT(ptr, hdr.seq_number, ZB_TRUE, MY_MANUF_CODE, hdr.cmd_id);
+  ZB_ZCL_PACKET_PUT_DATA_N(ptr, payload, len);
+  ZB_ZCL_FINISH_PACKET(bufid, ptr);
+  ZB_ZCL_SEND_COMMAND_SHORT(bufid, ZB_ZCL_PARSED_HDR_SHORT_DATA(&hdr).source.u.short_addr,
+      ZB_APS_ADDR_MODE_16_ENDP_PRESENT, ZB_ZCL_PARSED_HDR_SHORT_DATA(&hdr).src_endpoint,
+      ZB_ZCL_PARSED_HDR_SHORT_DATA(&hdr).dst_endpoint, hdr.profile_id, hdr.cluster_id, NULL);
+}
+
+#define MAX_RESPONSE_PAYLOAD 64 // keep responses within a single (unfragmented) frame
+
+typedef ZB_PACKED_PRE struct my_state_s {
+  zb_uint8_t fields; // LC_STATE_* bitmask of the fields to apply
+  zb_uint8_t onoff;
+  zb_uint8_t level;
+  zb_uint16_t temperature; // mireds
+  zb_uint16_t transition; // 1/10 s (like zcl)
+} ZB_PACKED_STRUCT
+my_state_t;
+
+typedef ZB_PACKED_PRE struct my_set_state_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  my_state_t state;
+} ZB_PACKED_STRUCT
+my_set_state_cmd_req_t;
+
+typedef ZB_PACKED_PRE struct my_time_ref_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  zb_uint32_t now; // reference clock (ms)
+} ZB_PACKED_STRUCT
+my_time_ref_cmd_req_t;
+
+typedef ZB_PACKED_PRE struct my_scheduled_start_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  zb_uint32_t start; // when to start, on the reference clock (ms)
+  zb_uint8_t effect; // identify effect to start (ld_effect_type, up to LD_Effect_Stop), 0 = none
+  my_state_t state; // state to fade to (fields = 0 → none)
+} ZB_PACKED_STRUCT
+my_scheduled_start_cmd_req_t;
+
+// Check the state the way apply_state() would, without applying it
+static zb_uint8_t check_state(const my_state_t *state) {
+  if ((state->fields & ~(LC_STATE_ONOFF | LC_STATE_LEVEL | LC_STATE_TEMPERATURE)) || state->onoff > 1) {
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  }
+  if (light_config_check_state(state->fields, state->level, state->temperature) != ESP_OK) {
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+// Apply the full state at once, then reflect it in the zcl attributes (once)
+static zb_uint8_t apply_state(const my_state_t *state) {
+  zb_uint8_t status = check_state(state);
+  if (status != ZB_ZCL_STATUS_SUCCESS) {
+    return status;
+  }
+
+  uint16_t transition = state->transition < UINT16_MAX / 100 ? state->transition : UINT16_MAX / 100; // fade is u16 ms
+  esp_err_t err = light_config_update_state(state->fields, state->onoff, state->level, state->temperature,
+      transition * 100);
+  if (err == ESP_ERR_INVALID_ARG) {
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+
+  if (state->fields & LC_STATE_ONOFF) {
+    esp_zb_zcl_set_attribute_val(MY_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, (void *)&light_config->onoff, false);
+  }
+  if (state->fields & LC_STATE_LEVEL) {
+    esp_zb_zcl_set_attribute_val(MY_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID, (void *)&light_config->level, false);
+  }
+  if (state->fields & LC_STATE_TEMPERATURE) {
+    esp_zb_zcl_set_attribute_val(MY_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        ESP_ZB_ZCL_ATTR_COLOR_CONTROL_COLOR_TEMPERATURE_ID, (void *)&light_config->temperature, false);
+  }
+
+  return err == ESP_OK ? ZB_ZCL_STATUS_SUCCESS : ZB_ZCL_STATUS_FAIL;
+}
+
+typedef ZB_PACKED_PRE struct my_program_upload_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  zb_uint8_t slot;
+  zb_uint8_t program[]; // see effect_programs.h
+} ZB_PACKED_STRUCT
+my_program_upload_cmd_req_t;
+
+typedef ZB_PACKED_PRE struct my_program_delete_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  zb_uint8_t slot;
+} ZB_PACKED_STRUCT
+my_program_delete_cmd_req_t;
+
+typedef ZB_PACKED_PRE struct my_stream_start_cmd_req_s {
+  zb_uint32_t magic; // MY_MANUF_CMD_MAGIC (network order)
+  zb_uint16_t delay; // playout delay (ms), 0 = default
+} ZB_PACKED_STRUCT
+my_stream_start_cmd_req_t;
+
+typedef ZB_PACKED_PRE struct my_stream_sample_cmd_req_s {
+  zb_uint32_t timestamp; // sender clock (ms)
+  zb_uint8_t level;
+  zb_uint16_t temperature; // mireds
+} ZB_PACKED_STRUCT
+my_stream_sample_cmd_req_t;
+
+// Leave streaming; with keep, the last streamed output becomes the light state (and gets saved)
+static zb_uint8_t handle_stream_stop_cmd(bool keep) {
+  my_state_t state = {
+    .fields = LC_STATE_ONOFF | LC_STATE_LEVEL | LC_STATE_TEMPERATURE,
+    .onoff = 1,
+    .transition = 0,
+  };
+
+  esp_err_t err = stream_stop(&state.level, &state.temperature);
+  if (err == ESP_ERR_INVALID_STATE) {
+    return ZB_ZCL_STATUS_FAIL;
+  } else if (err == ESP_OK && keep) {
+    return apply_state(&state);
+  }
+
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+// Map effect_programs errors to zcl status
+static zb_uint8_t effect_program_status(esp_err_t err) {
+  switch (err) {
+    case ESP_OK:
+      return ZB_ZCL_STATUS_SUCCESS;
+    case ESP_ERR_INVALID_SIZE:
+      return ZB_ZCL_STATUS_MALFORMED_CMD;
+    case ESP_ERR_INVALID_ARG:
+    case ESP_ERR_INVALID_RESPONSE:
+      return ZB_ZCL_STATUS_INVALID_VALUE;
+    case ESP_ERR_NOT_FOUND:
+      return ZB_ZCL_STATUS_NOT_FOUND;
+    default:
+      return ZB_ZCL_STATUS_FAIL;
+  }
+}
+
+// Hold the light driver until the (reference clock) start, then queue up state and/or effect
+static zb_uint8_t handle_scheduled_start_cmd(const my_scheduled_start_cmd_req_t *req) {
+  if (ntohl(req->magic) != MY_MANUF_CMD_MAGIC || req->effect > LD_Effect_Stop) {
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  }
+
+  int64_t deadline;
+  esp_err_t err = sync_clock_to_local(req->start, &deadline);
+  if (err == ESP_ERR_INVALID_STATE) {
+    ESP_LOGW(TAG, "Scheduled start without time reference, skip");
+    return ZB_ZCL_STATUS_FAIL;
+  } else if (err != ESP_OK) {
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+
+  // Validate first: a hold armed for a request we then refuse would freeze all other updates
+  zb_uint8_t status = req->state.fields ? check_state(&req->state) : ZB_ZCL_STATUS_SUCCESS;
+  if (status != ZB_ZCL_STATUS_SUCCESS) {
+    return status;
+  }
+
+  if (light_driver_hold_until(deadline) != ESP_OK) {
+    return ZB_ZCL_STATUS_FAIL;
+  }
+
+  if (req->state.fields) {
+    status = apply_state(&req->state);
+  }
+  if (status == ZB_ZCL_STATUS_SUCCESS && req->effect != LD_Effect_None) {
+    status = light_driver_trigger_effect(req->effect) == ESP_OK ? ZB_ZCL_STATUS_SUCCESS : ZB_ZCL_STATUS_FAIL;
+  }
+  if (status != ZB_ZCL_STATUS_SUCCESS) {
+    light_driver_release_hold(); // (nothing to start in sync after all)
+  }
+
+  return status;
+}
+
 static esp_err_t basic_cluster_manuf_specific_cmd_handler(uint8_t bufid, zb_zcl_parsed_hdr_t *cmd_info, const uint8_t *buf, zb_uint_t buflen) {
   // ESP_LOG_BUFFER_HEXDUMP("basic_ms_cmd buf", buf, buflen, ESP_LOG_INFO);
 
@@ -346,7 +573,8 @@ static esp_err_t basic_cluster_manuf_specific_cmd_handler(uint8_t bufid, zb_zcl_
         zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
       } else {
         ESP_LOGW(TAG, "Executing reboot command (delayed)");
-        xTaskCreate(delayed_reboot_task, "delayed_reboot", 4096, NULL, 4, NULL);
+        ESP_LOGI(TAG, "Delayed reboot queued...");
+        executor_schedule(&delayed_reboot_timer, 500);
         zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_SUCCESS);
       }
       break;
@@ -359,6 +587,152 @@ static esp_err_t basic_cluster_manuf_specific_cmd_handler(uint8_t bufid, zb_zcl_
         zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_SUCCESS);
       }
       break;
+    case MY_MANUF_CMD_HEALTH_DUMP:
+      if (buflen > 1) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        uint8_t payload[MAX_RESPONSE_PAYLOAD];
+        size_t len = health_monitor_dump(buflen ? buf[0] : 0, payload, sizeof(payload));
+        send_manuf_specific_response(bufid, cmd_info, payload, len);
+      }
+      break;
+    case MY_MANUF_CMD_TRACE_DUMP:
+      if (buflen != 0 && buflen != 4) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        uint32_t from = 0; // (implicitly) the oldest record
+        if (buflen) {
+          memcpy(&from, buf, sizeof(from)); // little endian, like the rest of zcl
+        }
+        uint8_t payload[MAX_RESPONSE_PAYLOAD];
+        size_t len = trace_dump(from, payload, sizeof(payload));
+        send_manuf_specific_response(bufid, cmd_info, payload, len);
+      }
+      break;
+    case MY_MANUF_CMD_GET_STATE:
+      if (buflen != 0 && buflen != 4) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        uint32_t generation = ~light_config_generation(); // (implicitly) anything but current
+        if (buflen) {
+          memcpy(&generation, buf, sizeof(generation)); // generation caller has already seen
+        }
+        uint8_t payload[MAX_RESPONSE_PAYLOAD];
+        size_t len = light_config_dump_state(generation, payload, sizeof(payload));
+        send_manuf_specific_response(bufid, cmd_info, payload, len);
+      }
+      break;
+    case MY_MANUF_CMD_SET_STATE:
+      if (buflen != sizeof(my_set_state_cmd_req_t)) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        my_set_state_cmd_req_t req;
+        memcpy(&req, buf, sizeof(req));
+        if (ntohl(req.magic) != MY_MANUF_CMD_MAGIC) {
+          zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+        } else {
+          zb_zcl_send_default_handler(bufid, cmd_info, apply_state(&req.state));
+        }
+      }
+      break;
+    case MY_MANUF_CMD_TIME_REF:
+      if (buflen != sizeof(my_time_ref_cmd_req_t)) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        my_time_ref_cmd_req_t req;
+        memcpy(&req, buf, sizeof(req));
+        if (ntohl(req.magic) != MY_MANUF_CMD_MAGIC) {
+          zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+        } else {
+          sync_clock_set_reference(req.now);
+          zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_SUCCESS);
+        }
+      }
+      break;
+    case MY_MANUF_CMD_SCHEDULED_START:
+      if (buflen != sizeof(my_scheduled_start_cmd_req_t)) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        my_scheduled_start_cmd_req_t req;
+        memcpy(&req, buf, sizeof(req));
+        zb_zcl_send_default_handler(bufid, cmd_info, handle_scheduled_start_cmd(&req));
+      }
+      break;
+    case MY_MANUF_CMD_STREAM_START:
+      if (buflen != sizeof(my_stream_start_cmd_req_t)) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        my_stream_start_cmd_req_t req;
+        memcpy(&req, buf, sizeof(req));
+        if (ntohl(req.magic) != MY_MANUF_CMD_MAGIC) {
+          zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+        } else {
+          esp_err_t err = stream_start(req.delay);
+          zb_zcl_send_default_handler(bufid, cmd_info, err == ESP_OK ? ZB_ZCL_STATUS_SUCCESS :
+              (err == ESP_ERR_INVALID_ARG ? ZB_ZCL_STATUS_INVALID_VALUE : ZB_ZCL_STATUS_FAIL));
+        }
+      }
+      break;
+    case MY_MANUF_CMD_STREAM_SAMPLE:
+      if (buflen != sizeof(my_stream_sample_cmd_req_t)) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        my_stream_sample_cmd_req_t req;
+        memcpy(&req, buf, sizeof(req));
+        esp_err_t err = stream_sample(req.timestamp, req.level, req.temperature);
+        if (err == ESP_OK) {
+          zb_buf_free(bufid); // no default response at 25 Hz, whatever the sender asked for (errors still get one)
+        } else {
+          zb_zcl_send_default_handler(bufid, cmd_info,
+              err == ESP_ERR_INVALID_ARG ? ZB_ZCL_STATUS_INVALID_VALUE : ZB_ZCL_STATUS_FAIL);
+        }
+      }
+      break;
+    case MY_MANUF_CMD_STREAM_STOP:
+      if (buflen > 1) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        zb_zcl_send_default_handler(bufid, cmd_info, handle_stream_stop_cmd(buflen && buf[0]));
+      }
+      break;
+    case MY_MANUF_CMD_PROGRAM_UPLOAD:
+      if (buflen <= sizeof(my_program_upload_cmd_req_t) || ntohl(*(uint32_t*)buf) != MY_MANUF_CMD_MAGIC) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        const my_program_upload_cmd_req_t *req = (const my_program_upload_cmd_req_t *)buf;
+        esp_err_t err = effect_programs_store(req->slot, req->program, buflen - sizeof(*req));
+        zb_zcl_send_default_handler(bufid, cmd_info, effect_program_status(err));
+      }
+      break;
+    case MY_MANUF_CMD_PROGRAM_LIST:
+      if (buflen != 0) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        uint8_t payload[MAX_RESPONSE_PAYLOAD];
+        size_t len = effect_programs_list(payload, sizeof(payload));
+        send_manuf_specific_response(bufid, cmd_info, payload, len);
+      }
+      break;
+    case MY_MANUF_CMD_PROGRAM_DELETE:
+      if (buflen != sizeof(my_program_delete_cmd_req_t) || ntohl(*(uint32_t*)buf) != MY_MANUF_CMD_MAGIC) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        const my_program_delete_cmd_req_t *req = (const my_program_delete_cmd_req_t *)buf;
+        zb_zcl_send_default_handler(bufid, cmd_info, effect_program_status(effect_programs_delete(req->slot)));
+      }
+      break;
+    case MY_MANUF_CMD_PROGRAM_TRIGGER:
+      if (buflen != 1) {
+        zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_MALFORMED_CMD);
+      } else {
+        ep_program_t program;
+        esp_err_t err = effect_programs_get(buf[0], &program);
+        if (err == ESP_OK) {
+          err = light_driver_trigger_program(buf[0]);
+        }
+        zb_zcl_send_default_handler(bufid, cmd_info, effect_program_status(err));
+      }
+      break;
     default:
       zb_zcl_send_default_handler(bufid, cmd_info, ZB_ZCL_STATUS_UNSUP_MANUF_CLUST_CMD);
       break;
@@ -483,6 +857,9 @@ static esp_err_t init_flash() {
 }
 
 void app_main(void) {
+  ESP_ERROR_CHECK(executor_initialize());
+  ESP_ERROR_CHECK(health_monitor_initialize());
+  ESP_ERROR_CHECK(router_stats_initialize());
   ESP_ERROR_CHECK(status_indicator_initialize());
   ESP_ERROR_CHECK(reset_button_initialize());
 
@@ -494,8 +871,19 @@ void app_main(void) {
 
   ESP_ERROR_CHECK(init_flash());
   ESP_ERROR_CHECK(esp_zb_platform_config(&config));
+  ESP_ERROR_CHECK(calibration_initialize());
   ESP_ERROR_CHECK(light_driver_initialize());
   ESP_ERROR_CHECK(light_config_initialize());
-
+  ESP_ERROR_CHECK(effect_programs_initialize());
+  ESP_ERROR_CHECK(stream_initialize());
+  ESP_ERROR_CHECK(antenna_diversity_initialize());
+
+#if STATIC_ALLOCATION
+  static StaticTask_t zb_task;
+  static StackType_t zb_stack[4096];
+  xTaskCreateStatic(esp_zb_task, "Zigbee_main", sizeof(zb_stack), NULL, 5, zb_stack, &zb_task);
+#else
   xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
+#endif
+  alloc_guard_arm();
 }
@@ -0,0 +1,240 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_check.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "ha/esp_zigbee_ha_standard.h"
+
+#include "e32z.h"
+#include "global_config.h"
+#include "ota.h"
+
+#define SUB_ELEMENT_HEADER_SIZE 6 // u16 tag, u32 length
+
+static const char *TAG = "OTA";
+
+// Transfer state (only touched from zigbee context)
+static const esp_partition_t *ota_partition = NULL;
+static const esp_partition_t *ota_running = NULL;
+static esp_ota_handle_t ota_handle = 0;
+static bool ota_active = false;
+static uint8_t ota_element_header[SUB_ELEMENT_HEADER_SIZE];
+static uint8_t ota_element_header_len = 0;
+static uint16_t ota_element_tag = 0;
+static uint32_t ota_element_left = 0; // bytes of the current sub-element still to come
+static bool ota_image_seen = false; // got a complete image sub-element
+static uint32_t ota_received = 0;
+static e32z_decoder_t ota_decoder;
+
+void ota_add_cluster(esp_zb_cluster_list_t *cluster_list) {
+    esp_zb_ota_cluster_cfg_t ota_cfg = {
+        .ota_upgrade_file_version = MY_OTA_FILE_VERSION,
+        .ota_upgrade_downloaded_file_ver = ESP_ZB_ZCL_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_DEF_VALUE,
+        .ota_upgrade_manufacturer = MY_MANUF_CODE,
+        .ota_upgrade_image_type = MY_OTA_IMAGE_TYPE,
+    };
+    esp_zb_attribute_list_t *ota_attr = esp_zb_ota_cluster_create(&ota_cfg);
+
+    esp_zb_zcl_ota_upgrade_client_variable_t variable_cfg = {
+        .timer_query = ESP_ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF,
+        .hw_version = MY_OTA_HW_VERSION,
+        .max_data_size = MY_OTA_MAX_DATA_SIZE,
+    };
+    uint16_t server_addr = 0xffff;
+    uint8_t server_ep = 0xff;
+
+    esp_err_t err = esp_zb_ota_cluster_add_attr(ota_attr, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_DATA_ID, &variable_cfg);
+    if (err == ESP_OK) {
+        err = esp_zb_ota_cluster_add_attr(ota_attr, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ADDR_ID, &server_addr);
+    }
+    if (err == ESP_OK) {
+        err = esp_zb_ota_cluster_add_attr(ota_attr, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ENDPOINT_ID, &server_ep);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add ota client attrs: %s", esp_err_to_name(err));
+    }
+
+    esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_attr, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+}
+
+static esp_err_t write_cb(const uint8_t *data, size_t len, void *ctx) {
+    return esp_ota_write(ota_handle, data, len);
+}
+
+static esp_err_t read_base_cb(uint32_t offset, uint8_t *data, size_t len, void *ctx) {
+    if (offset + len > ota_running->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_partition_read(ota_running, offset, data, len);
+}
+
+static void abort_transfer() {
+    if (ota_active) {
+        esp_ota_abort(ota_handle);
+        ota_active = false;
+    }
+}
+
+static esp_err_t begin_transfer() {
+    abort_transfer(); // previous one, if any
+
+    ota_running = esp_ota_get_running_partition();
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    if (!ota_partition) {
+        ESP_LOGW(TAG, "no partition to update to");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = esp_ota_begin(ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "can't begin ota: %s", esp_err_to_name(ret));
+
+    ota_active = true;
+    ota_element_header_len = 0;
+    ota_element_left = 0;
+    ota_image_seen = false;
+    ota_received = 0;
+    ESP_LOGI(TAG, "Upgrade started, writing to %s", ota_partition->label);
+
+    return ESP_OK;
+}
+
+// Feed sub-element stream (tag, length, data; repeated)
+static esp_err_t receive(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (ota_element_left == 0) {
+            // (rest of) sub-element header
+            size_t n = SUB_ELEMENT_HEADER_SIZE - ota_element_header_len;
+            n = n < len ? n : len;
+            memcpy(ota_element_header + ota_element_header_len, data, n);
+            ota_element_header_len += n;
+            data += n;
+            len -= n;
+            if (ota_element_header_len < SUB_ELEMENT_HEADER_SIZE) {
+                break;
+            }
+
+            ota_element_header_len = 0;
+            memcpy(&ota_element_tag, ota_element_header, sizeof(ota_element_tag));
+            memcpy(&ota_element_left, ota_element_header + 2, sizeof(ota_element_left));
+            ESP_LOGI(TAG, "sub-element 0x%04x, %lu bytes", ota_element_tag, ota_element_left);
+
+            if (ota_element_tag == OTA_TAG_RAW_IMAGE || ota_element_tag == OTA_TAG_E32Z_IMAGE) {
+                if (ota_image_seen) {
+                    ESP_LOGW(TAG, "more than one image sub-element");
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                if (ota_element_tag == OTA_TAG_E32Z_IMAGE) {
+                    e32z_init(&ota_decoder, write_cb, read_base_cb, esp_app_get_description()->app_elf_sha256, NULL);
+                }
+            }
+            if (ota_element_left == 0) {
+                continue; // empty element
+            }
+        }
+
+        size_t n = ota_element_left < len ? ota_element_left : len;
+        switch (ota_element_tag) {
+            case OTA_TAG_RAW_IMAGE:
+                ESP_RETURN_ON_ERROR(esp_ota_write(ota_handle, data, n), TAG, "write");
+                break;
+            case OTA_TAG_E32Z_IMAGE:
+                ESP_RETURN_ON_ERROR(e32z_feed(&ota_decoder, data, n), TAG, "decompress");
+                break;
+            default:
+                break; // not for us (signature, certificate, ...), skip
+        }
+        data += n;
+        len -= n;
+        ota_element_left -= n;
+
+        if (ota_element_left == 0 && ota_element_tag == OTA_TAG_E32Z_IMAGE) {
+            ESP_RETURN_ON_ERROR(e32z_finish(&ota_decoder), TAG, "decompress finish");
+        }
+        if (ota_element_left == 0 && (ota_element_tag == OTA_TAG_RAW_IMAGE || ota_element_tag == OTA_TAG_E32Z_IMAGE)) {
+            ota_image_seen = true;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_upgrade_value_handler(const esp_zb_zcl_ota_upgrade_value_message_t *message) {
+    esp_err_t ret = ESP_OK;
+
+    if (message->info.status != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        ESP_LOGW(TAG, "ota message with error status: %d", message->info.status);
+        abort_transfer();
+        return ESP_FAIL;
+    }
+
+    switch (message->upgrade_status) {
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_START:
+            ESP_LOGI(TAG, "Upgrade to file version 0x%08lx (%lu bytes) offered",
+                    message->ota_header.file_version, message->ota_header.image_size);
+            ret = begin_transfer();
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+            if (!ota_active) {
+                ret = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            ota_received += message->payload_size;
+            ret = receive(message->payload, message->payload_size);
+            if (ret != ESP_OK) {
+                abort_transfer();
+            }
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
+            ESP_LOGI(TAG, "Applying upgrade");
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+            ret = (ota_active && ota_image_seen && ota_element_left == 0) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+            ESP_LOGI(TAG, "Upgrade check: %s (%lu bytes received)", esp_err_to_name(ret), ota_received);
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+            ota_active = false;
+            ret = esp_ota_end(ota_handle); // validates the image
+            if (ret == ESP_OK) {
+                ret = esp_ota_set_boot_partition(ota_partition);
+            }
+            if (ret == ESP_OK) {
+                ESP_LOGW(TAG, "Upgrade finished, rebooting");
+                esp_restart();
+            } else {
+                ESP_LOGW(TAG, "can't finish upgrade: %s", esp_err_to_name(ret));
+            }
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR:
+            ESP_LOGW(TAG, "Upgrade aborted (%d)", message->upgrade_status);
+            abort_transfer();
+            break;
+        default:
+            ESP_LOGI(TAG, "Upgrade status: %d", message->upgrade_status);
+            break;
+    }
+
+    return ret;
+}
+
+void ota_mark_running_valid() {
+    esp_ota_img_states_t state;
+
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+            state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Upgraded image marked valid");
+        } else {
+            ESP_LOGW(TAG, "can't mark image valid: %s", esp_err_to_name(err));
+        }
+    }
+}
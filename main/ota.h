@@ -0,0 +1,35 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: OTA upgrade over the zigbee OTA Upgrade cluster (client), writing
+ * raw or E32Z compressed/delta images (see e32z.h) straight into the
+ * inactive app slot.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+#define OTA_TAG_RAW_IMAGE 0x0000 // sub-element: plain esp32 app image
+#define OTA_TAG_E32Z_IMAGE 0xf000 // sub-element: E32Z compressed (delta) app image
+
+// Add OTA Upgrade client cluster to the cluster list
+void ota_add_cluster(esp_zb_cluster_list_t *cluster_list);
+
+// Handle ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID (from zigbee context)
+esp_err_t ota_upgrade_value_handler(const esp_zb_zcl_ota_upgrade_value_message_t *message);
+
+// Confirm that the running (freshly upgraded) image works, cancelling rollback
+void ota_mark_running_valid();
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,42 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Where in the PWM period each channel turns on (its ledc hpoint),
+ * so the channels' on-times don't all start at the same edge. Pure, so the
+ * host tests can model the supply current.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Spread the on-times of channels (bitmap) across the period: each channel
+// turns on where the previous one turns off, so the summed supply current
+// peaks at fewer channels than with all of them on at the same edge.
+//
+// Never wraps: ledc turns a channel off at hpoint + duty within the period,
+// so an on-time running past the period end isn't cut short where it should
+// be. Hence a channel is moved back as far as needed to fit its span, i.e.
+// the largest duty it has during the coming fade (max of current and target).
+static inline void pwm_stagger(uint32_t period, uint8_t channels, const uint32_t *duties,
+        const uint32_t *spans, uint32_t *hpoints) {
+    uint32_t next = 0;
+    for (int c = 0; channels >> c; c++) {
+        if (channels & (1 << c)) {
+            uint32_t span = spans[c] ? spans[c] : 1; // (hpoint < period)
+            hpoints[c] = next + span <= period ? next : period - span;
+            next = hpoints[c] + duties[c];
+        }
+    }
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -8,73 +8,111 @@
 #include "esp_check.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "soc/soc_caps.h"
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER || SOC_GPIO_FLEX_GLITCH_FILTER_NUM
+#include "driver/gpio_filter.h"
+#endif
 
+#include "alloc_guard.h"
+#include "executor.h"
 #include "global_config.h"
 #include "indicator_led.h"
 #include "light_config.h"
 #include "reset_button.h"
+#include "reset_button_fsm.h"
 
-#define DEBOUNCE_DELAY_US 50 * 1000 // ms in μs
-#define LONG_PRESS_DELAY_US 5 * 1000 * 1000 // s in μs
-#define SUSPEND_MS 250
+#define GLITCH_WINDOW_NS 750 // hw filter: pulses shorter than this never reach the isr
 
 static const char *TAG = "RESET_BUTTON";
-static TaskHandle_t rb_task_handle;
 volatile static bool rb_initialized = false;
-volatile static uint64_t press_time = 0;
+volatile static bool rb_edge_pending = false; // isr → executor handoff (one post per storm)
+static rb_button_t rb_button = RB_BUTTON_INIT; // debounce + state machine (executor only)
 
-static void IRAM_ATTR gpio_isr_handler(void* arg) {
-    uint32_t gpio_state = gpio_get_level(RESET_BUTTON_GPIO);
-
-    if (gpio_state == 1) { // Pulled up → released
-        if (!press_time || esp_timer_get_time() - press_time < DEBOUNCE_DELAY_US) {
-            // ignore (not pressed, or bouncing)
-        } else {
-            // release
-            press_time = 0;
-        }
-    } else { // Shorted to gnd → pressed
-        if (press_time == 0) {
-            // record press
-            press_time = esp_timer_get_time();
-            vTaskNotifyGiveFromISR(rb_task_handle, NULL);
+static void debounce_done(void *arg);
+static void deadline_hit(void *arg);
+static ex_timer_t rb_debounce_timer = EX_TIMER_INIT(debounce_done, NULL);
+static ex_timer_t rb_deadline_timer = EX_TIMER_INIT(deadline_hit, NULL);
 
-        }
+static int64_t now_ms() {
+    return esp_timer_get_time() / 1000;
+}
+
+static void apply(rb_action action) {
+    switch (action) {
+        case RB_Arm:
+            ESP_LOGI(TAG, "pressed; keep going...");
+            executor_schedule(&rb_deadline_timer, rb_button.deadline - now_ms());
+            indicator_led_lock(IS_reset_pending);
+            break;
+        case RB_Abort:
+            ESP_LOGI(TAG, "abort");
+            executor_cancel(&rb_deadline_timer);
+            indicator_led_unlock();
+            break;
+        case RB_FactoryReset:
+            ESP_LOGI(TAG, "long press -- factory resetting...");
+            light_config_erase_flash(); // erase all config from flash...
+            light_config_flush(); // ... before the reset reboots us
+            alloc_guard_allow_begin(); // (erases the zigbee nvs; we're going down anyway)
+            esp_zb_factory_reset();
+            break;
+        case RB_None:
+            break;
     }
+}
+
+// Executor handler: the debounce window (may have) passed; sample the level
+static void debounce_done(void *arg) {
+    bool pressed = gpio_get_level(RESET_BUTTON_GPIO) == 0; // shorted to gnd → pressed
 
+    apply(rb_settle(&rb_button, now_ms(), pressed));
 }
 
-static void reset_button_task(void *pvParameters) {
-    bool locked = false;
-    xTaskNotifyWait(0, 0, NULL, portMAX_DELAY); // block immediately ;)
-    while (true) {
-        if (press_time > 0) {
-            if (esp_timer_get_time() - press_time < LONG_PRESS_DELAY_US) {
-                ESP_LOGI(TAG, "pressed; keep going...");
-                if (!locked) {
-                    indicator_led_lock(IS_reset_pending);
-                    locked = true;
-                }
-                xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(SUSPEND_MS));
-            } else {
-                ESP_LOGI(TAG, "long press -- factory resetting...");
-                light_config_erase_flash(); // erase all config from flash
-                esp_zb_factory_reset();
-                xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
-            }
-
-        } else {
-            ESP_LOGI(TAG, "abort");
-            if (locked) {
-                indicator_led_unlock();
-                locked = false;
-            }
-            xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+// Executor handler: held for RB_LONG_PRESS_MS
+static void deadline_hit(void *arg) {
+    apply(rb_deadline(&rb_button, now_ms()));
+}
+
+// Executor handler: edge(s) seen; (re)start the debounce window
+static void edge_seen(void *arg) {
+    rb_edge_pending = false;
+    int64_t now = now_ms();
+    executor_schedule(&rb_debounce_timer, rb_edge(&rb_button, now) - now);
+}
+
+static void IRAM_ATTR gpio_isr_handler(void* arg) {
+    // Bounce storm → only the first edge posts; later ones just push the window out
+    if (!rb_edge_pending) {
+        rb_edge_pending = true;
+        if (executor_post_from_isr(edge_seen, NULL) != ESP_OK) {
+            rb_edge_pending = false; // queue full; next edge retries
         }
     }
 }
 
+// Hardware glitch filter on the button pin (drops EMI spikes, not mechanical bounce)
+static esp_err_t enable_glitch_filter() {
+    gpio_glitch_filter_handle_t filter = NULL;
+#if SOC_GPIO_FLEX_GLITCH_FILTER_NUM
+    gpio_flex_glitch_filter_config_t config = {
+        .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
+        .gpio_num = RESET_BUTTON_GPIO,
+        .window_width_ns = GLITCH_WINDOW_NS,
+        .window_thres_ns = GLITCH_WINDOW_NS,
+    };
+    ESP_RETURN_ON_ERROR(gpio_new_flex_glitch_filter(&config, &filter), TAG, "can't create glitch filter");
+#elif SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+    gpio_pin_glitch_filter_config_t config = {
+        .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
+        .gpio_num = RESET_BUTTON_GPIO,
+    };
+    ESP_RETURN_ON_ERROR(gpio_new_pin_glitch_filter(&config, &filter), TAG, "can't create glitch filter");
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+    return gpio_glitch_filter_enable(filter);
+}
+
 esp_err_t reset_button_initialize() {
     esp_err_t ret = ESP_OK;
 
@@ -92,6 +130,11 @@ esp_err_t reset_button_initialize() {
             return ret;
         }
 
+        ret = enable_glitch_filter();
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "no glitch filter (%s), software debounce only", esp_err_to_name(ret));
+        }
+
         ret = gpio_install_isr_service(0);
         if (ret != ESP_OK) {
             ESP_LOGW(TAG, "can't install the isr service: %s", esp_err_to_name(ret));
@@ -103,8 +146,10 @@ esp_err_t reset_button_initialize() {
             return ret;
         }
 
+        // Held at boot → no edge; pick it up anyway
+        executor_post(edge_seen, NULL);
+
         rb_initialized = true;
-        xTaskCreate(reset_button_task, "reset_button", 4096, NULL, 0, &rb_task_handle);
         ESP_LOGI(TAG, "Initialized");
     }
 
@@ -5,7 +5,8 @@
  * This code is licensed under GPL version 3.
  *
  * Purpose: Handles the factory reset button. Shorting it to GND for 5+ seconds
- * will trigger factory reset.
+ * will trigger factory reset -- also when held (or shorted) at boot. The
+ * debounce and state machine live in reset_button_fsm.
  */
 
 #pragma once
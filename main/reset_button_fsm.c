@@ -0,0 +1,60 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "reset_button_fsm.h"
+
+typedef enum {
+    RB_Press,
+    RB_Release,
+    RB_Deadline,
+} rb_event;
+
+static rb_action rb_step(rb_state *state, rb_event event) {
+    switch (*state) {
+        case RB_Idle:
+            if (event == RB_Press) {
+                *state = RB_Held;
+                return RB_Arm;
+            }
+            break;
+        case RB_Held:
+            if (event == RB_Release) {
+                *state = RB_Idle;
+                return RB_Abort;
+            } else if (event == RB_Deadline) {
+                *state = RB_Resetting;
+                return RB_FactoryReset;
+            }
+            break;
+        case RB_Resetting:
+            break;
+    }
+    return RB_None; // (repeated press/release, stale deadline)
+}
+
+int64_t rb_edge(rb_button_t *b, int64_t now) {
+    b->last_edge = now;
+    return now + RB_DEBOUNCE_MS;
+}
+
+rb_action rb_settle(rb_button_t *b, int64_t now, bool pressed) {
+    if (now - b->last_edge < RB_DEBOUNCE_MS || pressed == b->pressed) {
+        return RB_None; // still bouncing (another sample is due), or nothing new
+    }
+    b->pressed = pressed;
+    rb_action action = rb_step(&b->state, pressed ? RB_Press : RB_Release);
+    if (action == RB_Arm) {
+        b->deadline = now + RB_LONG_PRESS_MS;
+    }
+    return action;
+}
+
+rb_action rb_deadline(rb_button_t *b, int64_t now) {
+    if (b->state != RB_Held || now < b->deadline) {
+        return RB_None; // (released meanwhile, or a stale timer)
+    }
+    return rb_step(&b->state, RB_Deadline);
+}
@@ -0,0 +1,60 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Reset button logic -- debounce and the long press state machine
+ * -- as pure step functions (no I/O, time passed in), so the host tests can
+ * throw bounce storms at it. reset_button.c wires it to the isr and timers.
+ *
+ * Idle --press--> Held (arm deadline) --release--> Idle (abort)
+ *                 Held --deadline--> Resetting (terminal)
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RB_DEBOUNCE_MS 50 // level must hold this long (after the last edge) to count
+#define RB_LONG_PRESS_MS 5000
+
+typedef enum {
+    RB_Idle,
+    RB_Held,
+    RB_Resetting,
+} rb_state;
+
+typedef enum {
+    RB_None,
+    RB_Arm, // arm the long press deadline (at deadline), signal pending reset
+    RB_Abort, // disarm the deadline, stop signalling
+    RB_FactoryReset,
+} rb_action;
+
+typedef struct {
+    rb_state state;
+    bool pressed; // last debounced level
+    int64_t last_edge; // ms; last raw edge seen
+    int64_t deadline; // ms; when a press turns into a factory reset (if Held)
+} rb_button_t;
+
+#define RB_BUTTON_INIT { .state = RB_Idle, .pressed = false, .last_edge = INT64_MIN / 2, .deadline = 0 }
+
+// Raw edge at now (ms); returns when to sample the level (rb_settle)
+int64_t rb_edge(rb_button_t *b, int64_t now);
+
+// Level sampled at now (ms): counts once it held RB_DEBOUNCE_MS since the last edge
+rb_action rb_settle(rb_button_t *b, int64_t now, bool pressed);
+
+// Deadline check at now (ms): RB_FactoryReset once held for RB_LONG_PRESS_MS
+rb_action rb_deadline(rb_button_t *b, int64_t now);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
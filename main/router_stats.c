@@ -0,0 +1,255 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "esp_check.h"
+#include "ha/esp_zigbee_ha_standard.h"
+#include "zboss_api.h"
+
+#include "executor.h"
+#include "global_config.h"
+#include "router_stats.h"
+
+#define SAMPLE_EVERY_MS (60 * 1000)
+#define WINDOW 60 // samples kept for min/avg/max (→ 1 hour)
+
+static const char *TAG = "ROUTER_STATS";
+volatile static bool rs_initialized = false;
+
+static void router_stats_sample(void *arg);
+static ex_timer_t rs_timer = EX_TIMER_INIT(router_stats_sample, NULL);
+
+// Link quality history (only touched under zigbee lock / from zigbee task)
+typedef struct {
+    int16_t samples[WINDOW];
+    uint8_t num;
+    uint8_t next;
+} rs_window;
+
+typedef struct {
+    int16_t min;
+    int16_t avg;
+    int16_t max;
+} rs_window_stats;
+
+static rs_window rs_parent_lqi;
+static rs_window rs_parent_rssi;
+static rs_window rs_neighbor_lqi; // average lqi of all neighbors
+
+static void window_add(rs_window *w, int16_t val) {
+    w->samples[w->next] = val;
+    w->next = (w->next + 1) % WINDOW;
+    if (w->num < WINDOW) {
+        w->num++;
+    }
+}
+
+static rs_window_stats window_stats(const rs_window *w) {
+    rs_window_stats s = {0, 0, 0};
+    int32_t sum = 0;
+
+    for (uint8_t i = 0; i < w->num; i++) {
+        if (i == 0 || w->samples[i] < s.min) {
+            s.min = w->samples[i];
+        }
+        if (i == 0 || w->samples[i] > s.max) {
+            s.max = w->samples[i];
+        }
+        sum += w->samples[i];
+    }
+    if (w->num) {
+        s.avg = sum / w->num;
+    }
+
+    return s;
+}
+
+#define SET_ATTR(attr, val) esp_zb_zcl_set_manufacturer_attribute_val(MY_LIGHT_ENDPOINT, \
+        ESP_ZB_ZCL_CLUSTER_ID_BASIC, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, MY_MANUF_CODE, attr, &val, false)
+
+// Runs in zigbee context (scheduled from the sampler)
+static void diagnostics_cb(zb_uint8_t bufid) {
+    zdo_diagnostics_full_stats_t *stats = (zdo_diagnostics_full_stats_t *)zb_buf_begin(bufid);
+
+    if (stats->status == RET_OK) {
+        uint32_t mac_tx = stats->mac_stats.mac_tx_ucast_total;
+        uint32_t mac_retries = stats->mac_stats.mac_tx_ucast_retries;
+        uint32_t mac_failures = stats->mac_stats.mac_tx_ucast_failures;
+        uint32_t aps_retries = stats->zdo_stats.aps_tx_ucast_retry;
+        // Unicasts we sent on MAC level, but didn't originate on APS level → relayed (estimate)
+        uint32_t aps_tx = stats->zdo_stats.aps_tx_ucast_success + stats->zdo_stats.aps_tx_ucast_fail;
+        uint32_t relayed = mac_tx > aps_tx ? mac_tx - aps_tx : 0;
+
+        SET_ATTR(MY_MANUF_ATTR_ROUTER_RELAYED, relayed);
+        SET_ATTR(MY_MANUF_ATTR_ROUTER_MAC_TX, mac_tx);
+        SET_ATTR(MY_MANUF_ATTR_ROUTER_MAC_RETRIES, mac_retries);
+        SET_ATTR(MY_MANUF_ATTR_ROUTER_MAC_FAILURES, mac_failures);
+        SET_ATTR(MY_MANUF_ATTR_ROUTER_APS_RETRIES, aps_retries);
+    } else {
+        ESP_LOGW(TAG, "diagnostics failed: %d", stats->status);
+    }
+
+    zb_buf_free(bufid);
+}
+
+// How likely neighbor is our parent: 2 = parent, 1 = coordinator, 0 = router, -1 = not at all
+static int8_t rank_as_parent(const esp_zb_nwk_neighbor_info_t *neighbor) {
+    if (neighbor->relationship == ESP_ZB_NWK_RELATIONSHIP_PARENT) {
+        return 2;
+    } else if (neighbor->relationship == ESP_ZB_NWK_RELATIONSHIP_CHILD) {
+        return -1;
+    } else if (neighbor->device_type == ESP_ZB_DEVICE_TYPE_COORDINATOR) {
+        return 1;
+    } else if (neighbor->device_type == ESP_ZB_DEVICE_TYPE_ROUTER) {
+        return 0;
+    }
+    return -1;
+}
+
+// Must hold zigbee lock
+static void sample_neighbors() {
+    esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+    esp_zb_nwk_neighbor_info_t neighbor = {};
+    uint8_t children = 0;
+    uint8_t neighbors = 0;
+    uint16_t lqi_sum = 0;
+    int8_t parent_rank = -1; // 2 = parent, 1 = coordinator, 0 = best lqi router
+    uint8_t parent_lqi = 0;
+    int8_t parent_rssi = 0;
+
+    while (ESP_OK == esp_zb_nwk_get_next_neighbor(&it, &neighbor)) {
+        neighbors++;
+        lqi_sum += neighbor.lqi;
+
+        if (neighbor.relationship == ESP_ZB_NWK_RELATIONSHIP_CHILD) {
+            children++;
+        }
+        int8_t rank = rank_as_parent(&neighbor);
+        if (rank > parent_rank || (rank == parent_rank && rank >= 0 && neighbor.lqi > parent_lqi)) {
+            parent_rank = rank;
+            parent_lqi = neighbor.lqi;
+            parent_rssi = neighbor.rssi;
+        }
+    }
+
+    if (parent_rank >= 0) {
+        window_add(&rs_parent_lqi, parent_lqi);
+        window_add(&rs_parent_rssi, parent_rssi);
+    }
+    if (neighbors) {
+        window_add(&rs_neighbor_lqi, lqi_sum / neighbors);
+    }
+
+    rs_window_stats plqi = window_stats(&rs_parent_lqi);
+    rs_window_stats prssi = window_stats(&rs_parent_rssi);
+    rs_window_stats nlqi = window_stats(&rs_neighbor_lqi);
+    uint8_t u8;
+    int8_t s8;
+
+    SET_ATTR(MY_MANUF_ATTR_ROUTER_CHILDREN, children);
+    SET_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBORS, neighbors);
+#define SET_WINDOW_ATTR(attr, var, val) do { var = (val); SET_ATTR(attr, var); } while (0)
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_MIN, u8, plqi.min);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_AVG, u8, plqi.avg);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_MAX, u8, plqi.max);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MIN, s8, prssi.min);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_AVG, s8, prssi.avg);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MAX, s8, prssi.max);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MIN, u8, nlqi.min);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_AVG, u8, nlqi.avg);
+    SET_WINDOW_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MAX, u8, nlqi.max);
+#undef SET_WINDOW_ATTR
+}
+
+#undef SET_ATTR
+
+bool router_stats_parent_link(uint16_t *short_addr, uint8_t *lqi, int8_t *rssi) {
+    esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+    esp_zb_nwk_neighbor_info_t neighbor = {};
+    int8_t best_rank = -1;
+
+    while (ESP_OK == esp_zb_nwk_get_next_neighbor(&it, &neighbor)) {
+        int8_t rank = rank_as_parent(&neighbor);
+        if (rank > best_rank || (rank == best_rank && rank >= 0 && neighbor.lqi > *lqi)) {
+            best_rank = rank;
+            *short_addr = neighbor.short_addr;
+            *lqi = neighbor.lqi;
+            *rssi = neighbor.rssi;
+        }
+    }
+
+    return best_rank >= 0;
+}
+
+// Executor handler: every SAMPLE_EVERY_MS
+static void router_stats_sample(void *arg) {
+    executor_schedule(&rs_timer, SAMPLE_EVERY_MS);
+
+    if (!esp_zb_is_started() || !esp_zb_bdb_dev_joined()) {
+        return; // nothing to measure (yet)
+    }
+
+    if (!esp_zb_lock_acquire(pdMS_TO_TICKS(50))) {
+        ESP_LOGD(TAG, "zigbee busy, skipping sample");
+        return;
+    }
+
+    sample_neighbors();
+    zb_ret_t ret = zdo_diagnostics_get_stats(diagnostics_cb, ZB_PIB_ATTRIBUTE_IEEE_DIAGNOSTIC_INFO);
+    if (ret != RET_OK) {
+        ESP_LOGW(TAG, "can't request diagnostics: %d", ret);
+    }
+
+    esp_zb_lock_release();
+}
+
+void router_stats_add_attrs(esp_zb_attribute_list_t *basic_attr) {
+    uint32_t zero32 = 0;
+    uint8_t zero8 = 0;
+    int8_t zeros8 = 0;
+
+#define ADD_ATTR(attr, type, val) do { \
+    esp_err_t err = esp_zb_cluster_add_manufacturer_attr(basic_attr, \
+            basic_attr->next->cluster_id, \
+            attr, MY_MANUF_CODE, type, \
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_MANUF_SPEC, \
+            &val); \
+    if (err != ESP_OK) { \
+        ESP_LOGW(TAG, "Failed to add %s manuf attr: %s", #attr, esp_err_to_name(err)); \
+    } \
+} while (0)
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_RELAYED, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_MAC_TX, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_MAC_RETRIES, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_MAC_FAILURES, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_APS_RETRIES, ESP_ZB_ZCL_ATTR_TYPE_U32, zero32);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_CHILDREN, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBORS, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_MIN, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_AVG, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_LQI_MAX, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MIN, ESP_ZB_ZCL_ATTR_TYPE_S8, zeros8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_AVG, ESP_ZB_ZCL_ATTR_TYPE_S8, zeros8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_PARENT_RSSI_MAX, ESP_ZB_ZCL_ATTR_TYPE_S8, zeros8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MIN, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_AVG, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+    ADD_ATTR(MY_MANUF_ATTR_ROUTER_NEIGHBOR_LQI_MAX, ESP_ZB_ZCL_ATTR_TYPE_U8, zero8);
+#undef ADD_ATTR
+}
+
+esp_err_t router_stats_initialize() {
+    esp_err_t ret = ESP_OK;
+
+    if (rs_initialized) {
+        ESP_LOGW(TAG, "Attempted to initialize router stats more than once");
+    } else {
+        executor_schedule(&rs_timer, SAMPLE_EVERY_MS);
+
+        rs_initialized = true;
+        ESP_LOGI(TAG, "Initialized");
+    }
+
+    return ret;
+}
@@ -0,0 +1,38 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Collects router statistics (relayed frames, retries, child table
+ * occupancy, parent/neighbor link quality windows) off the zigbee hot path,
+ * and publishes them as manufacturer-specific attributes.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+// Initialize router stats (starts the periodic sampler)
+esp_err_t router_stats_initialize();
+
+// Add router stats manufacturer-specific attributes to the basic cluster
+void router_stats_add_attrs(esp_zb_attribute_list_t *basic_attr);
+
+// Link to the parent (else the coordinator, else the best lqi router), as
+// the neighbor table has it; must hold zigbee lock
+//
+// Returns false (and leaves the outputs untouched) if there's no such neighbor.
+bool router_stats_parent_link(uint16_t *short_addr, uint8_t *lqi, int8_t *rssi);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
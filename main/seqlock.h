@@ -0,0 +1,56 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Sequence lock primitives (one writer, any number of readers that
+ * copy and retry), split out of light_config.c so the host tests can race
+ * them between threads.
+ *
+ * The sequence is even while the data is stable and odd during a write:
+ * a copy is good if the sequence was even before it and unchanged after.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Start a write (sequence → odd; readers retry)
+static inline void seqlock_write_begin(volatile uint32_t *seq) {
+    (*seq)++;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+// Done with a write (sequence → even); no-op unless in a write
+static inline void seqlock_write_end(volatile uint32_t *seq) {
+    if (*seq & 1) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        (*seq)++;
+    }
+}
+
+// Before copying: false if a write is in progress (don't bother copying)
+static inline bool seqlock_read_begin(const volatile uint32_t *seq, uint32_t *generation) {
+    *generation = *seq;
+    if (*generation & 1) {
+        return false;
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return true;
+}
+
+// After copying: true if no write ran meanwhile (the copy isn't torn)
+static inline bool seqlock_read_valid(const volatile uint32_t *seq, uint32_t generation) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return *seq == generation;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
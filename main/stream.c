@@ -0,0 +1,292 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "delayed_save.h"
+#include "global_config.h"
+#include "light_driver.h"
+#include "stream.h"
+#include "trace.h"
+
+#define BUFFER_SIZE 8 // samples in the jitter buffer
+#define MAX_EXTRAPOLATE 200 // ms; conceal at most this much loss, then hold
+#define REANCHOR_AFTER 3 // consecutive late samples → restart playout clock
+
+static const char *TAG = "STREAM";
+volatile static bool st_initialized = false;
+static esp_timer_handle_t st_timer;
+
+typedef struct {
+    int64_t at; // local playout time (μs)
+    uint8_t level;
+    uint16_t temperature; // fractional mireds (<< LD_TEMPERATURE_FRAC_BITS), interpolated as such
+} st_sample;
+
+static portMUX_TYPE st_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static bool st_active = false;
+static int64_t st_delay = 0; // playout delay (μs)
+static bool st_anchored = false; // playout clock valid
+static uint32_t st_base_ts = 0; // sender timestamp (ms)...
+static int64_t st_base_local = 0; // ... and when to play it (μs)
+static st_sample st_buffer[BUFFER_SIZE]; // pending samples, sorted by .at
+static uint8_t st_count = 0;
+static st_sample st_prev; // last sample reached by playout (interpolation start)
+static st_sample st_prev2; // the one before (for extrapolation)
+static uint8_t st_have_prev = 0; // how many of st_prev, st_prev2 are valid
+static int64_t st_last_rx = 0; // local time of the last sample received (μs)
+static uint8_t st_late_run = 0; // consecutive late samples
+static bool st_output_valid = false; // anything output yet
+static uint8_t st_out_level = 0;
+static uint16_t st_out_temperature = 0; // fractional mireds
+static uint32_t st_samples = 0; // samples accepted
+static uint16_t st_late = 0; // samples dropped for arriving after their playout time
+static uint16_t st_concealed = 0; // ticks extrapolated due to missing samples
+
+static int32_t interpolate(int32_t a, int32_t b, int64_t num, int64_t den) {
+    return a + (int32_t) ((b - a) * num / den);
+}
+
+static int32_t clamp(int32_t v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Leave streaming; called with st_spinlock not held
+static void finish_stream(bool timed_out) {
+    taskENTER_CRITICAL(&st_spinlock);
+    bool was_active = st_active;
+    st_active = false;
+    uint32_t samples = st_samples;
+    uint16_t late = st_late;
+    uint16_t concealed = st_concealed;
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    if (!was_active) {
+        return;
+    }
+
+    esp_timer_stop(st_timer);
+    light_driver_stream_end();
+    delayed_save_suspend(false);
+
+    TRACE(stream_end, timed_out, late, concealed, samples);
+    ESP_LOGI(TAG, "Stream %s: %lu samples, %u late, %u ticks concealed", timed_out ? "timed out" : "ended",
+            samples, late, concealed);
+}
+
+// Playout: every STREAM_TICK, fade to where the stream will be at the end of the tick
+static void stream_tick_cb(void *arg) {
+    (void) arg;
+    int64_t now = esp_timer_get_time();
+    int64_t t = now + STREAM_TICK * 1000;
+    bool output = false;
+    int32_t level = 0;
+    int32_t temperature = 0;
+
+    taskENTER_CRITICAL(&st_spinlock);
+    if (!st_active) {
+        taskEXIT_CRITICAL(&st_spinlock);
+        return;
+    }
+    if (now - st_last_rx > STREAM_TIMEOUT * 1000LL) {
+        taskEXIT_CRITICAL(&st_spinlock);
+        finish_stream(true);
+        return;
+    }
+
+    // Consume samples playing out by the end of this tick
+    while (st_count > 0 && st_buffer[0].at <= t) {
+        st_prev2 = st_prev;
+        st_prev = st_buffer[0];
+        st_have_prev = st_have_prev < 2 ? st_have_prev + 1 : 2;
+        memmove(&st_buffer[0], &st_buffer[1], (st_count - 1) * sizeof(st_buffer[0]));
+        st_count--;
+    }
+
+    if (st_have_prev && st_count > 0) {
+        // Interpolate between the sample we've passed and the next one
+        const st_sample *next = &st_buffer[0];
+        level = interpolate(st_prev.level, next->level, t - st_prev.at, next->at - st_prev.at);
+        temperature = interpolate(st_prev.temperature, next->temperature, t - st_prev.at, next->at - st_prev.at);
+        output = true;
+    } else if (st_have_prev) {
+        // Ran dry: conceal loss by continuing the last slope for a while, then hold
+        int64_t over = t - st_prev.at;
+        if (st_have_prev > 1 && over <= MAX_EXTRAPOLATE * 1000LL && st_prev.at > st_prev2.at) {
+            level = interpolate(st_prev2.level, st_prev.level, t - st_prev2.at, st_prev.at - st_prev2.at);
+            temperature = interpolate(st_prev2.temperature, st_prev.temperature, t - st_prev2.at, st_prev.at - st_prev2.at);
+            st_concealed++;
+        } else {
+            level = st_prev.level;
+            temperature = st_prev.temperature;
+        }
+        output = true;
+    }
+
+    if (output) {
+        level = clamp(level, 1, 254);
+        temperature = clamp(temperature, COLOR_MIN_TEMPERATURE << LD_TEMPERATURE_FRAC_BITS,
+                COLOR_MAX_TEMPERATURE << LD_TEMPERATURE_FRAC_BITS);
+        if (st_output_valid && level == st_out_level && temperature == st_out_temperature) {
+            output = false; // no change, no fade
+        } else {
+            st_output_valid = true;
+            st_out_level = level;
+            st_out_temperature = temperature;
+        }
+    }
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    if (output) {
+        light_driver_stream_to(level, temperature, STREAM_TICK);
+    }
+}
+
+esp_err_t stream_initialize() {
+    if (st_initialized) {
+        ESP_LOGW(TAG, "Already initialized, skip");
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &stream_tick_cb,
+        .name = "stream",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &st_timer), TAG, "can't create timer");
+    st_initialized = true;
+
+    return ESP_OK;
+}
+
+esp_err_t stream_start(uint16_t delay) {
+    if (!st_initialized) {
+        ESP_LOGE(TAG, "Stream started without initialization, skip");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (delay > STREAM_MAX_DELAY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&st_spinlock);
+    bool was_active = st_active;
+    st_active = true;
+    st_delay = (delay ? delay : STREAM_DEFAULT_DELAY) * 1000LL;
+    st_anchored = false;
+    st_count = 0;
+    st_have_prev = 0;
+    st_last_rx = esp_timer_get_time(); // timeout counts from the start
+    st_late_run = 0;
+    st_output_valid = false;
+    st_samples = st_late = st_concealed = 0;
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    if (!was_active) {
+        delayed_save_suspend(true);
+        esp_err_t err = esp_timer_start_periodic(st_timer, STREAM_TICK * 1000);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "can't start timer: %s", esp_err_to_name(err));
+            finish_stream(false);
+            return err;
+        }
+    }
+    ESP_LOGI(TAG, "Stream started, delay %u ms", delay ? delay : STREAM_DEFAULT_DELAY);
+
+    return ESP_OK;
+}
+
+// Put sample into the jitter buffer; called with st_spinlock held
+static void queue_sample(int64_t now, uint32_t timestamp, uint8_t level, uint16_t temperature) {
+    st_last_rx = now;
+
+    if (!st_anchored) {
+        st_anchored = true;
+        st_base_ts = timestamp;
+        st_base_local = now + st_delay;
+    }
+
+    // Sender clock wraps every ~49 days; signed difference takes care of that
+    int64_t at = st_base_local + (int64_t) (int32_t) (timestamp - st_base_ts) * 1000;
+    if (at <= now || (st_have_prev && at <= st_prev.at)) {
+        st_late++;
+        if (++st_late_run < REANCHOR_AFTER) {
+            return; // just late (or duplicate); drop it
+        }
+        // Consistently late (sender restarted, clocks drifted): restart playout from this sample
+        st_base_ts = timestamp;
+        st_base_local = now + st_delay;
+        at = st_base_local;
+        st_count = 0;
+        st_have_prev = 0;
+    }
+    st_late_run = 0;
+
+    // Insert sorted by playout time (same time → replace; full → drop the newest)
+    int i = st_count;
+    while (i > 0 && st_buffer[i - 1].at > at) {
+        i--;
+    }
+    if (i > 0 && st_buffer[i - 1].at == at) {
+        st_buffer[i - 1] = (st_sample) { at, level, temperature };
+        return;
+    }
+    if (st_count == BUFFER_SIZE) {
+        if (i == BUFFER_SIZE) {
+            return;
+        }
+        st_count--;
+    }
+    memmove(&st_buffer[i + 1], &st_buffer[i], (st_count - i) * sizeof(st_buffer[0]));
+    st_buffer[i] = (st_sample) { at, level, temperature };
+    st_count++;
+    st_samples++;
+}
+
+esp_err_t stream_sample(uint32_t timestamp, uint8_t level, uint16_t temperature) {
+    if (level == 0 || level == 0xff || temperature < COLOR_MIN_TEMPERATURE || temperature > COLOR_MAX_TEMPERATURE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&st_spinlock);
+    bool active = st_active;
+    if (active) {
+        queue_sample(now, timestamp, level, temperature << LD_TEMPERATURE_FRAC_BITS);
+    }
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    return active ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t stream_stop(uint8_t *level, uint16_t *temperature) {
+    taskENTER_CRITICAL(&st_spinlock);
+    bool active = st_active;
+    bool valid = st_output_valid;
+    if (valid) {
+        *level = st_out_level;
+        *temperature = (st_out_temperature + (1 << (LD_TEMPERATURE_FRAC_BITS - 1))) >> LD_TEMPERATURE_FRAC_BITS;
+    }
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    if (!active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    finish_stream(false);
+
+    return valid ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+bool stream_active() {
+    taskENTER_CRITICAL(&st_spinlock);
+    bool active = st_active;
+    taskEXIT_CRITICAL(&st_spinlock);
+
+    return active;
+}
@@ -0,0 +1,52 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: High-rate streaming of level/temperature (entertainment, sync).
+ * Timestamped samples go into a small jitter buffer, played out with a fixed
+ * delay and interpolated by short light driver fades; lost samples are
+ * concealed by extrapolation. Flash persistence is suspended meanwhile.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define STREAM_DEFAULT_DELAY 100 // ms; default playout delay (jitter buffer depth)
+#define STREAM_MAX_DELAY 1000 // ms
+#define STREAM_TICK 20 // ms; output update period (and fade length)
+#define STREAM_TIMEOUT 2000 // ms; stream ends after this long without samples
+
+// Initialize streaming (creates the playout timer)
+esp_err_t stream_initialize();
+
+// Enter streaming mode with given playout delay (ms, 0 = default)
+esp_err_t stream_start(uint16_t delay);
+
+// Queue up a sample; timestamp is on the sender's clock (ms), only differences matter
+//
+// Returns ESP_ERR_INVALID_STATE when not streaming, ESP_ERR_INVALID_ARG on
+// bad values (level 0/0xff, temperature out of range).
+esp_err_t stream_sample(uint32_t timestamp, uint8_t level, uint16_t temperature);
+
+// Leave streaming mode, returning the last output (if any) in level and temperature
+//
+// Returns ESP_ERR_INVALID_STATE when not streaming, ESP_ERR_NOT_FOUND if
+// nothing was output yet (level/temperature untouched).
+esp_err_t stream_stop(uint8_t *level, uint16_t *temperature);
+
+// Whether streaming is active
+bool stream_active();
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
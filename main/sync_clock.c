@@ -0,0 +1,52 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "sync_clock.h"
+
+static const char *TAG = "SYNC_CLOCK";
+
+static portMUX_TYPE sc_spinlock = portMUX_INITIALIZER_UNLOCKED; // spinlock governing these:
+static bool sc_valid = false;
+static uint32_t sc_ref_ms = 0; // reference clock at the time of sync...
+static int64_t sc_local = 0; // ... and the local clock (μs) at the same moment
+
+void sync_clock_set_reference(uint32_t ref_ms) {
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&sc_spinlock);
+    sc_valid = true;
+    sc_ref_ms = ref_ms;
+    sc_local = now;
+    taskEXIT_CRITICAL(&sc_spinlock);
+
+    ESP_LOGD(TAG, "reference %lu ms = local %lld μs", ref_ms, now);
+}
+
+esp_err_t sync_clock_to_local(uint32_t ref_ms, int64_t *local) {
+    taskENTER_CRITICAL(&sc_spinlock);
+    bool valid = sc_valid;
+    uint32_t base_ref = sc_ref_ms;
+    int64_t base_local = sc_local;
+    taskEXIT_CRITICAL(&sc_spinlock);
+
+    if (!valid) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Reference clock wraps every ~49 days; signed difference takes care of that
+    int64_t target = base_local + (int64_t) (int32_t) (ref_ms - base_ref) * 1000;
+    int64_t now = esp_timer_get_time();
+    if (target <= now || target - now > SYNC_CLOCK_MAX_AHEAD * 1000LL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *local = target;
+    return ESP_OK;
+}
@@ -0,0 +1,34 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Maps the coordinator-issued time reference (ms) to the local
+ * esp_timer clock, so scheduled starts happen in sync across lights.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define SYNC_CLOCK_MAX_AHEAD (60 * 1000) // ms; furthest we schedule into the future
+
+// Record that "now" is ref_ms on the reference clock
+void sync_clock_set_reference(uint32_t ref_ms);
+
+// Convert reference time ref_ms to local time (esp_timer_get_time() μs)
+//
+// Returns ESP_ERR_INVALID_STATE without a reference, ESP_ERR_INVALID_ARG
+// if ref_ms is in the past or more than SYNC_CLOCK_MAX_AHEAD in the future.
+esp_err_t sync_clock_to_local(uint32_t ref_ms, int64_t *local);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
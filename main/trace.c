@@ -0,0 +1,69 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ */
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#include "trace.h"
+
+#define TRACE_SIZE 256 // records; must be power of 2
+#define TRACE_INVALID_SEQ(seq) ((uint16_t) ~(seq)) // marks record being written
+
+static DRAM_ATTR trace_record_t tr_ring[TRACE_SIZE];
+static DRAM_ATTR uint32_t tr_head = 0; // next sequence number to claim
+
+void IRAM_ATTR trace_record(uint8_t event, uint8_t arg0, uint16_t arg1, uint16_t arg2, uint32_t arg3) {
+    uint32_t seq = __atomic_fetch_add(&tr_head, 1, __ATOMIC_RELAXED);
+    trace_record_t *r = &tr_ring[seq & (TRACE_SIZE - 1)];
+
+    __atomic_store_n(&r->seq, TRACE_INVALID_SEQ(seq), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->timestamp = esp_timer_get_time();
+    r->event = event;
+    r->arg0 = arg0;
+    r->arg1 = arg1;
+    r->arg2 = arg2;
+    r->arg3 = arg3;
+    __atomic_store_n(&r->seq, (uint16_t) seq, __ATOMIC_RELEASE);
+}
+
+size_t trace_dump(uint32_t from, uint8_t *out, size_t size) {
+    uint32_t head = __atomic_load_n(&tr_head, __ATOMIC_ACQUIRE);
+    uint8_t count = 0;
+    size_t len = sizeof(head) + sizeof(count);
+
+    if (size < len) {
+        return 0;
+    }
+
+    if (head - from > TRACE_SIZE) { // overwritten already (or from the future)
+        from = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+    }
+
+    for (uint32_t seq = from; seq != head && len + sizeof(trace_record_t) <= size; seq++) {
+        trace_record_t *r = &tr_ring[seq & (TRACE_SIZE - 1)];
+        trace_record_t copy;
+
+        // seqlock-style read: only keep the copy if nobody touched it meanwhile
+        uint16_t before = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        memcpy(&copy, r, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint16_t after = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+
+        if (before == (uint16_t) seq && after == before) {
+            memcpy(out + len, &copy, sizeof(copy));
+            len += sizeof(copy);
+            count++;
+        }
+    }
+
+    memcpy(out, &head, sizeof(head));
+    out[sizeof(head)] = count;
+
+    return len;
+}
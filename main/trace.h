@@ -0,0 +1,77 @@
+/*
+ * ESP32 White Ambiance
+ * Copyright © 2025 Michal Jirků (wejn)
+ *
+ * This code is licensed under GPL version 3.
+ *
+ * Purpose: Binary event trace (lock-free ring buffer of fixed-size records),
+ * usable from tasks as well as ISRs. Replaces formatted logging on the hot
+ * paths; dumped over zigbee and decoded by trace_decode.py on the host.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "global_config.h"
+
+// All the trace events (used for enum, and parsed by trace_decode.py -- so
+// keep the format), each with labels for its four args (empty = unused).
+// All generated with TE_ prefix.
+#define _TRACE_EVENT_ITER(X) \
+    X(fade_start, "onoff", "level", "temperature", "time_ms") \
+    X(fade_duties, "", "normal", "cold", "warm") \
+    X(fade_end, "channel", "", "", "") \
+    X(start_skew, "coherent", "channels", "stage_us", "skew_us") \
+    X(hw_sequence, "frames", "ranges", "", "time_ms") \
+    X(effect_end, "effect", "wakeups", "hw_sequences", "") \
+    X(stream_end, "timed_out", "late", "concealed", "samples") \
+    X(attr_write, "", "cluster", "attribute", "value") \
+    X(persist_var, "var", "", "", "value") \
+    X(persist_commit, "num", "", "", "err") \
+    X(antenna_probe, "switched", "current_lqi", "other_lqi", "external") \
+    X(persist_flush, "erased", "vars", "", "time_us") \
+    X(attr_handled, "", "cluster", "attribute", "time_us")
+
+#define TRACE_AS_ENUM(NAME, ...) TE_##NAME,
+typedef enum trace_event_s {
+    _TRACE_EVENT_ITER(TRACE_AS_ENUM)
+} trace_event_t;
+#undef TRACE_AS_ENUM
+
+// Single trace record (16 bytes, little endian on the wire)
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp; // esp_timer_get_time() truncated to 32 bits (μs)
+    uint16_t seq; // sequence number (truncated to 16 bits)
+    uint8_t event; // trace_event_t
+    uint8_t arg0;
+    uint16_t arg1;
+    uint16_t arg2;
+    uint32_t arg3;
+} trace_record_t;
+
+// Record an event (safe to call from ISR); use TRACE() instead
+void trace_record(uint8_t event, uint8_t arg0, uint16_t arg1, uint16_t arg2, uint32_t arg3);
+
+// Write a dump of consecutive records starting at sequence number `from` to
+// out (at most size bytes); returns number of bytes written. Format:
+//   u32 head (sequence number of the next record to be written),
+//   u8 count, then count trace_record_t.
+// If `from` was already overwritten, dump starts at the oldest record
+// available. Records overwritten while dumping are skipped.
+size_t trace_dump(uint32_t from, uint8_t *out, size_t size);
+
+#if TRACE_ENABLED
+#define TRACE(event, a0, a1, a2, a3) trace_record(TE_##event, (a0), (a1), (a2), (a3))
+#else
+#define TRACE(event, a0, a1, a2, a3) do {} while (0)
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
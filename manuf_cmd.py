@@ -0,0 +1,421 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Build (and parse) the manufacturer-specific commands understood by the
+light on its basic cluster (see MY_MANUF_CMD_* in main/global_config.h).
+
+Prints the complete ZCL frame (header + payload) in hex, ready to be sent
+raw to the light's endpoint; use --payload-only if your controller builds
+the ZCL header itself.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+MANUF_CODE = 0x131B
+MAGIC = 0x1337c0d3
+
+CMD_SET_STATE = 0xc0
+CMD_GET_STATE = 0xc1
+CMD_TIME_REF = 0xc2
+CMD_SCHEDULED_START = 0xc3
+CMD_PROGRAM_UPLOAD = 0xd0
+CMD_PROGRAM_LIST = 0xd1
+CMD_PROGRAM_DELETE = 0xd2
+CMD_PROGRAM_TRIGGER = 0xd3
+CMD_STREAM_START = 0xe0
+CMD_STREAM_SAMPLE = 0xe1
+CMD_STREAM_STOP = 0xe2
+
+STATE_ONOFF = 0x01
+STATE_LEVEL = 0x02
+STATE_TEMPERATURE = 0x04
+
+ZCL_HEADER = struct.Struct('<BHBB')  # frame control, manufacturer code, sequence, command
+ZCL_FC_CLUSTER_SPECIFIC = 0x01
+ZCL_FC_MANUF_SPECIFIC = 0x04
+ZCL_FC_TO_CLIENT = 0x08
+ZCL_FC_DISABLE_DEFAULT_RESPONSE = 0x10
+
+MAGIC_PREFIX = struct.Struct('>I')  # magic goes in network order
+SET_STATE = struct.Struct('<BBBHH')  # fields, onoff, level, temperature, transition
+GENERATION = struct.Struct('<I')
+TIME_REF = struct.Struct('<I')  # reference clock (ms)
+SCHEDULED_START = struct.Struct('<IB')  # start (reference ms), effect; followed by SET_STATE
+STATE_HEADER = struct.Struct('<BI')  # version, generation
+STATE = struct.Struct('<BBHBBHBBBBBH')
+SLOT = struct.Struct('<B')
+PROGRAM_HEADER = struct.Struct('<BBB')  # version, repetitions, number of frames
+PROGRAM_FRAME = struct.Struct('<BBHH')  # flags, level, temperature, time (ms)
+PROGRAM_LIST_HEADER = struct.Struct('<BB')  # version, used slots bitmap
+PROGRAM_LIST_RECORD = struct.Struct('<BBBI')  # slot, repetitions, frames, duration (ms)
+
+STREAM_START = struct.Struct('<H')  # playout delay (ms)
+STREAM_SAMPLE = struct.Struct('<IBH')  # timestamp (ms), level, temperature
+
+MAX_TRANSITION = 0xffff // 100  # 1/10 s; firmware fades are u16 ms, and it clamps anything longer
+
+PROGRAM_VERSION = 1
+PROGRAM_SLOTS = 8
+PROGRAM_MAX_FRAMES = 12
+FRAME_ONOFF = 0x01
+FRAME_ON = 0x02
+FRAME_LEVEL = 0x04
+FRAME_TEMPERATURE = 0x08
+FRAME_ABORTABLE = 0x10
+
+EFFECTS = ['None', 'Blink', 'Breathe', 'Okay', 'ChannelChange', 'Finish', 'Stop',
+           'DelayedOff0', 'DelayedOff1', 'DelayedOff2', 'DyingLight0', 'Custom']
+
+
+def zcl_frame(cmd, payload, seq=0, default_response=True):
+    fc = ZCL_FC_CLUSTER_SPECIFIC | ZCL_FC_MANUF_SPECIFIC
+    if not default_response:
+        fc |= ZCL_FC_DISABLE_DEFAULT_RESPONSE
+    return ZCL_HEADER.pack(fc, MANUF_CODE, seq, cmd) + payload
+
+
+def build_set_state(onoff=None, level=None, temperature=None, transition=0.0):
+    fields = 0
+    if onoff is not None:
+        fields |= STATE_ONOFF
+    if level is not None:
+        if not 1 <= level <= 254:
+            raise ValueError('level must be within 1..254')
+        fields |= STATE_LEVEL
+    if temperature is not None:
+        if not 0 <= temperature <= 0xffff:
+            raise ValueError('temperature must fit in u16 (mireds)')
+        fields |= STATE_TEMPERATURE
+    tenths = round(transition * 10)
+    if not 0 <= tenths <= MAX_TRANSITION:
+        raise ValueError('transition must be within 0..%.1f s' % (MAX_TRANSITION / 10.0))
+    return MAGIC_PREFIX.pack(MAGIC) + SET_STATE.pack(
+            fields, int(bool(onoff)), level or 0, temperature or 0, tenths)
+
+
+def parse_set_state(payload):
+    if len(payload) != MAGIC_PREFIX.size + SET_STATE.size:
+        raise ValueError('set state payload must be %d bytes, got %d' % (
+            MAGIC_PREFIX.size + SET_STATE.size, len(payload)))
+    magic, = MAGIC_PREFIX.unpack_from(payload)
+    fields, onoff, level, temperature, tenths = SET_STATE.unpack_from(payload, MAGIC_PREFIX.size)
+    out = {'magic_ok': magic == MAGIC, 'transition': tenths / 10.0}
+    if fields & STATE_ONOFF:
+        out['onoff'] = bool(onoff)
+    if fields & STATE_LEVEL:
+        out['level'] = level
+    if fields & STATE_TEMPERATURE:
+        out['temperature'] = temperature
+    return out
+
+
+def reference_now():
+    # Reference clock: wall clock ms, truncated to u32 (the light only cares about differences)
+    return int(time.time() * 1000) & 0xffffffff
+
+
+def build_time_ref(now=None):
+    return MAGIC_PREFIX.pack(MAGIC) + TIME_REF.pack(reference_now() if now is None else now)
+
+
+def parse_time_ref(payload):
+    if len(payload) != MAGIC_PREFIX.size + TIME_REF.size:
+        raise ValueError('time reference payload must be %d bytes' % (MAGIC_PREFIX.size + TIME_REF.size))
+    magic, = MAGIC_PREFIX.unpack_from(payload)
+    now, = TIME_REF.unpack_from(payload, MAGIC_PREFIX.size)
+    return {'magic_ok': magic == MAGIC, 'now': now}
+
+
+def build_scheduled_start(start, effect=0, **state):
+    if effect not in range(EFFECTS.index('Stop') + 1):
+        raise ValueError('effect must be one of: %s' % ', '.join(EFFECTS[:EFFECTS.index('Stop') + 1]))
+    set_state = build_set_state(**state) if state else MAGIC_PREFIX.pack(MAGIC) + bytes(SET_STATE.size)
+    return MAGIC_PREFIX.pack(MAGIC) + SCHEDULED_START.pack(start & 0xffffffff, effect) + \
+        set_state[MAGIC_PREFIX.size:]
+
+
+def parse_scheduled_start(payload):
+    if len(payload) != MAGIC_PREFIX.size + SCHEDULED_START.size + SET_STATE.size:
+        raise ValueError('scheduled start payload must be %d bytes' % (
+            MAGIC_PREFIX.size + SCHEDULED_START.size + SET_STATE.size))
+    start, effect = SCHEDULED_START.unpack_from(payload, MAGIC_PREFIX.size)
+    out = {'start': start, 'effect': EFFECTS[effect] if effect < len(EFFECTS) else effect}
+    state = parse_set_state(payload[:MAGIC_PREFIX.size] + payload[MAGIC_PREFIX.size + SCHEDULED_START.size:])
+    if len(state) == 2 and state['transition'] == 0:
+        del state['transition']  # no state part
+    return {**out, **state}
+
+
+def build_get_state(generation=None):
+    return b'' if generation is None else GENERATION.pack(generation)
+
+
+def parse_get_state(payload, to_client):
+    if not to_client:
+        if len(payload) not in (0, GENERATION.size):
+            raise ValueError('get state payload must be empty or u32 generation')
+        return {'generation': GENERATION.unpack(payload)[0]} if payload else {}
+    if len(payload) < STATE_HEADER.size:
+        raise ValueError('get state response too short')
+    version, generation = STATE_HEADER.unpack_from(payload)
+    out = {'version': version, 'generation': generation}
+    if len(payload) == STATE_HEADER.size:
+        out['unchanged'] = True
+        return out
+    if version != 1 or len(payload) != STATE_HEADER.size + STATE.size:
+        raise ValueError('unsupported state version %d (or bad length)' % version)
+    names = ('onoff', 'level', 'temperature', 'startup_onoff', 'startup_level', 'startup_temperature',
+             'level_options', 'color_options', 'rf_switch_external', 'effect', 'fade_progress',
+             'fade_remaining')
+    out.update(zip(names, STATE.unpack_from(payload, STATE_HEADER.size)))
+    if out['effect'] < len(EFFECTS):
+        out['effect'] = EFFECTS[out['effect']]
+    return out
+
+
+def parse_program_frame(spec):
+    # onoff,level,temperature,time[,a] -- '-' leaves the value to the current light state
+    parts = spec.split(',')
+    if len(parts) not in (4, 5) or (len(parts) == 5 and parts[4] != 'a'):
+        raise ValueError('frame must be onoff,level,temperature,time_ms[,a]: %s' % spec)
+    flags = FRAME_ABORTABLE if len(parts) == 5 else 0
+    level = temperature = 0
+    if parts[0] != '-':
+        flags |= FRAME_ONOFF | (FRAME_ON if parse_onoff(parts[0]) else 0)
+    if parts[1] != '-':
+        level = int(parts[1])
+        if not 1 <= level <= 254:
+            raise ValueError('level must be within 1..254')
+        flags |= FRAME_LEVEL
+    if parts[2] != '-':
+        temperature = int(parts[2])
+        flags |= FRAME_TEMPERATURE
+    time_ms = int(parts[3])
+    if not 1 <= time_ms <= 0xffff:
+        raise ValueError('frame time must be within 1..65535 ms')
+    return PROGRAM_FRAME.pack(flags, level, temperature, time_ms)
+
+
+def build_program_upload(slot, frames, reps=1):
+    if not 0 <= slot < PROGRAM_SLOTS:
+        raise ValueError('slot must be within 0..%d' % (PROGRAM_SLOTS - 1))
+    if not 1 <= len(frames) <= PROGRAM_MAX_FRAMES:
+        raise ValueError('program must have 1..%d frames' % PROGRAM_MAX_FRAMES)
+    if not 1 <= reps <= 255:
+        raise ValueError('repetitions must be within 1..255')
+    return MAGIC_PREFIX.pack(MAGIC) + SLOT.pack(slot) + PROGRAM_HEADER.pack(PROGRAM_VERSION, reps, len(frames)) + \
+        b''.join(parse_program_frame(f) for f in frames)
+
+
+def parse_program_upload(payload):
+    offset = MAGIC_PREFIX.size + SLOT.size
+    if len(payload) < offset + PROGRAM_HEADER.size:
+        raise ValueError('program upload payload too short')
+    magic, = MAGIC_PREFIX.unpack_from(payload)
+    slot, = SLOT.unpack_from(payload, MAGIC_PREFIX.size)
+    version, reps, count = PROGRAM_HEADER.unpack_from(payload, offset)
+    offset += PROGRAM_HEADER.size
+    if len(payload) != offset + count * PROGRAM_FRAME.size:
+        raise ValueError('program upload length mismatch')
+    frames = []
+    for flags, level, temperature, time_ms in PROGRAM_FRAME.iter_unpack(payload[offset:]):
+        frames.append(','.join([
+            ('on' if flags & FRAME_ON else 'off') if flags & FRAME_ONOFF else '-',
+            str(level) if flags & FRAME_LEVEL else '-',
+            str(temperature) if flags & FRAME_TEMPERATURE else '-',
+            str(time_ms)] + (['a'] if flags & FRAME_ABORTABLE else [])))
+    return {'magic_ok': magic == MAGIC, 'slot': slot, 'version': version, 'reps': reps, 'frames': frames}
+
+
+def parse_program_list(payload, to_client):
+    if not to_client:
+        return {}
+    if len(payload) < PROGRAM_LIST_HEADER.size:
+        raise ValueError('program list response too short')
+    version, used = PROGRAM_LIST_HEADER.unpack_from(payload)
+    programs = [dict(zip(('slot', 'reps', 'frames', 'duration'), r))
+                for r in PROGRAM_LIST_RECORD.iter_unpack(payload[PROGRAM_LIST_HEADER.size:])]
+    return {'version': version, 'used': '0x%02x' % used, 'programs': programs}
+
+
+def build_program_delete(slot):
+    return MAGIC_PREFIX.pack(MAGIC) + SLOT.pack(slot)
+
+
+def parse_slot(payload, with_magic):
+    if len(payload) != (MAGIC_PREFIX.size if with_magic else 0) + SLOT.size:
+        raise ValueError('bad payload length')
+    return {'slot': payload[-1]}
+
+
+def build_stream_sample(timestamp, level, temperature):
+    if not 1 <= level <= 254:
+        raise ValueError('level must be within 1..254')
+    return STREAM_SAMPLE.pack(timestamp & 0xffffffff, level, temperature)
+
+
+def parse_stream_start(payload):
+    if len(payload) != MAGIC_PREFIX.size + STREAM_START.size:
+        raise ValueError('stream start payload must be %d bytes' % (MAGIC_PREFIX.size + STREAM_START.size))
+    magic, = MAGIC_PREFIX.unpack_from(payload)
+    delay, = STREAM_START.unpack_from(payload, MAGIC_PREFIX.size)
+    return {'magic_ok': magic == MAGIC, 'delay': delay}
+
+
+def parse_stream_sample(payload):
+    if len(payload) != STREAM_SAMPLE.size:
+        raise ValueError('stream sample payload must be %d bytes' % STREAM_SAMPLE.size)
+    return dict(zip(('timestamp', 'level', 'temperature'), STREAM_SAMPLE.unpack(payload)))
+
+
+PARSERS = {
+    CMD_SET_STATE: ('set_state', lambda p, to_client: parse_set_state(p)),
+    CMD_GET_STATE: ('get_state', parse_get_state),
+    CMD_TIME_REF: ('time_ref', lambda p, to_client: parse_time_ref(p)),
+    CMD_SCHEDULED_START: ('scheduled_start', lambda p, to_client: parse_scheduled_start(p)),
+    CMD_STREAM_START: ('stream_start', lambda p, to_client: parse_stream_start(p)),
+    CMD_STREAM_SAMPLE: ('stream_sample', lambda p, to_client: parse_stream_sample(p)),
+    CMD_STREAM_STOP: ('stream_stop', lambda p, to_client: {'keep': bool(p and p[0])}),
+    CMD_PROGRAM_UPLOAD: ('program_upload', lambda p, to_client: parse_program_upload(p)),
+    CMD_PROGRAM_LIST: ('program_list', parse_program_list),
+    CMD_PROGRAM_DELETE: ('program_delete', lambda p, to_client: parse_slot(p, True)),
+    CMD_PROGRAM_TRIGGER: ('program_trigger', lambda p, to_client: parse_slot(p, False)),
+}
+
+
+def parse_frame(data):
+    if len(data) < ZCL_HEADER.size:
+        raise ValueError('frame too short')
+    fc, manuf, seq, cmd = ZCL_HEADER.unpack_from(data)
+    if not fc & ZCL_FC_MANUF_SPECIFIC or manuf != MANUF_CODE:
+        raise ValueError('not a manufacturer-specific frame for 0x%04x' % MANUF_CODE)
+    to_client = bool(fc & ZCL_FC_TO_CLIENT)
+    name, parser = PARSERS.get(cmd, ('unknown_0x%02x' % cmd, lambda p, to_client: {'payload': p.hex()}))
+    return {'command': name, 'seq': seq, 'to_client': to_client, **parser(data[ZCL_HEADER.size:], to_client)}
+
+
+def parse_onoff(value):
+    if value.lower() in ('1', 'on', 'true'):
+        return True
+    if value.lower() in ('0', 'off', 'false'):
+        return False
+    raise argparse.ArgumentTypeError('expected on/off')
+
+
+def output(args, cmd, payload):
+    if args.payload_only:
+        print(payload.hex())
+    else:
+        print(zcl_frame(cmd, payload, args.seq, not args.no_default_response).hex())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build/parse e32wamb manufacturer-specific commands')
+    parser.add_argument('--seq', type=int, default=0, help='ZCL sequence number (default: 0)')
+    parser.add_argument('--payload-only', action='store_true', help='Print only the command payload')
+    parser.add_argument('--no-default-response', action='store_true', help='Set the disable default response bit')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    p = sub.add_parser('set-state', help='Set onoff/level/temperature at once (cmd 0x%02x)' % CMD_SET_STATE)
+    p.add_argument('--onoff', type=parse_onoff, help='on or off')
+    p.add_argument('--level', type=int, help='level (1..254)')
+    p.add_argument('--temperature', type=int, help='color temperature (mireds)')
+    p.add_argument('--transition', type=float, default=0.0,
+                   help='transition time (s, 0.1 s resolution, max %.1f)' % (MAX_TRANSITION / 10.0))
+
+    p = sub.add_parser('get-state', help='Read packed light state (cmd 0x%02x)' % CMD_GET_STATE)
+    p.add_argument('--generation', type=lambda x: int(x, 0),
+                   help='last seen generation (response is header-only if unchanged)')
+
+    p = sub.add_parser('time-ref', help='Distribute time reference (cmd 0x%02x); send as groupcast' % CMD_TIME_REF)
+    p.add_argument('--now', type=int, help='reference clock value (ms, default: wall clock)')
+
+    p = sub.add_parser('schedule', help='Start state/effect at given time (cmd 0x%02x)' % CMD_SCHEDULED_START)
+    g = p.add_mutually_exclusive_group(required=True)
+    g.add_argument('--start', type=int, help='start time on the reference clock (ms)')
+    g.add_argument('--start-in', type=float, help='start this many s from now (wall clock reference)')
+    p.add_argument('--effect', choices=EFFECTS[:EFFECTS.index('Stop') + 1], default='None', help='identify effect')
+    p.add_argument('--onoff', type=parse_onoff, help='on or off')
+    p.add_argument('--level', type=int, help='level (1..254)')
+    p.add_argument('--temperature', type=int, help='color temperature (mireds)')
+    p.add_argument('--transition', type=float, default=0.0,
+                   help='transition time (s, 0.1 s resolution, max %.1f)' % (MAX_TRANSITION / 10.0))
+
+    p = sub.add_parser('stream-start', help='Enter streaming mode (cmd 0x%02x)' % CMD_STREAM_START)
+    p.add_argument('--delay', type=int, default=0, help='playout delay (ms, default: 0 = light default)')
+
+    p = sub.add_parser('stream-sample', help='Stream sample (cmd 0x%02x); only rejected ones get a default response'
+                       % CMD_STREAM_SAMPLE)
+    p.add_argument('--timestamp', type=int, help='sender clock (ms, default: wall clock)')
+    p.add_argument('--level', type=int, required=True, help='level (1..254)')
+    p.add_argument('--temperature', type=int, required=True, help='color temperature (mireds)')
+
+    p = sub.add_parser('stream-stop', help='Leave streaming mode (cmd 0x%02x)' % CMD_STREAM_STOP)
+    p.add_argument('--keep', action='store_true', help='keep (and save) the last streamed state')
+
+    p = sub.add_parser('program-upload', help='Store effect program into slot (cmd 0x%02x)' % CMD_PROGRAM_UPLOAD)
+    p.add_argument('--slot', type=int, required=True, help='slot (0..%d)' % (PROGRAM_SLOTS - 1))
+    p.add_argument('--reps', type=int, default=1, help='repetitions of the whole program (default: 1)')
+    p.add_argument('--frame', action='append', required=True,
+                   help="onoff,level,temperature,time_ms[,a] ('-' = current value, 'a' = abortable); repeat")
+
+    sub.add_parser('program-list', help='List stored effect programs (cmd 0x%02x)' % CMD_PROGRAM_LIST)
+
+    p = sub.add_parser('program-delete', help='Delete effect program (cmd 0x%02x)' % CMD_PROGRAM_DELETE)
+    p.add_argument('--slot', type=int, required=True, help='slot (0..%d)' % (PROGRAM_SLOTS - 1))
+
+    p = sub.add_parser('program-trigger', help='Play effect program (cmd 0x%02x)' % CMD_PROGRAM_TRIGGER)
+    p.add_argument('--slot', type=int, required=True, help='slot (0..%d)' % (PROGRAM_SLOTS - 1))
+
+    p = sub.add_parser('parse', help='Parse a hex ZCL frame (command, or response from the light)')
+    p.add_argument('frame', help='frame in hex')
+
+    args = parser.parse_args()
+
+    try:
+        if args.cmd == 'set-state':
+            output(args, CMD_SET_STATE, build_set_state(args.onoff, args.level, args.temperature, args.transition))
+        elif args.cmd == 'get-state':
+            output(args, CMD_GET_STATE, build_get_state(args.generation))
+        elif args.cmd == 'time-ref':
+            output(args, CMD_TIME_REF, build_time_ref(args.now))
+        elif args.cmd == 'schedule':
+            start = args.start if args.start is not None else reference_now() + round(args.start_in * 1000)
+            state = {}
+            if args.onoff is not None or args.level is not None or args.temperature is not None:
+                state = dict(onoff=args.onoff, level=args.level, temperature=args.temperature,
+                             transition=args.transition)
+            output(args, CMD_SCHEDULED_START, build_scheduled_start(start, EFFECTS.index(args.effect), **state))
+        elif args.cmd == 'stream-start':
+            output(args, CMD_STREAM_START, MAGIC_PREFIX.pack(MAGIC) + STREAM_START.pack(args.delay))
+        elif args.cmd == 'stream-sample':
+            timestamp = reference_now() if args.timestamp is None else args.timestamp
+            output(args, CMD_STREAM_SAMPLE, build_stream_sample(timestamp, args.level, args.temperature))
+        elif args.cmd == 'stream-stop':
+            output(args, CMD_STREAM_STOP, bytes([int(args.keep)]))
+        elif args.cmd == 'program-upload':
+            output(args, CMD_PROGRAM_UPLOAD, build_program_upload(args.slot, args.frame, args.reps))
+        elif args.cmd == 'program-list':
+            output(args, CMD_PROGRAM_LIST, b'')
+        elif args.cmd == 'program-delete':
+            output(args, CMD_PROGRAM_DELETE, build_program_delete(args.slot))
+        elif args.cmd == 'program-trigger':
+            output(args, CMD_PROGRAM_TRIGGER, SLOT.pack(args.slot))
+        elif args.cmd == 'parse':
+            for k, v in parse_frame(bytes.fromhex(args.frame.replace(' ', ''))).items():
+                print('%s: %s' % (k, v))
+    except ValueError as e:
+        sys.exit('Error: %s' % e)
+
+
+if __name__ == '__main__':
+    main()
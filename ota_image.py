@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Build zigbee OTA upgrade files for the light, and estimate what they cost
+on air.
+
+The app image is stored either raw (sub-element tag 0x0000), or E32Z
+compressed (tag 0xf000; see main/e32z.h) -- optionally as a delta against
+the image currently running on the lights (--base), which the light reads
+back from its own flash while decoding.
+
+The simulate command decodes the file exactly like the light would
+(verifying it round-trips), and reports bytes on air of the block transfer
+compared to the raw image.
+"""
+
+import argparse
+import calendar
+import struct
+import sys
+import time
+import zlib
+
+MANUF_CODE = 0x131B
+IMAGE_TYPE = 0xe32a
+TAG_RAW = 0x0000
+TAG_E32Z = 0xf000
+
+OTA_FILE_ID = 0x0BEEF11E
+OTA_HEADER = struct.Struct('<IHHHHHIH32sI')
+SUB_ELEMENT = struct.Struct('<HI')
+
+APP_DESC_OFFSET = 0x20  # image header (24) + first segment header (8)
+APP_DESC_MAGIC = 0xABCD5432
+APP_DESC_VERSION = slice(APP_DESC_OFFSET + 16, APP_DESC_OFFSET + 48)
+APP_DESC_ELF_SHA = slice(APP_DESC_OFFSET + 0x90, APP_DESC_OFFSET + 0x90 + 8)
+
+E32Z_HEADER = struct.Struct('<4sBBHII8s')  # magic, version, flags, reserved, size, crc32, base sha prefix
+E32Z_FLAG_DELTA = 0x01
+WINDOW = 4096
+MIN_WINDOW_MATCH, MAX_WINDOW_MATCH = 3, 0x3f + 3
+MAX_LITERAL = 0x80
+MAX_BASE_MATCH = 0x4000
+MIN_BASE_MATCH = 8
+BASE_KEY = 8  # bytes hashed for base matches...
+BASE_STEP = 4  # ... at every BASE_STEP-th base offset
+CHAIN = 32  # window candidates tried per position
+
+
+def app_desc(image):
+    magic, = struct.unpack_from('<I', image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        sys.exit('Error: not an esp32 app image (no app description)')
+    version = image[APP_DESC_VERSION].split(b'\0')[0].decode()
+    return version, image[APP_DESC_ELF_SHA]
+
+
+def file_version_from(version):
+    # PROJECT_VER is "%Y%m%d%H%M%S-gitrev" (UTC); the firmware uses BUILD_EPOCH of the same moment
+    try:
+        return calendar.timegm(time.strptime(version[:14], '%Y%m%d%H%M%S'))
+    except ValueError:
+        sys.exit('Error: can\'t derive file version from "%s", use --file-version' % version)
+
+
+def compress(data, base=None):
+    out = bytearray()
+    literals = bytearray()
+
+    def flush_literals():
+        for i in range(0, len(literals), MAX_LITERAL):
+            chunk = literals[i:i + MAX_LITERAL]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        literals.clear()
+
+    base_index = {}
+    if base:
+        for pos in range(0, len(base) - BASE_KEY + 1, BASE_STEP):
+            base_index.setdefault(base[pos:pos + BASE_KEY], pos)
+
+    heads = {}  # 3 byte prefix → recent positions
+    n = len(data)
+    i = 0
+    while i < n:
+        best_len, best_dist = 0, 0
+        key = data[i:i + 3]
+        candidates = heads.get(key, [])
+        for cand in reversed(candidates):
+            dist = i - cand
+            if dist > WINDOW:
+                break
+            length = 0
+            while length < MAX_WINDOW_MATCH and i + length < n and data[cand + length] == data[i + length]:
+                length += 1
+            if length > best_len:
+                best_len, best_dist = length, dist
+                if length == MAX_WINDOW_MATCH:
+                    break
+
+        base_len, base_pos, back = 0, 0, 0
+        if base_index:
+            pos = base_index.get(data[i:i + BASE_KEY])
+            if pos is not None:
+                # extend backwards into pending literals, then forwards
+                while back < len(literals) and pos - back > 0 and base[pos - back - 1] == literals[-back - 1]:
+                    back += 1
+                length = 0
+                limit = min(MAX_BASE_MATCH - back, n - i, len(base) - pos)
+                while length < limit and base[pos + length] == data[i + length]:
+                    length += 1
+                base_len, base_pos = length, pos
+
+        # savings: window copy costs 3 bytes, base copy 5 bytes
+        if base_len + back >= MIN_BASE_MATCH and base_len + back - 5 > best_len - 3:
+            if back:
+                del literals[-back:]
+            flush_literals()
+            total = base_len + back
+            start = base_pos - back
+            out.append(0xc0 | (total - 1) >> 8)
+            out.append((total - 1) & 0xff)
+            out.extend(struct.pack('<I', start)[:3])
+            advance = base_len
+        elif best_len >= MIN_WINDOW_MATCH:
+            flush_literals()
+            out.append(0x80 | (best_len - MIN_WINDOW_MATCH))
+            out.extend(struct.pack('<H', best_dist - 1))
+            advance = best_len
+        else:
+            literals.append(data[i])
+            advance = 1
+
+        for j in range(i, min(i + advance, n - 2)):
+            chain = heads.setdefault(data[j:j + 3], [])
+            chain.append(j)
+            if len(chain) > CHAIN:
+                del chain[0]
+        i += advance
+
+    flush_literals()
+    return bytes(out)
+
+
+def e32z_encode(image, base=None):
+    flags, sha = 0, bytes(8)
+    if base:
+        flags |= E32Z_FLAG_DELTA
+        _, sha = app_desc(base)
+    header = E32Z_HEADER.pack(b'E32Z', 1, flags, 0, len(image), zlib.crc32(image), sha)
+    return header + compress(image, base)
+
+
+def e32z_decode(stream, base=None):
+    magic, version, flags, _, size, crc, sha = E32Z_HEADER.unpack_from(stream)
+    if magic != b'E32Z' or version != 1:
+        raise ValueError('bad E32Z header')
+    if flags & E32Z_FLAG_DELTA:
+        if base is None:
+            raise ValueError('delta image, need --base to decode')
+        if app_desc(base)[1] != sha:
+            raise ValueError('delta image built against a different base')
+    out = bytearray()
+    i = E32Z_HEADER.size
+    while i < len(stream):
+        t = stream[i]
+        if t < 0x80:
+            out.extend(stream[i + 1:i + 2 + t])
+            i += 2 + t
+        elif t < 0xc0:
+            length = (t & 0x3f) + MIN_WINDOW_MATCH
+            dist, = struct.unpack_from('<H', stream, i + 1)
+            dist += 1
+            if dist > WINDOW or dist > len(out):
+                raise ValueError('window copy out of range')
+            for _ in range(length):
+                out.append(out[-dist])
+            i += 3
+        else:
+            length = ((t & 0x3f) << 8 | stream[i + 1]) + 1
+            offset = int.from_bytes(stream[i + 2:i + 5], 'little')
+            if not flags & E32Z_FLAG_DELTA:
+                raise ValueError('base copy in non-delta stream')
+            out.extend(base[offset:offset + length])
+            i += 5
+    if len(out) != size or zlib.crc32(out) != crc:
+        raise ValueError('size/crc mismatch after decoding')
+    return bytes(out)
+
+
+def build_ota_file(tag, payload, file_version, manuf_code, image_type, header_string):
+    body = SUB_ELEMENT.pack(tag, len(payload)) + payload
+    total = OTA_HEADER.size + len(body)
+    header = OTA_HEADER.pack(OTA_FILE_ID, 0x0100, OTA_HEADER.size, 0, manuf_code, image_type, file_version,
+                             0x0002, header_string.encode()[:32].ljust(32, b'\0'), total)
+    return header + body
+
+
+def parse_ota_file(data):
+    (file_id, _, header_len, _, manuf_code, image_type, file_version, _, header_string,
+     total) = OTA_HEADER.unpack_from(data)
+    if file_id != OTA_FILE_ID or total != len(data):
+        raise ValueError('not a (complete) zigbee OTA file')
+    elements = []
+    i = header_len
+    while i < len(data):
+        tag, length = SUB_ELEMENT.unpack_from(data, i)
+        elements.append((tag, data[i + SUB_ELEMENT.size:i + SUB_ELEMENT.size + length]))
+        i += SUB_ELEMENT.size + length
+    return {'manuf_code': manuf_code, 'image_type': image_type, 'file_version': file_version,
+            'header_string': header_string.split(b'\0')[0].decode(), 'elements': elements}
+
+
+# Per frame overhead on air: PHY (6) + MAC (11) + NWK w/ security (26) + APS (8), plus MAC ack (11)
+FRAME_OVERHEAD = 6 + 11 + 26 + 8 + 11
+BLOCK_REQUEST = 3 + 14  # ZCL header + Image Block Request
+BLOCK_RESPONSE = 3 + 14  # ZCL header + Image Block Response (without data)
+BYTE_TIME = 32e-6  # 250 kbit/s
+
+
+def airtime(size, block):
+    blocks = -(-size // block)
+    on_air = blocks * (2 * FRAME_OVERHEAD + BLOCK_REQUEST + BLOCK_RESPONSE) + size
+    return blocks, on_air, on_air * BYTE_TIME
+
+
+def cmd_build(args):
+    image = args.image.read()
+    version, _ = app_desc(image)
+    file_version = args.file_version if args.file_version is not None else file_version_from(version)
+    base = args.base.read() if args.base else None
+
+    if args.raw:
+        tag, payload = TAG_RAW, image
+    else:
+        tag, payload = TAG_E32Z, e32z_encode(image, base)
+        if e32z_decode(payload, base) != image:
+            sys.exit('Error: compressed image doesn\'t round-trip (bug!)')
+
+    ota = build_ota_file(tag, payload, file_version, args.manuf_code, args.image_type, version)
+    args.output.write(ota)
+    print('%s: file version 0x%08x (%s), %d → %d bytes (%.1f %%)%s' % (
+        args.output.name, file_version, version, len(image), len(ota), 100.0 * len(ota) / len(image),
+        ', delta' if base else ''))
+
+
+def cmd_simulate(args):
+    ota = parse_ota_file(args.ota.read())
+    base = args.base.read() if args.base else None
+    size = 0
+    image = None
+    for tag, payload in ota['elements']:
+        size += SUB_ELEMENT.size + len(payload)
+        if tag == TAG_RAW:
+            image = payload
+        elif tag == TAG_E32Z:
+            image = e32z_decode(payload, base)
+    if image is None:
+        sys.exit('Error: no image sub-element')
+
+    print('OTA file: version 0x%08x (%s), manuf 0x%04x, type 0x%04x' % (
+        ota['file_version'], ota['header_string'], ota['manuf_code'], ota['image_type']))
+    print('Decoded image: %d bytes, round-trip OK' % len(image))
+    print()
+    print('%-12s %10s %8s %12s %10s' % ('', 'bytes', 'blocks', 'on air', 'airtime'))
+    raw = airtime(len(image), args.block_size)
+    this = airtime(size, args.block_size)
+    for name, payload, (blocks, on_air, t) in (('raw image', len(image), raw), ('this file', size, this)):
+        print('%-12s %10d %8d %12d %9.1fs' % (name, payload, blocks, on_air, t))
+    print()
+    print('Saved %.1f %% of airtime (%d byte blocks, %d bytes overhead per block)' % (
+        100.0 * (1 - this[1] / raw[1]), args.block_size, 2 * FRAME_OVERHEAD + BLOCK_REQUEST + BLOCK_RESPONSE))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build/simulate e32wamb zigbee OTA images')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    p = sub.add_parser('build', help='Build OTA file from an app image (build/e32wamb.bin)')
+    p.add_argument('image', type=argparse.FileType('rb'), help='app image')
+    p.add_argument('-o', '--output', type=argparse.FileType('wb'), required=True, help='OTA file to write')
+    p.add_argument('--base', type=argparse.FileType('rb'), help='app image running on the lights (→ delta)')
+    p.add_argument('--raw', action='store_true', help='Don\'t compress')
+    p.add_argument('--file-version', type=lambda x: int(x, 0), help='default: build time from the image version')
+    p.add_argument('--manuf-code', type=lambda x: int(x, 0), default=MANUF_CODE)
+    p.add_argument('--image-type', type=lambda x: int(x, 0), default=IMAGE_TYPE)
+    p.set_defaults(func=cmd_build)
+
+    p = sub.add_parser('simulate', help='Decode OTA file like the light, report bytes on air vs raw image')
+    p.add_argument('ota', type=argparse.FileType('rb'), help='OTA file')
+    p.add_argument('--base', type=argparse.FileType('rb'), help='app image running on the lights (for delta)')
+    p.add_argument('--block-size', type=int, default=64, help='image block size (MY_OTA_MAX_DATA_SIZE)')
+    p.set_defaults(func=cmd_simulate)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except ValueError as e:
+        sys.exit('Error: %s' % e)
+
+
+if __name__ == '__main__':
+    main()
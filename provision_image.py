@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Build merged provisioning images: app (everything in build/flash_args),
+factory zigbee config (zb_fct, from esp_zb_mfg_tool.py) and a pre-built
+"nvs" partition with light_config defaults (optionally also a calibration
+profile from calib_profile.py) -- one file per device, flashed with a
+single write:
+  esptool.py write_flash 0x0 CAFEBEEF50C0FFA0-merged.bin
+
+Defaults are light_config flash variables (_LCFV_ITER in
+main/light_config.h, e.g. startup_level=254 or rf_switch_external=0),
+given with --set and/or a --defaults file of key=value lines. The app,
+nvs and calibration parts are built once and shared by all the devices.
+
+Needs the IDF nvs partition generator (pip install esp-idf-nvs-partition-gen,
+or IDF_PATH set).
+"""
+
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LIGHT_CONFIG_H = os.path.join(HERE, 'main', 'light_config.h')
+NAMESPACE = 'light_config'  # LIGHT_CONFIG_NVS_NAMESPACE in main/light_config.c
+NVS_KEY_LEN = 15  # NVS_KEY_NAME_MAX_SIZE - 1; firmware trims keys to this
+FILL = 0xff  # erased flash
+
+
+def load_vars(light_config_h):
+    with open(light_config_h, 'r') as f:
+        src = f.read()
+    body = re.search(r'#define _LCFV_ITER\(X\)(.*?)\n\n', src, re.S)
+    if not body:
+        sys.exit('Error: no _LCFV_ITER in %s' % light_config_h)
+    return re.findall(r'X\((\w+)\)', body.group(1))
+
+
+def parse_size(text):
+    text = text.strip()
+    for suffix, mult in (('K', 1024), ('M', 1024 * 1024)):
+        if text.upper().endswith(suffix):
+            return int(text[:-1], 0) * mult
+    return int(text, 0)
+
+
+def load_partitions(path):
+    # -> {name: (offset, size)}; only rows with explicit offsets (like ours)
+    parts = {}
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            cols = [c.strip() for c in line.split(',')]
+            if len(cols) < 5 or not cols[3]:
+                sys.exit('Error: %s: need explicit offsets (%s)' % (path, cols[0]))
+            parts[cols[0]] = (parse_size(cols[3]), parse_size(cols[4]))
+    return parts
+
+
+def load_flash_args(build_dir):
+    # -> [(offset, data)] of everything idf.py flash would write
+    path = os.path.join(build_dir, 'flash_args')
+    regions = []
+    with open(path, 'r') as f:
+        for line in f:
+            words = shlex.split(line)
+            if len(words) == 2 and not words[0].startswith('-'):
+                with open(os.path.join(build_dir, words[1]), 'rb') as img:
+                    regions.append((int(words[0], 0), img.read()))
+    if not regions:
+        sys.exit('Error: nothing to flash in %s' % path)
+    return regions
+
+
+def parse_defaults(pairs, known):
+    values = {}
+    for pair in pairs:
+        key, sep, value = pair.partition('=')
+        key, value = key.strip(), value.strip()
+        if not sep or key not in known:
+            sys.exit('Error: bad default `%s` (known: %s)' % (pair, ', '.join(known)))
+        if value.lower() in ('true', 'false'):
+            value = int(value.lower() == 'true')
+        else:
+            try:
+                value = int(value, 0)
+            except ValueError:
+                sys.exit('Error: %s: not a number: %s' % (key, value))
+        if not 0 <= value <= 0xffffffff:
+            sys.exit('Error: %s: out of u32 range: %d' % (key, value))
+        values[key] = value  # later wins
+    return values
+
+
+def read_defaults_file(path):
+    with open(path, 'r') as f:
+        return [line.split('#', 1)[0].strip() for line in f if line.split('#', 1)[0].strip()]
+
+
+def nvs_partition_gen():
+    # -> command prefix for the IDF nvs partition generator
+    try:
+        import esp_idf_nvs_partition_gen  # noqa: F401
+        return [sys.executable, '-m', 'esp_idf_nvs_partition_gen']
+    except ImportError:
+        pass
+    idf_path = os.environ.get('IDF_PATH')
+    if idf_path:
+        script = os.path.join(idf_path, 'components', 'nvs_flash', 'nvs_partition_generator', 'nvs_partition_gen.py')
+        if os.path.isfile(script):
+            return [sys.executable, script]
+    sys.exit('Error: no nvs partition generator (pip install esp-idf-nvs-partition-gen, or set IDF_PATH)')
+
+
+def build_nvs(values, size):
+    # Every flash variable is stored as u32 under its (trimmed) name, like light_config_persist_vars() does
+    with tempfile.TemporaryDirectory() as tmp:
+        csv_path = os.path.join(tmp, 'nvs.csv')
+        bin_path = os.path.join(tmp, 'nvs.bin')
+        with open(csv_path, 'w') as f:
+            f.write('key,type,encoding,value\n%s,namespace,,\n' % NAMESPACE)
+            for key, value in values.items():
+                f.write('%s,data,u32,%d\n' % (key[:NVS_KEY_LEN], value))
+        cmd = nvs_partition_gen() + ['generate', csv_path, bin_path, hex(size)]
+        res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        if res.returncode != 0 or not os.path.isfile(bin_path):
+            sys.exit('Error: nvs partition generator failed:\n%s' % res.stdout)
+        with open(bin_path, 'rb') as f:
+            return f.read()
+
+
+def partition_region(parts, name, data, what):
+    if name not in parts:
+        sys.exit('Error: no %s partition' % name)
+    offset, size = parts[name]
+    if len(data) > size:
+        sys.exit('Error: %s (%d bytes) doesn\'t fit %s (%d bytes)' % (what, len(data), name, size))
+    return (offset, data)
+
+
+def merge(regions):
+    regions = sorted(regions, key=lambda r: r[0])
+    for (a, da), (b, _) in zip(regions, regions[1:]):
+        if a + len(da) > b:
+            sys.exit('Error: overlapping regions at 0x%x and 0x%x' % (a, b))
+    end = regions[-1][0] + len(regions[-1][1])
+    image = bytearray([FILL]) * end
+    for offset, data in regions:
+        image[offset:offset + len(data)] = data
+    return bytes(image)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build merged per-device provisioning images')
+    parser.add_argument('zb_fct', nargs='+', help='factory zigbee config image(s) from esp_zb_mfg_tool.py (one per device)')
+    parser.add_argument('--build-dir', default=os.path.join(HERE, 'build'), help='build dir with flash_args (default: build)')
+    parser.add_argument('--partitions', default=os.path.join(HERE, 'partitions.csv'), help='partition table csv')
+    parser.add_argument('--calib', type=argparse.FileType('rb'), help='calibration profile (calib_profile.py) to include')
+    parser.add_argument('--defaults', help='file with key=value light_config defaults (one per line, # comments)')
+    parser.add_argument('--set', action='append', default=[], metavar='KEY=VALUE', help='light_config default (repeatable, wins over --defaults)')
+    parser.add_argument('--outdir', default='.', help='where to put <zb_fct name>-merged.bin (default: .)')
+    args = parser.parse_args()
+
+    known = load_vars(LIGHT_CONFIG_H)
+    pairs = (read_defaults_file(args.defaults) if args.defaults else []) + args.set
+    values = parse_defaults(pairs, known)
+
+    parts = load_partitions(args.partitions)
+    shared = load_flash_args(args.build_dir)
+    if values:
+        shared.append(partition_region(parts, 'nvs', build_nvs(values, parts['nvs'][1]), 'light_config defaults'))
+    if args.calib:
+        shared.append(partition_region(parts, 'calib', args.calib.read(), 'calibration profile'))
+
+    os.makedirs(args.outdir, exist_ok=True)
+    for path in args.zb_fct:
+        with open(path, 'rb') as f:
+            zb_fct = partition_region(parts, 'zb_fct', f.read(), path)
+        image = merge(shared + [zb_fct])
+        out = os.path.join(args.outdir, os.path.splitext(os.path.basename(path))[0] + '-merged.bin')
+        with open(out, 'wb') as f:
+            f.write(image)
+        print('%s: %d bytes' % (out, len(image)))
+
+    print('light_config defaults: %s' % (', '.join('%s=%d' % kv for kv in values.items()) or 'none'))
+
+
+if __name__ == '__main__':
+    main()
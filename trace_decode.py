@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+# ESP32 White Ambiance
+# Copyright © 2025 Michal Jirků (wejn)
+#
+# This code is licensed under GPL version 3.
+#
+
+"""
+Decode binary event trace dumps (responses to MY_MANUF_CMD_TRACE_DUMP) into
+a readable timeline.
+
+Input is text with one response payload per line, in hex (spaces, colons
+and a leading 0x are ignored). Event names and argument labels are parsed
+from main/trace.h, so the decoder follows the firmware automatically.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+HEADER = struct.Struct('<IB')  # head, count
+RECORD = struct.Struct('<IHBBHHI')  # timestamp, seq, event, arg0, arg1, arg2, arg3
+
+
+def load_events(trace_h):
+    events = []
+    with open(trace_h, 'r') as f:
+        src = f.read()
+    body = re.search(r'#define _TRACE_EVENT_ITER\(X\)(.*?)\n\n', src, re.S)
+    if not body:
+        sys.exit('Error: no _TRACE_EVENT_ITER in %s' % trace_h)
+    for m in re.finditer(r'X\((\w+)((?:\s*,\s*"[^"]*")*)\)', body.group(1)):
+        labels = re.findall(r'"([^"]*)"', m.group(2))
+        events.append((m.group(1), labels))
+    return events
+
+
+def parse_dumps(lines):
+    records = {}
+    for lineno, line in enumerate(lines, 1):
+        line = re.sub(r'0x|[\s:,]', '', line)
+        if not line or line.startswith('#'):
+            continue
+        try:
+            data = bytes.fromhex(line)
+        except ValueError:
+            sys.exit('Error: line %d is not hex' % lineno)
+        if len(data) < HEADER.size:
+            sys.exit('Error: line %d is too short' % lineno)
+        head, count = HEADER.unpack_from(data)
+        if len(data) != HEADER.size + count * RECORD.size:
+            sys.exit('Error: line %d has bad length for %d records' % (lineno, count))
+        for i in range(count):
+            rec = RECORD.unpack_from(data, HEADER.size + i * RECORD.size)
+            # Recover full sequence number from the head (records are within 64k of it)
+            seq = head - ((head - rec[1]) & 0xffff)
+            records[seq] = rec
+    return records
+
+
+def format_args(labels, args):
+    out = []
+    for label, value in zip(labels, args):
+        if label:
+            out.append('%s=%d' % (label, value))
+    return ' '.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode e32wamb event trace dumps')
+    parser.add_argument('dump', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='File with hex dumps, one response per line (default: stdin)')
+    parser.add_argument('--trace-h', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), 'main', 'trace.h'),
+                        help='Path to trace.h with the event definitions')
+    args = parser.parse_args()
+
+    events = load_events(args.trace_h)
+    records = parse_dumps(args.dump)
+
+    first = None
+    prev = None
+    now = 0
+    for seq in sorted(records):
+        timestamp, _, event, *rest = records[seq]
+        # Unwrap the 32-bit μs timestamps (wrap every ~71 minutes)
+        if prev is None:
+            first = timestamp
+        else:
+            now += (timestamp - prev) & 0xffffffff
+        gap = '' if prev is None or seq - 1 in records else ' (gap)'
+        prev = timestamp
+        if event < len(events):
+            name, labels = events[event]
+        else:
+            name, labels = 'unknown_%d' % event, ['arg0', 'arg1', 'arg2', 'arg3']
+        print('%8d %12.3f ms  %-16s %s%s' % (seq, now / 1000.0, name, format_args(labels, rest), gap))
+
+    if first is not None:
+        print('\n%d records, %.3f ms total' % (len(records), now / 1000.0))
+
+
+if __name__ == '__main__':
+    main()
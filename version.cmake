@@ -1,5 +1,6 @@
 # This makes the following variables available:
 # - BUILD_TIMESTAMP = "%Y%m%d%H%M%S" (UTC)
+# - BUILD_EPOCH = unix time of the same moment (used as OTA file version)
 # - GIT_SHORT_REV = 7 char revision short
 # - GIT_DIRTY_SUFFIX = "-dirty" if there are uncommitted changes
 # - GIT_FULL_REV_ID = "${GIT_SHORT_REV}${GIT_DIRTY_SUFFIX}"
@@ -32,7 +33,12 @@ cmake_minimum_required(VERSION 3.16)
 find_package(Git QUIET)
 
 # Gather build timestamp + git revision
-string(TIMESTAMP BUILD_TIMESTAMP "%Y%m%d%H%M%S")
+string(TIMESTAMP BUILD_EPOCH "%s" UTC)
+if(NOT DEFINED ENV{SOURCE_DATE_EPOCH})
+    # Make the other timestamp(s) agree with BUILD_EPOCH to the second
+    set(ENV{SOURCE_DATE_EPOCH} "${BUILD_EPOCH}")
+endif()
+string(TIMESTAMP BUILD_TIMESTAMP "%Y%m%d%H%M%S" UTC)
 set(GIT_DIRTY_SUFFIX "nogit")
 set(GIT_SHORT_REV "")
 set(GIT_FULL_REV_ID "nogit")